@@ -0,0 +1,335 @@
+/* batch.c: headless batch validation of emulator files
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* Batch mode runs each file in a manifest (one filename per line; blank
+   lines and lines starting with `#' are ignored) without any user
+   interaction and as fast as possible:
+
+   RZX files are played back until the recording ends.
+   Snapshots are run for --batch-frames frames.
+   Tapes are autoloaded and run until the tape has played to the end, or
+     for --batch-frames frames if it is loaded via traps.
+
+   For each file, a tab-separated line is printed giving the filename, its
+   status (ok, timeout or error), the number of frames run, the time taken
+   in seconds and, if --batch-output was given, the final state of the
+   machine saved as a .szx snapshot in that directory.
+
+   With --batch-jobs greater than one, the files are shared between that
+   many worker processes, each forked from the fully initialised emulator.
+
+   Batch mode is intended to be used with the null UI and --no-sound. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif				/* #ifdef HAVE_FORK */
+
+#include "libspectrum.h"
+
+#include "batch.h"
+#include "compat.h"
+#include "event.h"
+#include "fuse.h"
+#include "machine.h"
+#include "rzx.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "sound.h"
+#include "spectrum.h"
+#include "tape.h"
+#include "timer/timer.h"
+#include "utils.h"
+#include "z80/z80.h"
+
+typedef enum batch_status_t {
+  BATCH_STATUS_OK,
+  BATCH_STATUS_TIMEOUT,
+  BATCH_STATUS_ERROR,
+} batch_status_t;
+
+static const char * const status_name[] = { "ok", "timeout", "error" };
+
+/* Read the manifest into an array of filenames */
+static GArray*
+read_manifest( const char *filename )
+{
+  utils_file file;
+  GArray *files;
+  size_t start, end, stop;
+  char *name;
+
+  if( utils_read_file( filename, &file ) ) return NULL;
+
+  files = g_array_new( FALSE, FALSE, sizeof( char* ) );
+
+  for( start = 0; start < file.length; start = end + 1 ) {
+
+    for( end = start; end < file.length && file.buffer[ end ] != '\n'; end++ )
+      ;
+
+    /* Ignore trailing whitespace, including DOS line endings */
+    for( stop = end;
+         stop > start && ( file.buffer[ stop - 1 ] == ' '  ||
+                           file.buffer[ stop - 1 ] == '\t' ||
+                           file.buffer[ stop - 1 ] == '\r' );
+         stop-- )
+      ;
+
+    if( stop > start && file.buffer[ start ] != '#' ) {
+      name = libspectrum_new( char, stop - start + 1 );
+      memcpy( name, &file.buffer[ start ], stop - start );
+      name[ stop - start ] = '\0';
+      g_array_append_val( files, name );
+    }
+  }
+
+  utils_close_file( &file );
+
+  return files;
+}
+
+static void
+free_manifest( GArray *files )
+{
+  guint i;
+
+  for( i = 0; i < files->len; i++ )
+    libspectrum_free( g_array_index( files, char*, i ) );
+
+  g_array_free( files, TRUE );
+}
+
+/* Where to save the final snapshot for `filename', the `index'th file in
+   the manifest, or NULL if no output directory was given. The index keeps
+   the names of files with the same basename apart */
+static char*
+output_filename( const char *filename, guint index )
+{
+  const char *base = filename, *ptr;
+  char *output;
+  size_t length;
+
+  if( !settings_current.batch_output ) return NULL;
+
+  for( ptr = filename; *ptr; ptr++ )
+    if( *ptr == '/' || *ptr == FUSE_DIR_SEP_CHR ) base = ptr + 1;
+
+  /* Room for the separator, up to ten digits, '-', ".szx" and the NUL */
+  length = strlen( settings_current.batch_output ) + strlen( base ) + 17;
+  output = libspectrum_new( char, length );
+  snprintf( output, length, "%s" FUSE_DIR_SEP_STR "%u-%s.szx",
+            settings_current.batch_output, index + 1, base );
+
+  return output;
+}
+
+static int
+load_file( const char *filename, libspectrum_class_t *class )
+{
+  libspectrum_id_t type;
+  int error;
+
+  error = libspectrum_identify_file_with_class( &type, class, filename, NULL,
+                                                0 );
+  if( error ) return error;
+
+  switch( *class ) {
+
+  case LIBSPECTRUM_CLASS_RECORDING:
+    return rzx_start_playback( filename, 0 );
+
+  case LIBSPECTRUM_CLASS_SNAPSHOT:
+    return snapshot_read( filename );
+
+  case LIBSPECTRUM_CLASS_TAPE:
+    return tape_open( filename, 1 );
+
+  default:
+    return 1;
+  }
+}
+
+/* Run one file, the `index'th in the manifest, printing its results */
+static batch_status_t
+run_file( const char *filename, guint index )
+{
+  libspectrum_class_t class;
+  libspectrum_dword frames = 0, last_frame, frame;
+  batch_status_t status;
+  double start;
+  int tape_started = 0, done = 0;
+  char *output;
+
+  start = compat_timer_get_time();
+
+  /* Start every file from the same state */
+  if( rzx_playback ) rzx_stop_playback( 0 );
+  if( tape_present() ) tape_close();
+  machine_reset( 1 );
+
+  if( load_file( filename, &class ) ) {
+    status = BATCH_STATUS_ERROR;
+    done = 1;
+  } else {
+    status = BATCH_STATUS_OK;
+  }
+
+  last_frame = spectrum_frame_count();
+
+  while( !done && !fuse_exiting ) {
+
+    z80_do_opcodes();
+    event_do_events();
+
+    frame = spectrum_frame_count();
+    if( frame == last_frame ) continue;
+
+    /* The frame count starts again if the machine is reset */
+    frames += frame > last_frame ? frame - last_frame : frame;
+    last_frame = frame;
+
+    /* Run flat out: loading a snapshot may have added the timer back */
+    event_remove_type( timer_event );
+
+    switch( class ) {
+
+    case LIBSPECTRUM_CLASS_RECORDING:
+      if( !rzx_playback ) done = 1;
+      break;
+
+    case LIBSPECTRUM_CLASS_TAPE:
+      if( tape_is_playing() ) {
+        tape_started = 1;
+      } else if( tape_started ) {
+        done = 1;
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    if( !done && frames >= (libspectrum_dword)settings_current.batch_frames ) {
+      if( class == LIBSPECTRUM_CLASS_RECORDING || tape_is_playing() )
+        status = BATCH_STATUS_TIMEOUT;
+      done = 1;
+    }
+  }
+
+  output = status == BATCH_STATUS_ERROR ? NULL : output_filename( filename, index );
+  if( output && snapshot_write( output ) ) {
+    status = BATCH_STATUS_ERROR;
+    libspectrum_free( output );
+    output = NULL;
+  }
+
+  printf( "%s\t%s\t%lu\t%.3f\t%s\n", filename, status_name[ status ],
+          (unsigned long)frames, compat_timer_get_time() - start,
+          output ? output : "" );
+  fflush( stdout );
+
+  libspectrum_free( output );
+
+  return status;
+}
+
+/* Run every `jobs'th file, starting at `first'; returns the number of
+   files which weren't OK */
+static int
+run_files( GArray *files, guint first, guint jobs )
+{
+  guint i;
+  int failures = 0;
+
+  for( i = first; i < files->len && !fuse_exiting; i += jobs )
+    if( run_file( g_array_index( files, char*, i ), i ) != BATCH_STATUS_OK )
+      failures++;
+
+  return failures;
+}
+
+int
+batch_run( void )
+{
+  GArray *files;
+  int jobs, failures = 0;
+
+  files = read_manifest( settings_current.batch_file );
+  if( !files ) return 1;
+
+  /* Nothing in batch mode should make noise or change the user's
+     configuration */
+  settings_current.sound = 0;
+  sound_end();
+  settings_current.autosave_settings = 0;
+
+  jobs = settings_current.batch_jobs;
+  if( jobs < 1 ) jobs = 1;
+  if( (guint)jobs > files->len ) jobs = files->len;
+
+  printf( "# file\tstatus\tframes\tseconds\tsnapshot\n" );
+  fflush( stdout );
+
+#ifdef HAVE_FORK
+  if( jobs > 1 ) {
+
+    int i, child_status;
+    pid_t pid;
+
+    for( i = 0; i < jobs; i++ ) {
+      pid = fork();
+      if( pid == 0 ) exit( run_files( files, i, jobs ) ? 1 : 0 );
+      if( pid < 0 ) break;
+    }
+
+    /* If we couldn't start them all, run the rest of the files here */
+    if( i < jobs ) {
+      fprintf( stderr, "%s: couldn't start batch worker %d of %d; running "
+               "its files and those of the remaining workers in the main "
+               "process\n", fuse_progname, i + 1, jobs );
+      for( ; i < jobs; i++ )
+        failures += run_files( files, i, jobs );
+    }
+
+    while( wait( &child_status ) > 0 )
+      if( !WIFEXITED( child_status ) || WEXITSTATUS( child_status ) )
+        failures++;
+
+  } else {
+    failures = run_files( files, 0, 1 );
+  }
+#else				/* #ifdef HAVE_FORK */
+  failures = run_files( files, 0, 1 );
+#endif				/* #ifdef HAVE_FORK */
+
+  free_manifest( files );
+
+  return failures ? 1 : 0;
+}
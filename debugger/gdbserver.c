@@ -44,11 +44,16 @@ static volatile char break_on_no_clients = 0;
 static int gdbserver_port = 0;
 
 static pthread_t network_thread_id;
-static trapped_action_t scheduled_action = NULL;
-static const void* scheduled_action_data = NULL;
-static void* scheduled_action_response = NULL;
+static size_t scheduled_actions = 0;
 static uint8_t scheduled_action_response_delivered = 0;
 
+// a copy of the 64K address space, taken the first time a request needs it
+// after we trap; memory reads are served from here by the network thread,
+// and memory writes are applied to it straight away and to the real memory
+// with the next batch of actions
+static libspectrum_byte memory_snapshot[0x10000];
+static volatile char memory_snapshot_valid = 0;
+
 static pthread_cond_t trapped_cond;
 static pthread_cond_t response_cond;
 static pthread_mutex_t trap_process_mutex;
@@ -72,11 +77,12 @@ static libspectrum_word* registers[] = {
 };
 
 static uint8_t gdbserver_detrap();
-static uint8_t gdbserver_execute_on_main_thread(trapped_action_t call, const void* data, void* response);
+static void gdbserver_queue_action(trapped_action_t call, const void* args, size_t args_size, uint8_t has_response);
+static uint8_t gdbserver_flush_actions();
+static uint8_t gdbserver_take_snapshot();
 
 static uint8_t action_get_registers(const void* arg, void* response);
 static uint8_t action_set_registers(const void* arg, void* response);
-static uint8_t action_get_mem(const void* arg, void* response);
 static uint8_t action_set_mem(const void* arg, void* response);
 static uint8_t action_get_register(const void* arg, void* response);
 static uint8_t action_set_register(const void* arg, void* response);
@@ -106,6 +112,28 @@ struct action_breakpoint_args_t {
     size_t maddr, mlen;
 };
 
+// the network thread queues up the actions for a whole train of packets,
+// and the main thread runs them all in a single handoff
+#define ACTION_QUEUE_LENGTH 64
+#define ACTION_RESPONSE_LENGTH 128
+
+struct queued_action_t {
+    trapped_action_t call;
+    union {
+        struct action_mem_args_t mem;
+        struct action_step_args_t step;
+        struct action_register_args_t reg;
+        struct action_set_registers_args_t regs;
+        struct action_breakpoint_args_t breakpoint;
+    } args;
+    uint8_t has_args;
+    uint8_t has_response;
+    char response[ACTION_RESPONSE_LENGTH];
+};
+
+static struct queued_action_t action_queue[ACTION_QUEUE_LENGTH];
+static size_t action_queue_length = 0;
+
 static void process_xfer(const char *name, char *args)
 {
   const char *mode = args;
@@ -193,7 +221,8 @@ static void process_vpacket(char *payload)
         {
             if (gdbserver_trapped)
             {
-                gdbserver_execute_on_main_thread(action_step_instruction, NULL, NULL);
+                gdbserver_queue_action(action_step_instruction, NULL, 0, 0);
+                gdbserver_flush_actions();
                 gdbserver_detrap();
             }
         }
@@ -248,7 +277,7 @@ static uint8_t process_packet()
     }
   
     uint8_t *packetend_ptr = (uint8_t *)memchr(inbuf, '#', inbuf_size);
-    if (packetend_ptr == NULL)
+    if (packetend_ptr == NULL || packetend_ptr - inbuf + 2 >= inbuf_size)
     {
         return 0;
     }
@@ -268,12 +297,32 @@ static uint8_t process_packet()
         return 1;
     }
   
-    char recv_data[1024];
-    strcpy(recv_data, (char*)&inbuf[1]);
+    // binary payloads may contain NULs, so keep track of the length; this
+    // is big enough for the PacketSize we advertise
+    static char recv_data[0x4000 + 1];
+    size_t recv_length = packetend - 1;
+    if (recv_length >= sizeof(recv_data))
+    {
+        inbuf_erase_head(packetend + 3);
+        acknowledge_packet(gdbserver_client_socket);
+        write_packet("E01");
+        return 1;
+    }
+    memcpy(recv_data, &inbuf[1], recv_length);
+    recv_data[recv_length] = '\0';
     inbuf_erase_head(packetend + 3);
+    acknowledge_packet(gdbserver_client_socket);
   
     char request = recv_data[0];
     char *payload = (char *)&recv_data[1];
+    size_t payload_length = recv_length ? recv_length - 1 : 0;
+
+    // only these requests go through the action queue; anything else
+    // replies straight away, so the queued replies must go out first
+    if (!(request && strchr("gGMXpPZz", request)))
+    {
+        gdbserver_flush_actions();
+    }
 
     switch (request)
     {
@@ -296,8 +345,7 @@ static uint8_t process_packet()
         }
         case 'g':
         {
-            if (gdbserver_execute_on_main_thread(action_get_registers, NULL, tmpbuf))
-                write_packet((const char*)tmpbuf);
+            gdbserver_queue_action(action_get_registers, NULL, 0, 1);
             break;
         }
         case 'G':
@@ -310,8 +358,7 @@ static uint8_t process_packet()
             }
             hex2mem(payload, (void *)&r.regs_data, (sizeof(registers) / sizeof(libspectrum_word*)) * 2);
           
-            if (gdbserver_execute_on_main_thread(action_set_registers, &r, tmpbuf))
-                write_packet((const char*)tmpbuf);
+            gdbserver_queue_action(action_set_registers, &r, sizeof(r), 1);
             break;
         }
         case 'H':
@@ -321,37 +368,52 @@ static uint8_t process_packet()
         }
         case 'm':
         {
-            struct action_mem_args_t mem;
-            assert(sscanf(payload, "%zx,%zx", &mem.maddr, &mem.mlen) == 2);
-            if (mem.mlen * SZ * 2 > 0x20000)
+            size_t maddr, mlen, i;
+            assert(sscanf(payload, "%zx,%zx", &maddr, &mlen) == 2);
+            if (mlen * SZ * 2 > 0x20000)
             {
               puts("Buffer overflow!");
               exit(-1);
             }
-          
-            if (gdbserver_execute_on_main_thread(action_get_mem, &mem, tmpbuf))
+
+            // no need to bother the main thread, the snapshot has it all
+            if (gdbserver_take_snapshot())
+            {
+                for (i = 0; i < mlen; i++)
+                {
+                    mem2hex(&memory_snapshot[(maddr + i) & 0xffff], (char*)tmpbuf + i * 2, 1);
+                }
+                tmpbuf[mlen * 2] = '\0';
                 write_packet((const char*)tmpbuf);
+            }
             break;
         }
         case 'M':
         {
             struct action_mem_args_t mem;
             int offset;
+            size_t i;
             if (sscanf(payload, "%zx,%zx:%n", &mem.maddr, &mem.mlen, &offset) != 2) {
                 write_packet("E01");
                 break;
             }
-            mem.payload = (uint8_t*)(payload + offset);
-            if (gdbserver_execute_on_main_thread(action_set_mem, &mem, tmpbuf))
-                write_packet((const char*)tmpbuf);
+            if (!gdbserver_take_snapshot())
+            {
+                break;
+            }
+            for (i = 0; i < mem.mlen; i++)
+            {
+                hex2mem(payload + offset + i * 2, &memory_snapshot[(mem.maddr + i) & 0xffff], 1);
+            }
+            mem.payload = NULL;
+            gdbserver_queue_action(action_set_mem, &mem, sizeof(mem), 1);
             break;
         }
         case 'p':
         {
             struct action_register_args_t r;
             r.reg = strtol(payload, NULL, 16);
-            if (gdbserver_execute_on_main_thread(action_get_register, &r, tmpbuf))
-                write_packet((const char*)tmpbuf);
+            gdbserver_queue_action(action_get_register, &r, sizeof(r), 1);
             break;
         }
         case 'P':
@@ -362,9 +424,7 @@ static uint8_t process_packet()
           
             hex2mem(payload, (void *)&r.value, SZ * 2);
           
-            if (gdbserver_execute_on_main_thread(action_set_register, &r, tmpbuf))
-                write_packet((const char*)tmpbuf);
-          
+            gdbserver_queue_action(action_set_register, &r, sizeof(r), 1);
             break;
         }
         case 'q':
@@ -374,7 +434,8 @@ static uint8_t process_packet()
         }
         case 's':
         {
-            gdbserver_execute_on_main_thread(action_step_instruction, NULL, NULL);
+            gdbserver_queue_action(action_step_instruction, NULL, 0, 0);
+            gdbserver_flush_actions();
             gdbserver_detrap();
             break;
         }
@@ -389,7 +450,8 @@ static uint8_t process_packet()
                     struct action_step_args_t ar;
                     ar.addr = a;
                     ar.len = b;
-                    gdbserver_execute_on_main_thread(action_step_instruction, &ar, NULL);
+                    gdbserver_queue_action(action_step_instruction, &ar, sizeof(ar), 0);
+                    gdbserver_flush_actions();
                     gdbserver_detrap();
                 }
                 else if (sscanf(payload, "%zx", &a) == 1)
@@ -397,12 +459,14 @@ static uint8_t process_packet()
                     struct action_step_args_t ar;
                     ar.addr = 0;
                     ar.len = a;
-                    gdbserver_execute_on_main_thread(action_step_instruction, &ar, NULL);
+                    gdbserver_queue_action(action_step_instruction, &ar, sizeof(ar), 0);
+                    gdbserver_flush_actions();
                     gdbserver_detrap();
                 }
                 else
                 {
-                    gdbserver_execute_on_main_thread(action_step_instruction, NULL, NULL);
+                    gdbserver_queue_action(action_step_instruction, NULL, 0, 0);
+                    gdbserver_flush_actions();
                     gdbserver_detrap();
                 }
             }
@@ -424,19 +488,28 @@ static uint8_t process_packet()
                 break;
             }
             payload += offset;
-            new_len = unescape(payload, (char *)packetend_ptr - payload);
+            new_len = unescape(payload, payload_length - offset);
             if (new_len != mlen) {
                 write_packet("E01");
                 break;
             }
           
+            if (!gdbserver_take_snapshot())
+            {
+                break;
+            }
+
             struct action_mem_args_t mem;
-            mem.payload = (uint8_t*)payload;
+            size_t i;
+            for (i = 0; i < mlen; i++)
+            {
+                memory_snapshot[(maddr + i) & 0xffff] = (uint8_t)payload[i];
+            }
+            mem.payload = NULL;
             mem.maddr = maddr;
             mem.mlen = mlen;
-          
-            if (gdbserver_execute_on_main_thread(action_set_mem, &mem, tmpbuf))
-                write_packet((const char*)tmpbuf);
+
+            gdbserver_queue_action(action_set_mem, &mem, sizeof(mem), 1);
             break;
         }
         case 'Z':
@@ -447,9 +520,7 @@ static uint8_t process_packet()
             struct action_breakpoint_args_t b;
             b.maddr = addr;
           
-            if (gdbserver_execute_on_main_thread(action_set_breakpoint, &b, tmpbuf))
-                write_packet((const char*)tmpbuf);
-        
+            gdbserver_queue_action(action_set_breakpoint, &b, sizeof(b), 1);
             break;
         }
         case 'z':
@@ -460,9 +531,7 @@ static uint8_t process_packet()
             struct action_breakpoint_args_t b;
             b.maddr = addr;
           
-            if (gdbserver_execute_on_main_thread(action_remove_breakpoint, &b, tmpbuf))
-                write_packet((const char*)tmpbuf);
-        
+            gdbserver_queue_action(action_remove_breakpoint, &b, sizeof(b), 1);
             break;
         }
         case '?':
@@ -485,7 +554,7 @@ static uint8_t process_packet()
         }
     }
   
-    return 0;
+    return 1;
 }
 
 
@@ -497,9 +566,11 @@ static int process_network(int socket)
         return ret;
     }
 
+    // handle every complete packet we've got before replying, so a train
+    // of requests costs a single handoff to the main thread
     pthread_mutex_lock(&network_mutex);
-    acknowledge_packet(socket);
-    while (process_packet()) ;
+    while (skip_to_packet_start() && process_packet()) ;
+    gdbserver_flush_actions();
     write_flush(socket);
     pthread_mutex_unlock(&network_mutex);
   
@@ -704,6 +775,7 @@ static uint8_t gdbserver_detrap()
     if (gdbserver_trapped)
     {
         gdbserver_trapped = 0;
+        memory_snapshot_valid = 0;
         pthread_cond_signal(&trapped_cond);
         result = 1;
     }
@@ -711,41 +783,105 @@ static uint8_t gdbserver_detrap()
     return result;
 }
 
-// schedule a simple job (call) on the main thread, while it's trapped
-// data and response are supposed to be located on the stack of the caller (network) thread,
-// as it's going to be stopped until the response is there
-static uint8_t gdbserver_execute_on_main_thread(trapped_action_t call, const void* data, void* response)
+// queue a simple job (call) to be run on the main thread by the next
+// gdbserver_flush_actions(); args are copied, so they can live on the stack
+static void gdbserver_queue_action(trapped_action_t call, const void* args, size_t args_size, uint8_t has_response)
+{
+    struct queued_action_t* action;
+
+    if (action_queue_length == ACTION_QUEUE_LENGTH)
+    {
+        gdbserver_flush_actions();
+    }
+
+    action = &action_queue[action_queue_length++];
+    action->call = call;
+    action->has_args = args != NULL;
+    if (args != NULL)
+    {
+        assert(args_size <= sizeof(action->args));
+        memcpy(&action->args, args, args_size);
+    }
+    action->has_response = has_response;
+    action->response[0] = '\0';
+}
+
+// run every queued job on the main thread, while it's trapped, in one go and
+// then send their replies in order. Called with network_mutex held; it's
+// let go while we wait, so the main thread can never be stuck behind us
+static uint8_t gdbserver_flush_actions()
 {
+    size_t i, length = action_queue_length;
+
+    if (length == 0)
+    {
+        return 1;
+    }
+
+    action_queue_length = 0;
+
     pthread_mutex_lock(&trap_process_mutex);
 
-    if (gdbserver_trapped != 1 && debugger_mode != DEBUGGER_MODE_HALTED)
+    // only gdbserver_activate() runs the queue; if anything else (say, the
+    // native debugger) stopped the machine, nobody would ever answer
+    if (gdbserver_trapped != 1)
     {
         pthread_mutex_unlock(&trap_process_mutex);
+        for (i = 0; i < length; i++)
+        {
+            if (action_queue[i].has_response)
+                write_packet("E01");
+        }
         return 0;
     }
 
-    // prepare the action arguments
-    scheduled_action = call;
-    scheduled_action_data = data;
-    scheduled_action_response = response;
-    scheduled_action_response_delivered = 0;
-
     // execute
+    scheduled_actions = length;
+    scheduled_action_response_delivered = 0;
     pthread_cond_signal(&trapped_cond);
-    pthread_mutex_unlock(&trap_process_mutex);
-
-    sched_yield();
+    pthread_mutex_unlock(&network_mutex);
 
-    pthread_mutex_lock(&trap_process_mutex);
-    // wait for the response
+    // wait for the responses
     while (scheduled_action_response_delivered == 0)
     {
         pthread_cond_wait(&response_cond, &trap_process_mutex);
     }
     pthread_mutex_unlock(&trap_process_mutex);
+    pthread_mutex_lock(&network_mutex);
+
+    for (i = 0; i < length; i++)
+    {
+        if (action_queue[i].has_response)
+            write_packet(action_queue[i].response);
+    }
     return 1;
 }
 
+// make sure the memory snapshot is up to date; it's only taken when a
+// request first needs it, so single steps don't pay for copying 64K.
+// Returns 0 if we aren't trapped (say, the native debugger halted the
+// machine), as there's no snapshot to use then
+static uint8_t gdbserver_take_snapshot()
+{
+    uint8_t result;
+    size_t address;
+
+    pthread_mutex_lock(&trap_process_mutex);
+    result = gdbserver_trapped;
+    if (result && !memory_snapshot_valid)
+    {
+        // the main thread doesn't touch memory while it's trapped
+        for (address = 0; address < sizeof(memory_snapshot); address++)
+        {
+            memory_snapshot[address] = readbyte_internal(address);
+        }
+        memory_snapshot_valid = 1;
+    }
+    pthread_mutex_unlock(&trap_process_mutex);
+
+    return result;
+}
+
 static uint8_t action_get_registers(const void* arg, void* response)
 {
     int i;
@@ -778,45 +914,21 @@ static uint8_t action_set_registers(const void* arg, void* response)
     return 0;
 }
 
-static uint8_t action_get_mem(const void* arg, void* response)
-{
-    int i;
-    struct action_mem_args_t* mem = (struct action_mem_args_t*)arg;
-    char* resp_buff = (char*)response;
-  
-    uint32_t t = tstates;
-  
-    libspectrum_word address = mem->maddr;
-    for (i = 0; i < mem->mlen; i++, address++)
-    {
-        libspectrum_byte data = readbyte(address);
-        mem2hex((void *)&data, resp_buff + i * 2, 1);
-    }
-  
-    tstates = t;
-
-    resp_buff[mem->mlen * 2] = '\0';
-    return 0;
-}
-
+// the new contents are already in the snapshot
 static uint8_t action_set_mem(const void* arg, void* response)
 {
-    uint32_t t = tstates;
-  
     int i;
     struct action_mem_args_t* mem = (struct action_mem_args_t*)arg;
     char* resp_buff = (char*)response;
   
-    libspectrum_byte data;
     libspectrum_word address = mem->maddr;
     for (i = 0; i < mem->mlen; i++, address++)
     {
-        hex2mem((char*)mem->payload + i * 2, (uint8_t *)&data, 1);
-        writebyte(address, data);
+        writebyte_internal(address, memory_snapshot[address]);
+        // ROM ignores the write, so the snapshot must too
+        memory_snapshot[address] = readbyte_internal(address);
     }
   
-    tstates = t;
-  
     strcpy(resp_buff, "OK");
     return 0;
 }
@@ -960,34 +1072,41 @@ int gdbserver_activate()
     }
 
     pthread_mutex_lock(&trap_process_mutex);
-  
+
     gdbserver_do_not_report_trap = 0;
     gdbserver_trapped = 1;
+    memory_snapshot_valid = 0;
     pthread_cond_signal(&trapped_cond);
   
     uint8_t halt = 0;
 
-    // a simple loop that waits for someone to unlock, or postone a simple
-    // action (only one at a time)
+    // a simple loop that waits for someone to unlock, or postpone a batch
+    // of actions
     do
     {
 
-        if (!gdbserver_trapped)
-        {
-            break;
-        }
-
-        pthread_cond_wait(&trapped_cond, &trap_process_mutex);
-
-        if (scheduled_action != NULL)
+        if (scheduled_actions != 0)
         {
-            halt = scheduled_action(scheduled_action_data, scheduled_action_response);
-            scheduled_action = NULL;
+            size_t i;
+            for (i = 0; i < scheduled_actions; i++)
+            {
+                struct queued_action_t* action = &action_queue[i];
+                halt = action->call(action->has_args ? &action->args : NULL, action->response);
+            }
+            scheduled_actions = 0;
             scheduled_action_response_delivered = 1;
             
             // notify the waiter that we're done
             pthread_cond_signal(&response_cond);
+            continue;
         }
+
+        if (!gdbserver_trapped)
+        {
+            break;
+        }
+
+        pthread_cond_wait(&trapped_cond, &trap_process_mutex);
       
     } while (1);
 
@@ -1000,6 +1119,7 @@ int gdbserver_activate()
     {
         debugger_mode = DEBUGGER_MODE_HALTED;
         gdbserver_trapped = 0;
+        memory_snapshot_valid = 0;
     }
 
     pthread_mutex_unlock(&trap_process_mutex);
@@ -185,9 +185,21 @@ bool skip_to_packet_start()
     return true;
 }
 
+// a whole packet, checksum included, or an interrupt is waiting in the buffer
+static bool packet_complete()
+{
+    uint8_t *end;
+
+    if (in.buf[0] == INTERRUPT_CHAR)
+        return true;
+
+    end = (uint8_t *)memchr(in.buf, '#', in.end);
+    return end != NULL && end - in.buf + 2 < in.end;
+}
+
 int read_packet(int sockfd)
 {
-    while (!skip_to_packet_start())
+    while (!skip_to_packet_start() || !packet_complete())
     {
         int ret = read_data_once(sockfd);
         if (ret)
@@ -1,6 +1,7 @@
 #ifndef PACKETS_H
 #define PACKETS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define PACKET_BUF_SIZE 0x4000
@@ -14,6 +15,7 @@ void inbuf_erase_head(ssize_t end);
 void write_flush(int sockfd);
 void write_packet(const char *data);
 void write_binary_packet(const char *pfx, const uint8_t *data, ssize_t num_bytes);
+bool skip_to_packet_start();
 int read_packet(int sockfd);
 void acknowledge_packet(int sockfd);
 
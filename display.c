@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "compat.h"
 #include "display.h"
 #include "debugger/gdbserver.h"
 #include "fuse.h"
@@ -36,6 +37,7 @@
 #include "machine.h"
 #include "movie.h"
 #include "peripherals/scld.h"
+#include "rawdump.h"
 #include "rectangle.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -84,11 +86,32 @@ static libspectrum_word
 static int display_frame_count;
 static int display_flash_reversed;
 
+/* Each byte of these is 0xff where the corresponding pixel of a byte of
+   screen data is set, and zero where it isn't, in the order the pixels are
+   laid out: one byte per pixel, or two for Timex low resolution */
+static libspectrum_qword display_pixel_masks[ 0x100 ];
+static libspectrum_qword display_pixel_masks_double[ 0x100 ][2];
+
+/* Every byte of this is 0x01, to spread a colour across eight pixels */
+#define DISPLAY_PIXEL_REPEAT 0x0101010101010101ULL
+
+/* The colours of the two pixels in each byte of Pentagon 16 colour
+   screen data */
+static libspectrum_byte pentagon_16c_pixels[ 0x100 ][2];
+
 /* Which eight-pixel chunks on each line (including border) need to
    be redisplayed. Bit 0 corresponds to pixels 0-7, bit 39 to
    pixels 311-319. */
 static libspectrum_qword display_is_dirty[ DISPLAY_SCREEN_HEIGHT ];
 
+/* The same, but for everything which has changed since the UI was last
+   updated; see display_get_frame_dirty() */
+static libspectrum_qword display_frame_dirty[ DISPLAY_SCREEN_HEIGHT ];
+
+/* Once this many eighths of the screen have changed, it's cheaper just to
+   redraw all of it than to work out the rectangles which need redrawing */
+#define DISPLAY_FULL_REDRAW_EIGHTHS 6
+
 /* Which eight-pixel chunks on each line may need to be redisplayed. Bit 0
    corresponds to pixels 0-7, bit 31 to pixels 248-255. */
 static libspectrum_dword display_maybe_dirty[ DISPLAY_HEIGHT ];
@@ -151,6 +174,27 @@ add_border_sentinel( void )
   return 0;
 }
 
+static void
+init_pixel_tables( void )
+{
+  libspectrum_byte pixels[16];
+  int data, i;
+
+  for( data = 0; data < 0x100; data++ ) {
+
+    for( i = 0; i < 8; i++ )
+      pixels[ 2 * i ] = pixels[ 2 * i + 1 ] = data & ( 0x80 >> i ) ? 0xff : 0;
+    memcpy( display_pixel_masks_double[ data ], pixels, 16 );
+
+    for( i = 0; i < 8; i++ ) pixels[i] = pixels[ 2 * i ];
+    memcpy( &display_pixel_masks[ data ], pixels, 8 );
+
+    pentagon_16c_pixels[ data ][0] = ( data & 0x07 ) + ( ( data & 0x40 ) >> 3 );
+    pentagon_16c_pixels[ data ][1] =
+      ( ( data & 0x38 ) >> 3 ) + ( ( data & 0x80 ) >> 4 );
+  }
+}
+
 int
 display_init( int *argc, char ***argv )
 {
@@ -187,6 +231,8 @@ display_init( int *argc, char ***argv )
       display_dirty_xtable2[ (32*y) + x ] = x;
     }
 
+  init_pixel_tables();
+
   display_frame_count=0; display_flash_reversed=0;
 
   display_refresh_all();
@@ -322,27 +368,39 @@ display_get_attr_byte( int x, int y )
 static void
 update_dirty_rects( void )
 {
-  int start, y;
+  libspectrum_qword dirty;
+  int start, end, y, count = 0;
 
-  for( y=0; y<DISPLAY_SCREEN_HEIGHT; y++ ) {
-    int x = 0;
-    while( display_is_dirty[y] ) {
+  for( y = 0; y < DISPLAY_SCREEN_HEIGHT; y++ ) {
+    display_frame_dirty[y] |= display_is_dirty[y];
+    if( display_is_dirty[y] )
+      count += display_dirty_count( display_is_dirty[y] );
+  }
 
-      /* Find the first dirty chunk on this row */
-      while( !( display_is_dirty[y] & 0x01 ) ) {
-        display_is_dirty[y] >>= 1;
-        x++;
-      }
+  /* No point finding rectangles if we're going to redraw everything */
+  if( display_redraw_all ||
+      count * 8 >= DISPLAY_FULL_REDRAW_EIGHTHS * DISPLAY_SCREEN_WIDTH_COLS *
+                   DISPLAY_SCREEN_HEIGHT ) {
+    display_redraw_all = 1;
+    memset( display_is_dirty, 0, sizeof( display_is_dirty ) );
+    return;
+  }
+
+  for( y = 0; y < DISPLAY_SCREEN_HEIGHT; y++ ) {
+    dirty = display_is_dirty[y];
+    display_is_dirty[y] = 0;
+
+    while( dirty ) {
 
-      start = x;
+      /* Find the first dirty chunk on this row, and then the first clean
+         one after it; there's always one, as the line is less than 64
+         chunks wide */
+      start = display_dirty_lowest( dirty );
+      end = start + display_dirty_lowest( ~( dirty >> start ) );
 
-      /* Walk to the end of the dirty region */
-      do {
-        display_is_dirty[y] >>= 1;
-        x++;
-      } while( display_is_dirty[y] & 0x01 );
+      rectangle_add( y, start, end - start );
 
-      rectangle_add( y, start, x - start );
+      dirty &= ~( ( (libspectrum_qword)1 << end ) - 1 );
     }
 
     /* compress the active rectangles list */
@@ -421,12 +479,15 @@ display_write_if_dirty_timex( int x, int y )
   }
 }
 
+/* Spread the four bytes of Pentagon 16 colour data in `chunk', as stored
+   in display_last_screen, into eight pixels */
 static inline void
-pentagon_16c_get_colour( libspectrum_byte data, libspectrum_byte *colour1,
-                         libspectrum_byte *colour2 )
+pentagon_16c_expand( libspectrum_byte *pixels, libspectrum_dword chunk )
 {
-  *colour1 = (data & 0x07) + ( (data & 0x40) >> 3 );
-  *colour2 = ( (data & 0x38) >> 3 ) + ( (data & 0x80) >> 4 );
+  memcpy( &pixels[0], pentagon_16c_pixels[ chunk & 0xff ], 2 );
+  memcpy( &pixels[2], pentagon_16c_pixels[ ( chunk >> 8 ) & 0xff ], 2 );
+  memcpy( &pixels[4], pentagon_16c_pixels[ ( chunk >> 16 ) & 0xff ], 2 );
+  memcpy( &pixels[6], pentagon_16c_pixels[ chunk >> 24 ], 2 );
 }
 
 /* In this mode we need to gather the pixel information for the 8 pixels to
@@ -441,7 +502,6 @@ display_write_if_dirty_pentagon_16_col( int x, int y )
   libspectrum_byte *screen;
   libspectrum_byte data1, data2, data3, data4;
   libspectrum_dword last_chunk_detail;
-  libspectrum_byte colour1, colour2;
 
   /* We need to read the pixels from the appropriate two pages and write them
      out to the frame buffer */
@@ -480,19 +540,12 @@ display_write_if_dirty_pentagon_16_col( int x, int y )
        screen_page_1 base, pixel 5 & 6 from screen_page_2 ALTDFILE_OFFSET,
        pixel 7 & 8 from screen_page_1 ALTDFILE_OFFSET */
 
-    int draw_x = beam_x << 3;
-    pentagon_16c_get_colour( data1, &colour1, &colour2 );
-    uidisplay_putpixel( draw_x++, beam_y, colour1 );
-    uidisplay_putpixel( draw_x++, beam_y, colour2 );
-    pentagon_16c_get_colour( data2, &colour1, &colour2 );
-    uidisplay_putpixel( draw_x++, beam_y, colour1 );
-    uidisplay_putpixel( draw_x++, beam_y, colour2 );
-    pentagon_16c_get_colour( data3, &colour1, &colour2 );
-    uidisplay_putpixel( draw_x++, beam_y, colour1 );
-    uidisplay_putpixel( draw_x++, beam_y, colour2 );
-    pentagon_16c_get_colour( data4, &colour1, &colour2 );
-    uidisplay_putpixel( draw_x++, beam_y, colour1 );
-    uidisplay_putpixel( draw_x  , beam_y, colour2 );
+    libspectrum_byte pixels[8];
+    int draw_x = beam_x << 3, i;
+
+    pentagon_16c_expand( pixels, last_chunk_detail );
+    for( i = 0; i < 8; i++ )
+      uidisplay_putpixel( draw_x + i, beam_y, pixels[i] );
 
     /* Update last display record */
     display_last_screen[ index ] = last_chunk_detail;
@@ -543,6 +596,7 @@ static void
 copy_critical_region_line( int y, int x, int end )
 {
   libspectrum_dword bit_mask, dirty;
+  int offset;
 
   if( x < DISPLAY_WIDTH_COLS ) {
 
@@ -567,24 +621,12 @@ copy_critical_region_line( int y, int x, int end )
 
   while( dirty ) {
 
-    /* Find the first dirty chunk on this row */
-    while( !( dirty & 0x01 ) ) {
-
-      dirty >>= 1;
-      x++;
-
-    }
-
-    /* Walk to the end of the dirty region, writing the bytes to the
-       drawing area along the way */
-    do {
-
-      display_write_if_dirty( x, y );
+    /* Find the next dirty chunk on this row and write it to the drawing
+       area */
+    offset = display_dirty_lowest( dirty );
+    display_write_if_dirty( x + offset, y );
 
-      dirty >>= 1;
-      x++;
-
-    } while( dirty & 0x01 );
+    dirty &= dirty - 1;
 
   }
   
@@ -900,6 +942,9 @@ update_ui_screen( void )
     }
 
     if( display_redraw_all ) {
+      for( i = 0; i < DISPLAY_SCREEN_HEIGHT; i++ )
+        display_frame_dirty[i] =
+          ( (libspectrum_qword)1 << DISPLAY_SCREEN_WIDTH_COLS ) - 1;
       if( movie_recording ) {
         movie_add_area( 0, 0, DISPLAY_ASPECT_WIDTH >> 3,
                         DISPLAY_SCREEN_HEIGHT );
@@ -922,10 +967,20 @@ update_ui_screen( void )
 
     rectangle_inactive_count = 0;
 
+    if( rawdump_recording ) rawdump_frame();
+
     uidisplay_frame_end();
+
+    memset( display_frame_dirty, 0, sizeof( display_frame_dirty ) );
   }
 }
 
+const libspectrum_qword*
+display_get_frame_dirty( void )
+{
+  return display_frame_dirty;
+}
+
 int
 display_frame( void )
 {
@@ -1030,48 +1085,88 @@ void display_refresh_all(void)
   gdbserver_refresh_status();
 }
 
-/* Fetch pixel (x, y). On a Timex this will be a point on a 640x480 canvas,
-   on a Sinclair/Amstrad/Russian clone this will be a point on a 320x240
-   canvas */
-int
-display_getpixel( int x, int y )
+void
+display_expand8( libspectrum_byte *pixels, libspectrum_byte data,
+                 libspectrum_byte ink, libspectrum_byte paper )
 {
-  libspectrum_byte ink, paper;
-  libspectrum_byte data, data2;
-  int mask = 1 << (7 - (x % 8));
-  int index;
+  libspectrum_qword mask = display_pixel_masks[ data ], value;
 
-  if( machine_current->timex ) {
-    int column = x >> 4;
-    scld mode_data;
+  value = ( mask & ( ink * DISPLAY_PIXEL_REPEAT ) ) |
+          ( ~mask & ( paper * DISPLAY_PIXEL_REPEAT ) );
+  memcpy( pixels, &value, 8 );
+}
+
+void
+display_expand8_double( libspectrum_byte *pixels, libspectrum_byte data,
+                        libspectrum_byte ink, libspectrum_byte paper )
+{
+  libspectrum_qword ink8 = ink * DISPLAY_PIXEL_REPEAT;
+  libspectrum_qword paper8 = paper * DISPLAY_PIXEL_REPEAT;
+  libspectrum_qword mask, value;
+
+  mask = display_pixel_masks_double[ data ][0];
+  value = ( mask & ink8 ) | ( ~mask & paper8 );
+  memcpy( &pixels[0], &value, 8 );
 
-    y >>= 1;
-    index = column + y * DISPLAY_SCREEN_WIDTH_COLS;
+  mask = display_pixel_masks_double[ data ][1];
+  value = ( mask & ink8 ) | ( ~mask & paper8 );
+  memcpy( &pixels[8], &value, 8 );
+}
+
+void
+display_chunk_pixels( int x, int y, libspectrum_byte *pixels )
+{
+  libspectrum_dword chunk;
+  libspectrum_byte data, data2, ink, paper;
+
+  chunk = display_last_screen[ x + y * DISPLAY_SCREEN_WIDTH_COLS ];
+  data = chunk & 0xff;
+  data2 = ( chunk >> 8 ) & 0xff;
+
+  if( machine_current->timex ) {
+    scld mode;
 
-    data = display_last_screen[ index ] & 0xff;
-    data2 = (display_last_screen[ index ] & 0xff00)>>8;
-    mode_data.byte = (display_last_screen[ index ] & 0xff0000)>>16;
+    mode.byte = ( chunk >> 16 ) & 0xff;
 
-    if( mode_data.name.hires ) {
-      if( x % 16 > 7 ) data = data2;
-      display_parse_attr( hires_convert_dec( mode_data.byte ), &ink, &paper );
+    if( mode.name.hires ) {
+      display_parse_attr( hires_convert_dec( mode.byte ), &ink, &paper );
+      display_expand8( &pixels[0], data, ink, paper );
+      display_expand8( &pixels[8], data2, ink, paper );
     } else {
-      /* divide x by two to get the same value for adjacent pixels */
-      mask = 1 << (7 - ((x>>1) % 8));
       display_parse_attr( data2, &ink, &paper );
+      display_expand8_double( pixels, data, ink, paper );
     }
-  } else {
-    int column = x >> 3;
-
-    index = column + y * DISPLAY_SCREEN_WIDTH_COLS;
 
-    data = display_last_screen[ index ] & 0xff;
-    data2 = (display_last_screen[ index ] & 0xff00)>>8;
+    return;
+  }
 
-    display_parse_attr( data2, &ink, &paper );
+  /* The border is always stored as in the normal screen mode */
+  if( display_write_if_dirty == display_write_if_dirty_pentagon_16_col &&
+      x >= DISPLAY_BORDER_WIDTH_COLS &&
+      x <  DISPLAY_BORDER_WIDTH_COLS + DISPLAY_WIDTH_COLS &&
+      y >= DISPLAY_BORDER_HEIGHT &&
+      y <  DISPLAY_BORDER_HEIGHT + DISPLAY_HEIGHT ) {
+    pentagon_16c_expand( pixels, chunk );
+    return;
   }
 
-  if( data & mask ) return ink;
+  display_parse_attr( data2, &ink, &paper );
+  display_expand8( pixels, data, ink, paper );
+}
+
+/* Fetch pixel (x, y). On a Timex this will be a point on a 640x480 canvas,
+   on a Sinclair/Amstrad/Russian clone this will be a point on a 320x240
+   canvas */
+int
+display_getpixel( int x, int y )
+{
+  libspectrum_byte pixels[16];
+
+  if( machine_current->timex ) {
+    display_chunk_pixels( x >> 4, y >> 1, pixels );
+    return pixels[ x & 0x0f ];
+  }
 
-  return paper;
+  display_chunk_pixels( x >> 3, y, pixels );
+  return pixels[ x & 0x07 ];
 }
@@ -28,6 +28,8 @@
 
 #include "libspectrum.h"
 
+#include "compat.h"
+
 /* The width and height of the Speccy's screen */
 #define DISPLAY_WIDTH_COLS  32
 #define DISPLAY_HEIGHT_ROWS 24
@@ -108,11 +110,58 @@ void display_dirty_flashing_sinclair(void);
 void display_parse_attr( libspectrum_byte attr, libspectrum_byte *ink,
 			 libspectrum_byte *paper );
 
+/* Write the eight pixels of `data' to `pixels', one byte each, as `ink'
+   where the bit is set and `paper' where it isn't; or sixteen pixels, with
+   each one doubled, as in Timex low resolution */
+void display_expand8( libspectrum_byte *pixels, libspectrum_byte data,
+                      libspectrum_byte ink, libspectrum_byte paper );
+void display_expand8_double( libspectrum_byte *pixels, libspectrum_byte data,
+                             libspectrum_byte ink, libspectrum_byte paper );
+
+/* Write the pixels last drawn for the chunk at ( (8*x), y ), including the
+   border, to `pixels', one byte each: eight of them, or sixteen on a Timex */
+void display_chunk_pixels( int x, int y, libspectrum_byte *pixels );
+
 void display_set_lores_border(int colour);
 void display_set_hires_border(int colour);
 int display_dirty_border(void);
 
 int display_frame(void);
+
+/* Which eight-pixel chunks (sixteen on a Timex) on each line have changed
+   since the UI was last updated: bit 0 of entry 0 is the top left chunk.
+   Valid while the UI is being updated, up to and including
+   uidisplay_frame_end(), for anything which would rather work from this
+   than from the uidisplay_area() rectangles */
+const libspectrum_qword* display_get_frame_dirty( void );
+
+/* The index of the lowest set bit in, and the number of set bits in, a
+   non-zero dirty mask */
+#if GNUC_PREREQ(3, 4)
+
+#define display_dirty_lowest( mask ) __builtin_ctzll( mask )
+#define display_dirty_count( mask ) __builtin_popcountll( mask )
+
+#else				/* #if GNUC_PREREQ(3, 4) */
+
+static inline int
+display_dirty_lowest( libspectrum_qword mask )
+{
+  int n = 0;
+  while( !( mask & 0x01 ) ) { mask >>= 1; n++; }
+  return n;
+}
+
+static inline int
+display_dirty_count( libspectrum_qword mask )
+{
+  int n = 0;
+  while( mask ) { mask &= mask - 1; n++; }
+  return n;
+}
+
+#endif				/* #if GNUC_PREREQ(3, 4) */
+
 void display_refresh_main_screen(void);
 void display_refresh_all(void);
 
@@ -53,12 +53,15 @@
 #include <libxml/encoding.h>
 #endif
 
+#include "batch.h"
 #include "debugger/debugger.h"
 #include "debugger/gdbserver.h"
 #include "display.h"
 #include "event.h"
 #include "fuse.h"
 #include "infrastructure/startup_manager.h"
+#include "inputlog.h"
+#include "inputseq.h"
 #include "keyboard.h"
 #include "machine.h"
 #include "machines/machines_periph.h"
@@ -74,6 +77,7 @@
 #include "peripherals/fuller.h"
 #include "peripherals/ide/divide.h"
 #include "peripherals/ide/divmmc.h"
+#include "peripherals/ide/ideimage.h"
 #include "peripherals/ide/simpleide.h"
 #include "peripherals/ide/zxatasp.h"
 #include "peripherals/ide/zxcf.h"
@@ -84,6 +88,7 @@
 #include "peripherals/kempmouse.h"
 #include "peripherals/melodik.h"
 #include "peripherals/multiface.h"
+#include "peripherals/nic/vnet.h"
 #include "peripherals/printer.h"
 #include "peripherals/scld.h"
 #include "peripherals/speccyboot.h"
@@ -95,6 +100,7 @@
 #include "pokefinder/pokemem.h"
 #include "profile.h"
 #include "psg.h"
+#include "rawdump.h"
 #include "rzx.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -102,6 +108,7 @@
 #include "snapshot.h"
 #include "sound.h"
 #include "spectrum.h"
+#include "statehash.h"
 #include "tape.h"
 #include "timer/timer.h"
 #include "ui/scaler/scaler.h"
@@ -193,6 +200,8 @@ int main(int argc, char **argv)
 
   if( settings_current.unittests ) {
     r = unittests_run();
+  } else if( settings_current.batch_file ) {
+    r = batch_run();
   } else {
     while( !fuse_exiting ) {
       z80_do_opcodes();    // does opcodes until next scheduled event looking up global event_next_event var
@@ -334,8 +343,11 @@ run_startup_manager( int *argc, char ***argv )
   event_register_startup();
   fdd_register_startup();
   fuller_register_startup();
+  ideimage_register_startup();
   if1_register_startup();
   if2_register_startup();
+  inputlog_register_startup();
+  inputseq_register_startup();
   joystick_register_startup();
   kempmouse_register_startup();
   keyboard_register_startup();
@@ -365,11 +377,13 @@ run_startup_manager( int *argc, char ***argv )
   specdrum_register_startup();
   spectranet_register_startup();
   spectrum_register_startup();
+  statehash_register_startup();
   tape_register_startup();
   ttx2000s_register_startup();
   timer_register_startup();
   ula_register_startup();
   usource_register_startup();
+  vnet_register_startup();
   z80_register_startup();
   zxatasp_register_startup();
   zxcf_register_startup();
@@ -416,6 +430,9 @@ int fuse_init(int argc, char **argv)
 
   fuse_show_copyright();
 
+  /* Before the UI starts asking for scalers */
+  scaler_init();
+
   if( run_startup_manager( &argc, &argv ) ) return 1;
 
   error = machine_select_id( settings_current.start_machine );
@@ -435,6 +452,7 @@ int fuse_init(int argc, char **argv)
 
   fuse_emulation_paused = 0;
   movie_init();
+  rawdump_init();
 
   return 0;
 }
@@ -546,6 +564,7 @@ static void fuse_show_help( void )
    "--slt                  Turn SLT traps on.\n"
    "--traps                Turn tape traps on.\n\n"
    "Other options:\n\n"
+   "--batch <filename>     Run the files listed in <filename> and exit.\n"
    "--help                 This information.\n"
    "--machine <type>       Which machine should be emulated?\n"
    "--playback <filename>  Play back RZX file <filename>.\n"
@@ -979,11 +998,13 @@ do_start_files( start_files_t *start_files )
 int fuse_end(void)
 {
   movie_stop();		/* stop movie recording */
+  rawdump_stop();
 
   startup_manager_run_end();
 
   periph_end();
   ui_end();
+  scaler_end();
   ui_media_drive_end();
   module_end();
   pokemem_end();
@@ -0,0 +1,147 @@
+#!/usr/bin/perl -w
+
+# loader_signatures.pl: suggest loader acceleration signatures from a
+#                       profile map
+# Copyright (c) 2026 Philip Kendall
+
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Author contact information:
+
+# E-mail: philip-fuse@shadowmagic.org.uk
+
+# Usage: loader_signatures.pl <profile map> <memory dump> [<count>]
+#
+# <profile map> is the file written by Machine/Profiler/Stop while a
+# game's custom loader was running, and <memory dump> is the full 64K
+# address space saved with File/Save Binary Data... (start 0, length
+# 65536) at the same point. The <count> (default 4) hottest IN A,(nn)
+# instructions which sit inside a short backward loop are printed as
+# entries suitable for the `signatures' table in loader.c.
+
+use strict;
+
+my $SIGNATURE_IN_OFFSET = 6;	# Must match loader.c
+my $SIGNATURE_LENGTH = 16;	# Must match loader.c
+
+die "usage: $0 <profile map> <memory dump> [<count>]\n" unless @ARGV >= 2;
+
+my( $map_file, $dump_file, $count ) = @ARGV;
+$count = 4 unless defined $count;
+
+my %tstates;
+open my $map, '<', $map_file or die "$0: couldn't open '$map_file': $!\n";
+while( <$map> ) {
+    next unless /^0x([0-9a-f]{4}),(\d+)$/i;
+    $tstates{ hex $1 } = $2;
+}
+close $map;
+
+open my $dump, '<', $dump_file or die "$0: couldn't open '$dump_file': $!\n";
+binmode $dump;
+my $memory;
+read( $dump, $memory, 0x10000 ) == 0x10000
+    or die "$0: '$dump_file' is not a 64K memory dump\n";
+close $dump;
+
+sub byte ($) { ord substr( $memory, $_[0] & 0xffff, 1 ) }
+
+# Find the end of a backward loop containing $in, returning the list of
+# signature values from $start to the end of the loop and the loop offset
+sub harvest ($) {
+
+    my( $in ) = @_;
+
+    my $start = ( $in + 2 - $SIGNATURE_IN_OFFSET ) & 0xffff;
+    my @pattern;
+    my $mode = 'ACCELERATION_MODE_NONE';
+    my $mask = 0x20;
+
+    for( my $i = 0; $i < $SIGNATURE_LENGTH - 1; $i++ ) {
+
+	my $address = ( $start + $i ) & 0xffff;
+	my $b = byte $address;
+
+	if( $i == $SIGNATURE_IN_OFFSET - 3 &&
+	    byte( $address - 1 ) == 0x3e ) {
+	    # Operand of the LD A,nn before the IN: the port's high byte
+	    push @pattern, 'SIGNATURE_ANY';
+	    next;
+	}
+
+	$mode = 'ACCELERATION_MODE_INCREASING' if $b == 0x04 && $i < 4;
+	$mode = 'ACCELERATION_MODE_DECREASING' if $b == 0x05 && $i < 4;
+
+	$mask = byte( $address + 1 ) if $b == 0xe6 && $i > $SIGNATURE_IN_OFFSET;
+
+	if( ( $b == 0x28 || $b == 0x20 ) && $i >= $SIGNATURE_IN_OFFSET ) {
+	    # JR Z or JR NZ back to somewhere at or before the counter
+	    my $target = ( $address + 2 + unpack( 'c', chr byte( $address + 1 ) ) )
+		& 0xffff;
+	    my $offset = ( $target - $start ) & 0xffff;
+	    if( $offset < $SIGNATURE_IN_OFFSET - 2 ) {
+		# The jump plus SIGNATURE_END must fit in the pattern
+		return if @pattern + 3 > $SIGNATURE_LENGTH;
+		push @pattern, sprintf( '0x%02x', $b ), 'SIGNATURE_LOOP_JR';
+		return( $mode, $mask, $offset, @pattern );
+	    }
+	}
+
+	if( ( $b == 0xca || $b == 0xc2 ) && $i >= $SIGNATURE_IN_OFFSET ) {
+	    # JP Z or JP NZ back to somewhere at or before the counter
+	    my $target = byte( $address + 1 ) | ( byte( $address + 2 ) << 8 );
+	    my $offset = ( $target - $start ) & 0xffff;
+	    if( $offset < $SIGNATURE_IN_OFFSET - 2 ) {
+		return if @pattern + 4 > $SIGNATURE_LENGTH;
+		push @pattern, sprintf( '0x%02x', $b ), 'SIGNATURE_LOOP_LOW',
+		    'SIGNATURE_LOOP_HIGH';
+		return( $mode, $mask, $offset, @pattern );
+	    }
+	}
+
+	push @pattern, sprintf( '0x%02x', $b );
+    }
+
+    return;
+}
+
+my @candidates = grep { byte( $_ ) == 0xdb } keys %tstates;
+@candidates = sort { $tstates{$b} <=> $tstates{$a} } @candidates;
+
+my $found = 0;
+foreach my $in ( @candidates ) {
+
+    last if $found >= $count;
+
+    my( $mode, $mask, $offset, @pattern ) = harvest( $in );
+    next unless @pattern;
+
+    # Anything before the start of the loop isn't part of the signature
+    $pattern[$_] = 'SIGNATURE_ANY' for 0 .. $offset - 1;
+
+    if( $mode eq 'ACCELERATION_MODE_NONE' ) {
+	warn sprintf( "%s: loop at 0x%04x has no INC B or DEC B; skipping\n",
+		      $0, $in );
+	next;
+    }
+
+    printf "  { \"Unknown loader at 0x%04x\", %s, 0x%02x, 1, %d,\n",
+	$in, $mode, $mask, $offset;
+    print "    { ", join( ', ', @pattern, 'SIGNATURE_END' ), " } },\n\n";
+
+    $found++;
+}
+
+warn "$0: no candidate edge-finding loops found\n" unless $found;
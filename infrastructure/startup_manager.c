@@ -29,6 +29,7 @@
 
 #include "libspectrum.h"
 
+#include "compat.h"
 #include "startup_manager.h"
 #include "ui/ui.h"
 
@@ -40,34 +41,62 @@ typedef struct registered_module_t {
   startup_manager_end_fn end_fn;
 } registered_module_t;
 
+typedef struct init_time_t {
+  startup_manager_module module;
+  double time;
+} init_time_t;
+
 static GArray *registered_modules;
 
+/* Modules which are initialised only when first required */
+static GArray *lazy_modules;
+
 static GArray *end_functions;
 
+/* How long each module's init function took */
+static GArray *init_times;
+
 void
 startup_manager_init( void )
 {
   registered_modules =
     g_array_new( FALSE, FALSE, sizeof( registered_module_t ) );
+  lazy_modules =
+    g_array_new( FALSE, FALSE, sizeof( registered_module_t ) );
   end_functions =
     g_array_new( FALSE, FALSE, sizeof( startup_manager_end_fn ) );
+  init_times =
+    g_array_new( FALSE, FALSE, sizeof( init_time_t ) );
 }
 
 static void
 startup_manager_end( void )
 {
+  guint i;
+
   g_array_free( registered_modules, TRUE );
   registered_modules = NULL;
 
+  for( i = 0; i < lazy_modules->len; i++ )
+    g_array_free(
+      g_array_index( lazy_modules, registered_module_t, i ).dependencies,
+      TRUE
+    );
+  g_array_free( lazy_modules, TRUE );
+  lazy_modules = NULL;
+
   g_array_free( end_functions, TRUE );
   end_functions = NULL;
+
+  g_array_free( init_times, TRUE );
+  init_times = NULL;
 }
 
-void
-startup_manager_register(
-  startup_manager_module module, startup_manager_module *dependencies,
-  size_t dependency_count, startup_manager_init_fn init_fn,
-  void *init_context, startup_manager_end_fn end_fn )
+static registered_module_t
+new_module( startup_manager_module module,
+            startup_manager_module *dependencies, size_t dependency_count,
+            startup_manager_init_fn init_fn, void *init_context,
+            startup_manager_end_fn end_fn )
 {
   registered_module_t registered_module;
 
@@ -81,9 +110,35 @@ startup_manager_register(
   registered_module.init_context = init_context;
   registered_module.end_fn = end_fn;
 
+  return registered_module;
+}
+
+void
+startup_manager_register(
+  startup_manager_module module, startup_manager_module *dependencies,
+  size_t dependency_count, startup_manager_init_fn init_fn,
+  void *init_context, startup_manager_end_fn end_fn )
+{
+  registered_module_t registered_module =
+    new_module( module, dependencies, dependency_count, init_fn,
+                init_context, end_fn );
+
   g_array_append_val( registered_modules, registered_module );
 }
 
+void
+startup_manager_register_lazy(
+  startup_manager_module module, startup_manager_module *dependencies,
+  size_t dependency_count, startup_manager_init_fn init_fn,
+  void *init_context, startup_manager_end_fn end_fn )
+{
+  registered_module_t registered_module =
+    new_module( module, dependencies, dependency_count, init_fn,
+                init_context, end_fn );
+
+  g_array_append_val( lazy_modules, registered_module );
+}
+
 void
 startup_manager_register_no_dependencies(
   startup_manager_module module, startup_manager_init_fn init_fn,
@@ -114,6 +169,33 @@ remove_dependency( startup_manager_module module )
   }
 }
 
+/* Call a module's init function, timing it, and queue its end function */
+static int
+init_module( registered_module_t *registered_module )
+{
+  init_time_t init_time;
+  double start;
+  int error;
+
+  init_time.module = registered_module->module;
+
+  if( registered_module->init_fn ) {
+    start = compat_timer_get_time();
+    error = registered_module->init_fn( registered_module->init_context );
+    if( error ) return error;
+    init_time.time = compat_timer_get_time() - start;
+  } else {
+    init_time.time = 0;
+  }
+
+  g_array_append_val( init_times, init_time );
+
+  if( registered_module->end_fn )
+    g_array_append_val( end_functions, registered_module->end_fn );
+
+  return 0;
+}
+
 int
 startup_manager_run( void )
 {
@@ -134,15 +216,8 @@ startup_manager_run( void )
 
       if( registered_module->dependencies->len == 0 ) {
 
-        if( registered_module->init_fn ) {
-          error = registered_module->init_fn(
-            registered_module->init_context
-          );
-          if( error ) return error;
-        }
-
-        if( registered_module->end_fn )
-          g_array_append_val( end_functions, registered_module->end_fn );
+        error = init_module( registered_module );
+        if( error ) return error;
 
         remove_dependency( registered_module->module );
 
@@ -166,6 +241,55 @@ startup_manager_run( void )
   return 0;
 }
 
+int
+startup_manager_require( startup_manager_module module )
+{
+  registered_module_t registered_module;
+  startup_manager_module dependency;
+  guint i;
+  int error = 0;
+
+  for( i = 0; i < lazy_modules->len; i++ )
+    if( g_array_index( lazy_modules, registered_module_t, i ).module ==
+        module )
+      break;
+
+  /* Either not a lazy module, or already initialised */
+  if( i == lazy_modules->len ) return 0;
+
+  /* Take the module off the list first so that a circular dependency can't
+     recurse for ever */
+  registered_module = g_array_index( lazy_modules, registered_module_t, i );
+  g_array_remove_index_fast( lazy_modules, i );
+
+  /* Everything else a lazy module depends on was initialised by
+     startup_manager_run() */
+  for( i = 0; !error && i < registered_module.dependencies->len; i++ ) {
+    dependency =
+      g_array_index( registered_module.dependencies, startup_manager_module,
+                     i );
+    error = startup_manager_require( dependency );
+  }
+
+  g_array_free( registered_module.dependencies, TRUE );
+  if( error ) return error;
+
+  return init_module( &registered_module );
+}
+
+double
+startup_manager_init_time( startup_manager_module module )
+{
+  guint i;
+
+  for( i = 0; i < init_times->len; i++ ) {
+    init_time_t *init_time = &g_array_index( init_times, init_time_t, i );
+    if( init_time->module == module ) return init_time->time;
+  }
+
+  return -1;
+}
+
 void
 startup_manager_run_end( void )
 {
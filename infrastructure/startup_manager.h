@@ -40,8 +40,11 @@ typedef enum startup_manager_module {
   STARTUP_MANAGER_MODULE_EVENT,
   STARTUP_MANAGER_MODULE_FDD,
   STARTUP_MANAGER_MODULE_FULLER,
+  STARTUP_MANAGER_MODULE_IDEIMAGE,
   STARTUP_MANAGER_MODULE_IF1,
   STARTUP_MANAGER_MODULE_IF2,
+  STARTUP_MANAGER_MODULE_INPUTLOG,
+  STARTUP_MANAGER_MODULE_INPUTSEQ,
   STARTUP_MANAGER_MODULE_JOYSTICK,
   STARTUP_MANAGER_MODULE_KEMPMOUSE,
   STARTUP_MANAGER_MODULE_KEYBOARD,
@@ -68,14 +71,18 @@ typedef enum startup_manager_module {
   STARTUP_MANAGER_MODULE_SLT,
   STARTUP_MANAGER_MODULE_SOUND,
   STARTUP_MANAGER_MODULE_SPECCYBOOT,
+  STARTUP_MANAGER_MODULE_SPECCYBOOT_NIC,
   STARTUP_MANAGER_MODULE_SPECDRUM,
   STARTUP_MANAGER_MODULE_SPECTRANET,
+  STARTUP_MANAGER_MODULE_SPECTRANET_NIC,
   STARTUP_MANAGER_MODULE_SPECTRUM,
+  STARTUP_MANAGER_MODULE_STATEHASH,
   STARTUP_MANAGER_MODULE_TAPE,
   STARTUP_MANAGER_MODULE_TTX2000S,
   STARTUP_MANAGER_MODULE_TIMER,
   STARTUP_MANAGER_MODULE_ULA,
   STARTUP_MANAGER_MODULE_USOURCE,
+  STARTUP_MANAGER_MODULE_VNET,
   STARTUP_MANAGER_MODULE_Z80,
   STARTUP_MANAGER_MODULE_ZXATASP,
   STARTUP_MANAGER_MODULE_ZXCF,
@@ -103,9 +110,25 @@ void startup_manager_register_no_dependencies(
   startup_manager_module module, startup_manager_init_fn init_fn,
   void *init_context, startup_manager_end_fn end_fn );
 
+/* Register a module whose init function is called only when it is first
+   required by startup_manager_require(), rather than at startup. Its
+   dependencies must be either other lazy modules or ordinary modules */
+void startup_manager_register_lazy(
+  startup_manager_module module, startup_manager_module *dependencies,
+  size_t dependency_count, startup_manager_init_fn init_fn,
+  void *init_context, startup_manager_end_fn end_fn );
+
 /* Run all the registered init functions in the right order */
 int startup_manager_run( void );
 
+/* Initialise a lazy module, and any lazy modules it depends on, if that
+   hasn't already been done. Must be called after startup_manager_run() */
+int startup_manager_require( startup_manager_module module );
+
+/* How long, in seconds, the module's init function took, or -1 if it
+   hasn't been initialised */
+double startup_manager_init_time( startup_manager_module module );
+
 /* Run all the end functions in inverse order of the init functions */
 void startup_manager_run_end( void );
 
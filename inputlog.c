@@ -0,0 +1,381 @@
+/* inputlog.c: recording and playback of input-only replay logs
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* Unlike an RZX file, which stores the result of every IN instruction, an
+   input log stores only what the user did to the emulated keyboard,
+   joysticks and mouse, once per frame and only when it changes. Everything
+   else is recreated by running the emulation again from the same starting
+   snapshot, so every so often statehash_full() is stored too,
+   to check that playback hasn't gone off the rails.
+
+   Offset  Length  Contents
+        0       4  "FILG"
+        4       1  Format version (1)
+        5       4  Frames between state hashes (little endian)
+        9       4  Length of the starting snapshot (little endian)
+       13       -  Starting snapshot, in .szx format
+        -       -  Records, each:
+                      1  Type: 'I', 'H' or 'E'
+                      4  Frame number (little endian)
+                      -  'I': the inputs from this frame on
+                         'H': the state hash at the end of this frame
+                         'E': nothing; this is the last frame
+
+   The inputs are the keyboard half-rows, then the joystick interfaces, then
+   the Kempston mouse. */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "fuse.h"
+#include "infrastructure/startup_manager.h"
+#include "inputlog.h"
+#include "keyboard.h"
+#include "peripherals/joystick.h"
+#include "peripherals/kempmouse.h"
+#include "snapshot.h"
+#include "statehash.h"
+#include "ui/ui.h"
+#include "utils.h"
+
+#define INPUTLOG_INPUT_LENGTH \
+  ( 8 + JOYSTICK_STATE_LENGTH + KEMPMOUSE_STATE_LENGTH )
+
+#define INPUTLOG_HEADER_LENGTH 13
+#define INPUTLOG_RECORD_HEADER_LENGTH 5
+#define INPUTLOG_HASH_LENGTH 8
+
+static const libspectrum_byte signature[] = { 'F', 'I', 'L', 'G', 1 };
+
+int inputlog_recording;
+int inputlog_playback;
+
+/* The log being recorded */
+static GArray *recording;
+static char *recording_filename;
+
+/* The log being played back, and how far through it we are */
+static utils_file playback;
+static size_t playback_offset;
+
+/* Frames since recording or playback started */
+static libspectrum_dword frame;
+
+static libspectrum_dword hash_interval;
+
+/* The inputs from the last 'I' record */
+static libspectrum_byte inputs[ INPUTLOG_INPUT_LENGTH ];
+
+static long divergence = -1;
+
+static void playback_frame( void );
+
+static void
+put_value( libspectrum_byte *buffer, libspectrum_qword value, size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ ) { buffer[i] = value & 0xff; value >>= 8; }
+}
+
+static libspectrum_qword
+get_value( const libspectrum_byte *buffer, size_t length )
+{
+  libspectrum_qword value = 0;
+
+  while( length-- ) value = ( value << 8 ) | buffer[length];
+
+  return value;
+}
+
+static void
+get_inputs( libspectrum_byte *buffer )
+{
+  memcpy( buffer, keyboard_return_values, 8 );
+  joystick_state_get( &buffer[8] );
+  kempmouse_state_get( &buffer[ 8 + JOYSTICK_STATE_LENGTH ] );
+}
+
+static void
+set_inputs( const libspectrum_byte *buffer )
+{
+  memcpy( keyboard_return_values, buffer, 8 );
+  joystick_state_set( &buffer[8] );
+  kempmouse_state_set( &buffer[ 8 + JOYSTICK_STATE_LENGTH ] );
+}
+
+static void
+add_record( libspectrum_byte type, const libspectrum_byte *data,
+            size_t length )
+{
+  libspectrum_byte header[ INPUTLOG_RECORD_HEADER_LENGTH ];
+
+  header[0] = type;
+  put_value( &header[1], frame, 4 );
+
+  g_array_append_vals( recording, header, INPUTLOG_RECORD_HEADER_LENGTH );
+  if( length ) g_array_append_vals( recording, data, length );
+}
+
+int
+inputlog_start_recording( const char *filename,
+                          libspectrum_dword interval )
+{
+  libspectrum_snap *snap;
+  libspectrum_byte header[ INPUTLOG_HEADER_LENGTH ];
+  libspectrum_byte *buffer; size_t length;
+  int flags, error;
+
+  if( inputlog_recording || inputlog_playback ) return 1;
+
+  snap = libspectrum_snap_alloc();
+
+  error = snapshot_copy_to( snap );
+  if( error ) { libspectrum_snap_free( snap ); return error; }
+
+  flags = 0;
+  length = 0;
+  buffer = NULL;
+  error = libspectrum_snap_write( &buffer, &length, &flags, snap,
+                                  LIBSPECTRUM_ID_SNAPSHOT_SZX, fuse_creator,
+                                  0 );
+  libspectrum_snap_free( snap );
+  if( error ) return error;
+
+  hash_interval = interval ? interval : INPUTLOG_HASH_INTERVAL;
+
+  memcpy( header, signature, sizeof( signature ) );
+  put_value( &header[5], hash_interval, 4 );
+  put_value( &header[9], length, 4 );
+
+  recording = g_array_new( FALSE, FALSE, sizeof( libspectrum_byte ) );
+  g_array_append_vals( recording, header, INPUTLOG_HEADER_LENGTH );
+  g_array_append_vals( recording, buffer, length );
+  libspectrum_free( buffer );
+
+  recording_filename = utils_safe_strdup( filename );
+
+  frame = 0;
+  get_inputs( inputs );
+  add_record( 'I', inputs, INPUTLOG_INPUT_LENGTH );
+
+  inputlog_recording = 1;
+
+  return 0;
+}
+
+int
+inputlog_stop_recording( void )
+{
+  int error;
+
+  if( !inputlog_recording ) return 0;
+
+  inputlog_recording = 0;
+
+  add_record( 'E', NULL, 0 );
+
+  error = utils_write_file( recording_filename,
+                            (unsigned char *)recording->data,
+                            recording->len );
+
+  g_array_free( recording, TRUE );
+  recording = NULL;
+  libspectrum_free( recording_filename );
+  recording_filename = NULL;
+
+  return error;
+}
+
+static void
+record_frame( void )
+{
+  libspectrum_byte current[ INPUTLOG_INPUT_LENGTH ];
+  libspectrum_byte hash[ INPUTLOG_HASH_LENGTH ];
+
+  get_inputs( current );
+  if( memcmp( current, inputs, INPUTLOG_INPUT_LENGTH ) ) {
+    memcpy( inputs, current, INPUTLOG_INPUT_LENGTH );
+    add_record( 'I', inputs, INPUTLOG_INPUT_LENGTH );
+  }
+
+  if( frame % hash_interval == 0 ) {
+    put_value( hash, statehash_full(), INPUTLOG_HASH_LENGTH );
+    add_record( 'H', hash, INPUTLOG_HASH_LENGTH );
+  }
+}
+
+int
+inputlog_start_playback( const char *filename )
+{
+  size_t length;
+  int error;
+
+  if( inputlog_recording || inputlog_playback ) return 1;
+
+  error = utils_read_file( filename, &playback );
+  if( error ) return error;
+
+  if( playback.length < INPUTLOG_HEADER_LENGTH ||
+      memcmp( playback.buffer, signature, sizeof( signature ) ) ) {
+    ui_error( UI_ERROR_ERROR, "'%s' is not an input log", filename );
+    utils_close_file( &playback );
+    return 1;
+  }
+
+  hash_interval = get_value( &playback.buffer[5], 4 );
+  length = get_value( &playback.buffer[9], 4 );
+
+  if( length > playback.length - INPUTLOG_HEADER_LENGTH ) {
+    ui_error( UI_ERROR_ERROR, "'%s' is truncated", filename );
+    utils_close_file( &playback );
+    return 1;
+  }
+
+  error = snapshot_read_buffer( &playback.buffer[ INPUTLOG_HEADER_LENGTH ],
+                                length, LIBSPECTRUM_ID_SNAPSHOT_SZX );
+  if( error ) { utils_close_file( &playback ); return error; }
+
+  playback_offset = INPUTLOG_HEADER_LENGTH + length;
+  frame = 0;
+  divergence = -1;
+  inputlog_playback = 1;
+
+  /* Pick up the inputs in place when recording started */
+  playback_frame();
+
+  return 0;
+}
+
+void
+inputlog_stop_playback( void )
+{
+  if( !inputlog_playback ) return;
+
+  inputlog_playback = 0;
+  utils_close_file( &playback );
+}
+
+long
+inputlog_divergence( void )
+{
+  return divergence;
+}
+
+static void
+playback_frame( void )
+{
+  const libspectrum_byte *record;
+  libspectrum_qword hash;
+
+  while( 1 ) {
+
+    if( playback_offset + INPUTLOG_RECORD_HEADER_LENGTH > playback.length ) {
+      ui_error( UI_ERROR_ERROR, "Input log is truncated" );
+      inputlog_stop_playback();
+      return;
+    }
+
+    record = &playback.buffer[ playback_offset ];
+    if( get_value( &record[1], 4 ) != frame ) break;
+
+    switch( record[0] ) {
+
+    case 'I':
+      if( playback_offset + INPUTLOG_RECORD_HEADER_LENGTH +
+          INPUTLOG_INPUT_LENGTH > playback.length ) {
+        ui_error( UI_ERROR_ERROR, "Input log is truncated" );
+        inputlog_stop_playback();
+        return;
+      }
+      memcpy( inputs, &record[ INPUTLOG_RECORD_HEADER_LENGTH ],
+              INPUTLOG_INPUT_LENGTH );
+      playback_offset += INPUTLOG_RECORD_HEADER_LENGTH +
+                         INPUTLOG_INPUT_LENGTH;
+      break;
+
+    case 'H':
+      if( playback_offset + INPUTLOG_RECORD_HEADER_LENGTH +
+          INPUTLOG_HASH_LENGTH > playback.length ) {
+        ui_error( UI_ERROR_ERROR, "Input log is truncated" );
+        inputlog_stop_playback();
+        return;
+      }
+      hash = get_value( &record[ INPUTLOG_RECORD_HEADER_LENGTH ],
+                        INPUTLOG_HASH_LENGTH );
+      if( hash != statehash_full() ) {
+        divergence = frame;
+        ui_error( UI_ERROR_WARNING,
+                  "Input log playback diverged at frame %lu",
+                  (unsigned long)frame );
+        inputlog_stop_playback();
+        return;
+      }
+      playback_offset += INPUTLOG_RECORD_HEADER_LENGTH +
+                         INPUTLOG_HASH_LENGTH;
+      break;
+
+    case 'E':
+      inputlog_stop_playback();
+      return;
+
+    default:
+      ui_error( UI_ERROR_ERROR, "Unknown input log record type 0x%02x",
+                record[0] );
+      inputlog_stop_playback();
+      return;
+    }
+  }
+
+  /* Override anything the UI has done since the last frame */
+  set_inputs( inputs );
+}
+
+void
+inputlog_frame( void )
+{
+  if( inputlog_recording ) {
+    frame++;
+    record_frame();
+  } else if( inputlog_playback ) {
+    frame++;
+    playback_frame();
+  }
+}
+
+static void
+inputlog_end( void )
+{
+  if( inputlog_recording ) inputlog_stop_recording();
+  if( inputlog_playback ) inputlog_stop_playback();
+}
+
+void
+inputlog_register_startup( void )
+{
+  startup_manager_register_no_dependencies( STARTUP_MANAGER_MODULE_INPUTLOG,
+                                            NULL, NULL, inputlog_end );
+}
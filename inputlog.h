@@ -0,0 +1,51 @@
+/* inputlog.h: recording and playback of input-only replay logs
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_INPUTLOG_H
+#define FUSE_INPUTLOG_H
+
+#include "libspectrum.h"
+
+/* The default number of frames between state hashes */
+#define INPUTLOG_HASH_INTERVAL 50
+
+extern int inputlog_recording;	/* Are we recording an input log? */
+extern int inputlog_playback;	/* Are we playing back an input log? */
+
+void inputlog_register_startup( void );
+
+int inputlog_start_recording( const char *filename,
+                              libspectrum_dword hash_interval );
+int inputlog_stop_recording( void );
+
+int inputlog_start_playback( const char *filename );
+void inputlog_stop_playback( void );
+
+/* The frame at which the last playback diverged from the recording, or -1
+   if it didn't */
+long inputlog_divergence( void );
+
+/* Called at the end of every frame, once the UI has updated the inputs */
+void inputlog_frame( void );
+
+#endif			/* #ifndef FUSE_INPUTLOG_H */
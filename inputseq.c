@@ -0,0 +1,321 @@
+/* inputseq.c: scripted sequences of inputs applied at the end of each frame
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* An input sequence is a list of steps, each of which sets the keyboard,
+   joysticks and mouse, holds them for a number of frames and then
+   optionally waits for something to happen in the emulation before going
+   on to the next step. Everything runs from the end of each frame, so a
+   script can navigate a menu or start a game without having to look at
+   the machine every frame, and runs the same way every time.
+
+   While a sequence is running, it overrides anything the UI does to the
+   inputs; once it has finished, the inputs from before it started are put
+   back. */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "infrastructure/startup_manager.h"
+#include "inputseq.h"
+#include "memory_pages.h"
+#include "spectrum.h"
+#include "ui/ui.h"
+
+/* The length of the bitmap and attributes of the normal screen */
+#define INPUTSEQ_SCREEN_LENGTH 6912
+
+int inputseq_active;
+int inputseq_pc_wait;
+libspectrum_word inputseq_pc;
+
+static inputseq_step *steps;
+static size_t step_count, current;
+
+/* Frames since the current step started, and since its inputs were first
+   held for long enough */
+static libspectrum_dword elapsed, waited;
+
+static int pc_reached;
+
+/* The screen from the last frame, and how many frames it has stayed the
+   same for */
+static libspectrum_byte screen[ INPUTSEQ_SCREEN_LENGTH ];
+static int screen_valid;
+static libspectrum_dword unchanged;
+
+/* The inputs from before the sequence started */
+static libspectrum_byte saved_keyboard[8];
+static libspectrum_byte saved_joystick[ JOYSTICK_STATE_LENGTH ];
+static libspectrum_byte saved_mouse[ KEMPMOUSE_STATE_LENGTH ];
+
+static long timed_out = -1;
+
+void
+inputseq_step_init( inputseq_step *step )
+{
+  memset( step, 0, sizeof( *step ) );
+
+  step->frames = 1;
+  memset( step->keyboard, 0xff, sizeof( step->keyboard ) );
+
+  /* The Fuller joystick is active low; the others active high */
+  step->joystick[3] = 0xff;
+
+  step->wait = INPUTSEQ_WAIT_NONE;
+  step->mask = 0xff;
+}
+
+void
+inputseq_step_press( inputseq_step *step, keyboard_key_name key )
+{
+  int i;
+
+  for( i = 0; i < 8; i++ )
+    step->keyboard[i] &= keyboard_simulate_keypress( ~( 1 << i ), key );
+}
+
+static void
+apply_step( const inputseq_step *step )
+{
+  memcpy( keyboard_return_values, step->keyboard, 8 );
+  joystick_state_set( step->joystick );
+  if( step->mouse ) kempmouse_state_set( step->mouse_state );
+}
+
+static void
+begin_step( size_t index )
+{
+  const inputseq_step *step = &steps[ index ];
+
+  current = index;
+  elapsed = waited = 0;
+  pc_reached = 0;
+  screen_valid = 0;
+  unchanged = 0;
+
+  /* Watch for the PC from the start of the step, so an address passed
+     through while the inputs are being held still counts */
+  inputseq_pc_wait = step->wait == INPUTSEQ_WAIT_PC;
+  inputseq_pc = step->address;
+
+  apply_step( step );
+}
+
+static void
+finish( void )
+{
+  inputseq_active = 0;
+  inputseq_pc_wait = 0;
+
+  memcpy( keyboard_return_values, saved_keyboard, 8 );
+  joystick_state_set( saved_joystick );
+  kempmouse_state_set( saved_mouse );
+
+  libspectrum_free( steps );
+  steps = NULL;
+  step_count = 0;
+}
+
+int
+inputseq_start( const inputseq_step *new_steps, size_t count )
+{
+  if( !count ) {
+    ui_error( UI_ERROR_ERROR, "Input sequence has no steps" );
+    return 1;
+  }
+
+  if( inputseq_active ) finish();
+
+  memcpy( saved_keyboard, keyboard_return_values, 8 );
+  joystick_state_get( saved_joystick );
+  kempmouse_state_get( saved_mouse );
+
+  steps = libspectrum_new( inputseq_step, count );
+  memcpy( steps, new_steps, count * sizeof( *steps ) );
+  step_count = count;
+
+  timed_out = -1;
+  inputseq_active = 1;
+
+  begin_step( 0 );
+
+  return 0;
+}
+
+void
+inputseq_stop( void )
+{
+  if( inputseq_active ) finish();
+}
+
+long
+inputseq_timed_out( void )
+{
+  return timed_out;
+}
+
+void
+inputseq_pc_hit( void )
+{
+  pc_reached = 1;
+  inputseq_pc_wait = 0;
+}
+
+static void
+track_screen( void )
+{
+  const libspectrum_byte *display = RAM[ memory_current_screen ];
+
+  if( screen_valid && !memcmp( screen, display, INPUTSEQ_SCREEN_LENGTH ) ) {
+    unchanged++;
+  } else {
+    memcpy( screen, display, INPUTSEQ_SCREEN_LENGTH );
+    screen_valid = 1;
+    unchanged = 0;
+  }
+}
+
+static int
+wait_over( const inputseq_step *step )
+{
+  switch( step->wait ) {
+
+  case INPUTSEQ_WAIT_NONE:
+    return 1;
+
+  case INPUTSEQ_WAIT_PC:
+    return pc_reached;
+
+  case INPUTSEQ_WAIT_MEMORY:
+    return ( readbyte_internal( step->address ) & step->mask ) == step->value;
+
+  case INPUTSEQ_WAIT_SCREEN:
+    return unchanged >= step->settle;
+
+  }
+
+  return 1;
+}
+
+void
+inputseq_frame( void )
+{
+  const inputseq_step *step;
+
+  if( !inputseq_active ) return;
+
+  step = &steps[ current ];
+
+  elapsed++;
+  if( step->wait == INPUTSEQ_WAIT_SCREEN ) track_screen();
+
+  if( elapsed >= step->frames ) {
+
+    if( wait_over( step ) ) {
+      if( current + 1 < step_count ) {
+        begin_step( current + 1 );
+      } else {
+        finish();
+      }
+      return;
+    }
+
+    if( step->timeout && ++waited >= step->timeout ) {
+      timed_out = current;
+      ui_error( UI_ERROR_WARNING, "Input sequence timed out at step %lu",
+                (unsigned long)current );
+      finish();
+      return;
+    }
+
+  }
+
+  /* Override anything the UI has done since the last frame */
+  apply_step( step );
+}
+
+static void
+inputseq_end( void )
+{
+  inputseq_stop();
+}
+
+void
+inputseq_register_startup( void )
+{
+  startup_manager_register_no_dependencies( STARTUP_MANAGER_MODULE_INPUTSEQ,
+                                            NULL, NULL, inputseq_end );
+}
+
+int
+inputseq_unittest( void )
+{
+  inputseq_step test_steps[3];
+  libspectrum_byte old_keyboard[8];
+  int r = 0;
+
+  memcpy( old_keyboard, keyboard_return_values, 8 );
+
+  inputseq_step_init( &test_steps[0] );
+  inputseq_step_press( &test_steps[0], KEYBOARD_j );
+  test_steps[0].frames = 2;
+
+  inputseq_step_init( &test_steps[1] );
+  inputseq_step_press( &test_steps[1], KEYBOARD_Enter );
+  test_steps[1].wait = INPUTSEQ_WAIT_PC;
+  test_steps[1].address = 0x1234;
+
+  inputseq_step_init( &test_steps[2] );
+  test_steps[2].wait = INPUTSEQ_WAIT_PC;
+  test_steps[2].address = 0x4321;
+  test_steps[2].timeout = 2;
+
+  /* J is pressed straight away, and held for two frames */
+  if( inputseq_start( test_steps, 3 ) ) return 1;
+  if( keyboard_read( 0xbf ) & 0x08 ) r++;
+  inputseq_frame();
+  if( keyboard_read( 0xbf ) & 0x08 ) r++;
+  inputseq_frame();
+  if( !( keyboard_read( 0xbf ) & 0x08 ) || keyboard_read( 0xbf ) & 0x01 ) r++;
+
+  /* Enter stays pressed until the PC is reached */
+  if( !inputseq_pc_wait || inputseq_pc != 0x1234 ) r++;
+  inputseq_frame();
+  inputseq_frame();
+  if( keyboard_read( 0xbf ) & 0x01 ) r++;
+  inputseq_pc_hit();
+  inputseq_frame();
+  if( !( keyboard_read( 0xbf ) & 0x01 ) || inputseq_pc != 0x4321 ) r++;
+
+  /* The last step gives up, and the old inputs come back */
+  inputseq_frame();
+  if( !inputseq_active ) r++;
+  inputseq_frame();
+  if( inputseq_active || inputseq_timed_out() != 2 ) r++;
+  if( memcmp( keyboard_return_values, old_keyboard, 8 ) ) r++;
+
+  return r;
+}
@@ -0,0 +1,106 @@
+/* inputseq.h: scripted sequences of inputs applied at the end of each frame
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_INPUTSEQ_H
+#define FUSE_INPUTSEQ_H
+
+#include <stddef.h>
+
+#include "libspectrum.h"
+
+#include "keyboard.h"
+#include "peripherals/joystick.h"
+#include "peripherals/kempmouse.h"
+
+/* What a step waits for, once its inputs have been held for long enough,
+   before moving on to the next step */
+typedef enum inputseq_wait {
+
+  INPUTSEQ_WAIT_NONE,		/* Nothing */
+  INPUTSEQ_WAIT_PC,		/* The Z80 to execute the instruction at
+				   `address' */
+  INPUTSEQ_WAIT_MEMORY,		/* The byte at `address', ANDed with `mask',
+				   to equal `value' */
+  INPUTSEQ_WAIT_SCREEN,		/* The screen to stay the same for `settle'
+				   frames */
+
+} inputseq_wait;
+
+typedef struct inputseq_step {
+
+  /* How many frames to hold the inputs for; at least one */
+  libspectrum_dword frames;
+
+  /* The inputs, in the same form as the input log: the keyboard half-rows
+     and the joystick interfaces, and the Kempston mouse if `mouse' is
+     non-zero. Otherwise the mouse is left alone */
+  libspectrum_byte keyboard[8];
+  libspectrum_byte joystick[ JOYSTICK_STATE_LENGTH ];
+  int mouse;
+  libspectrum_byte mouse_state[ KEMPMOUSE_STATE_LENGTH ];
+
+  inputseq_wait wait;
+  libspectrum_word address;
+  libspectrum_byte value, mask;
+  libspectrum_dword settle;
+
+  /* How many frames to wait before giving up on the whole sequence; zero
+     waits for ever. The inputs stay held while waiting */
+  libspectrum_dword timeout;
+
+} inputseq_step;
+
+extern int inputseq_active;	/* Is a sequence running? */
+
+/* Is the sequence waiting for the PC to reach inputseq_pc? Checked before
+   every opcode while set */
+extern int inputseq_pc_wait;
+extern libspectrum_word inputseq_pc;
+
+void inputseq_register_startup( void );
+
+/* Set `step' to press nothing, hold for one frame and not wait */
+void inputseq_step_init( inputseq_step *step );
+
+/* Add `key' to the keys `step' presses */
+void inputseq_step_press( inputseq_step *step, keyboard_key_name key );
+
+/* Start running a copy of `steps', replacing any sequence already running.
+   The first step's inputs apply straight away */
+int inputseq_start( const inputseq_step *steps, size_t count );
+
+/* Stop the sequence and put back the inputs from before it started */
+void inputseq_stop( void );
+
+/* The step which timed out in the last sequence, or -1 if none did */
+long inputseq_timed_out( void );
+
+/* Called when the Z80 reaches inputseq_pc */
+void inputseq_pc_hit( void );
+
+/* Called at the end of every frame, once the UI has updated the inputs */
+void inputseq_frame( void );
+
+int inputseq_unittest( void );
+
+#endif			/* #ifndef FUSE_INPUTSEQ_H */
@@ -23,6 +23,9 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include "compat.h"
 #include "event.h"
 #include "loader.h"
 #include "memory_pages.h"
@@ -44,9 +47,134 @@ typedef enum acceleration_mode_t {
   ACCELERATION_MODE_DECREASING,
 } acceleration_mode_t;
 
-static acceleration_mode_t acceleration_mode;
+/* Values in a loader signature pattern above 0xff which don't match a
+   literal byte */
+#define SIGNATURE_ANY      0x100	/* Any byte */
+#define SIGNATURE_LOOP_JR  0x101	/* JR displacement to the loop start */
+#define SIGNATURE_LOOP_LOW 0x102	/* LSB of JP target, the loop start */
+#define SIGNATURE_LOOP_HIGH 0x103	/* MSB of JP target, the loop start */
+#define SIGNATURE_END      0x1ff	/* End of pattern */
+
+/* The edge-finding loop has been entered this many bytes after the start
+   of the signature; the IN A,(nn) instruction is always the two bytes just
+   before this */
+#define SIGNATURE_IN_OFFSET 6
+
+#define SIGNATURE_LENGTH 16
+
+/* A description of one edge-finding loop: the bytes which make it up,
+   and what the loop does with the registers when it finds an edge */
+typedef struct loader_signature_t {
+
+  const char *name;
+
+  /* Is B incremented or decremented each time round the loop? */
+  acceleration_mode_t mode;
+
+  /* The bit(s) of C holding the last edge level */
+  libspectrum_byte level_mask;
+
+  /* Is the carry flag set when the loop returns after finding an edge? */
+  int set_carry;
+
+  /* Offset of the start of the loop from the start of the signature; used
+     for SIGNATURE_LOOP_* */
+  int loop_offset;
+
+  int pattern[ SIGNATURE_LENGTH ];
+
+} loader_signature_t;
+
+/* The known edge-finding loops; new entries can be generated from a profile
+   map with hacking/loader_signatures.pl */
+static const loader_signature_t signatures[] = {
+
+  { "ROM loader", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xd0, 0xa9,
+      0xe6, 0x20, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Bleepload", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0x00, 0xa9,
+      0xe6, 0x20, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Microsphere", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xa7, 0xa9,
+      0xe6, 0x20, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Paul Owens", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xc8, 0xa9,
+      0xe6, 0x20, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Speedlock", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xa9, 0xe6,
+      0x20, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Search Loader", ACCELERATION_MODE_INCREASING, 0x40, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0xa9, 0xe6, 0x40,
+      0xd8, 0x00, 0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Space Crusade", ACCELERATION_MODE_INCREASING, 0x40, 1, 0,
+    { 0x04, 0xc8, 0x3e, SIGNATURE_ANY, 0xdb, 0xfe, 0xa9, 0xe6, 0x40,
+      0x28, SIGNATURE_LOOP_JR, SIGNATURE_END } },
+
+  { "Digital Integration", ACCELERATION_MODE_DECREASING, 0x40, 1, 2,
+    { SIGNATURE_ANY, SIGNATURE_ANY, 0x05, 0xc8, 0xdb, 0xfe, 0xa9, 0xe6,
+      0x40, 0xca, SIGNATURE_LOOP_LOW, SIGNATURE_LOOP_HIGH,
+      SIGNATURE_END } },
+
+  { "Alkatraz", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x03, 0xc3, SIGNATURE_ANY, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xc8,
+      0xa9, 0xe6, 0x20, 0x28, 0xf1, SIGNATURE_END } },
+
+  { "Alkatraz (alternative)", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x03, 0xc3, SIGNATURE_ANY, SIGNATURE_ANY, 0xdb, 0xfe, 0x1f, 0xc8,
+      0xa9, 0xe6, 0x20, 0x28, 0xf3, SIGNATURE_END } },
+
+  { "Alkatraz (variant)", ACCELERATION_MODE_INCREASING, 0x20, 1, 0,
+    { 0x04, 0x20, 0x01, 0xc9, 0xdb, 0xfe, 0x1f, 0xc8, 0xa9, 0xe6, 0x20,
+      0x28, 0xf1, SIGNATURE_END } },
+
+  { "Alkatraz (variant, alternative)", ACCELERATION_MODE_INCREASING, 0x20, 1,
+    0,
+    { 0x04, 0x20, 0x01, 0xc9, 0xdb, 0xfe, 0x1f, 0xc8, 0xa9, 0xe6, 0x20,
+      0x28, 0xf3, SIGNATURE_END } },
+
+};
+
+/* LD-8-BITS, the parity and counter updates and the final parity check
+   at the end of the ROM's LD-BYTES; loaders built from a copy of it
+   usually change only the timing constants */
+static const int ld_bytes_tail[] = {
+  0x2e, 0x01,					/* LD L,$01 */
+  0xcd, SIGNATURE_ANY, SIGNATURE_ANY,		/* CALL LD-EDGE-2 */
+  0xd0,						/* RET NC */
+  0x3e, SIGNATURE_ANY,				/* LD A,nn */
+  0xb8,						/* CP B */
+  0xcb, 0x15,					/* RL L */
+  0x06, SIGNATURE_ANY,				/* LD B,nn */
+  0xd2, SIGNATURE_LOOP_LOW, SIGNATURE_LOOP_HIGH,/* JP NC,LD-8-BITS */
+  0x7c, 0xad, 0x67,				/* LD A,H; XOR L; LD H,A */
+  0x7a, 0xb3,					/* LD A,D; OR E */
+  0x20, SIGNATURE_ANY,				/* JR NZ,LD-LOOP */
+  0x7c, 0xfe, 0x01,				/* LD A,H; CP $01 */
+  0xc9,						/* RET */
+  SIGNATURE_END
+};
+
+#define LD_BYTES_TAIL_LOOP_OFFSET 2
+#define LD_BYTES_TAIL_RET_OFFSET 26
+
+/* How far after a call to the edge-finding loop to look for the end of
+   LD-BYTES; the ROM's is 0x76 bytes after its first call */
+#define LD_BYTES_SEARCH 0x100
+
+static const loader_signature_t *acceleration_signature;
 static size_t acceleration_pc;
 
+/* The address the edge-finding loop will return to, and the final RET of
+   the LD-BYTES routine containing that address, or 0 if none was found */
+static libspectrum_word flash_load_caller, flash_load_ret;
+
 void
 loader_frame( libspectrum_dword frame_length )
 {
@@ -59,14 +187,15 @@ void
 loader_tape_play( void )
 {
   successive_reads = 0;
-  acceleration_mode = ACCELERATION_MODE_NONE;
+  acceleration_signature = NULL;
+  flash_load_caller = flash_load_ret = 0;
 }
 
 void
 loader_tape_stop( void )
 {
   successive_reads = 0;
-  acceleration_mode = ACCELERATION_MODE_NONE;
+  acceleration_signature = NULL;
 }
 
 static void
@@ -75,17 +204,19 @@ do_acceleration( void )
   if( length_known1 ) {
     /* B is used to indicate the length of the pulses */
     int set_b_high = length_long1;
-    set_b_high ^= ( acceleration_mode == ACCELERATION_MODE_DECREASING );
+    set_b_high ^=
+      ( acceleration_signature->mode == ACCELERATION_MODE_DECREASING );
     if( set_b_high ) {
       z80.bc.b.h = 0xfe;
     } else {
       z80.bc.b.h = 0x00;
     }
 
-    /* Bit 5 of C is used to indicate the current microphone level */
-    z80.bc.b.l = (z80.bc.b.l & ~0x20) | (tape_microphone ? 0x00 : 0x20);
+    /* C is used to indicate the current microphone level */
+    z80.bc.b.l &= ~acceleration_signature->level_mask;
+    if( !tape_microphone ) z80.bc.b.l |= acceleration_signature->level_mask;
 
-    z80.af.b.l |= 0x01;
+    if( acceleration_signature->set_carry ) z80.af.b.l |= 0x01;
 
     /* Simulate the RET at the end of the edge-finding loop */
     z80.pc.b.l = readbyte_internal( z80.sp.w ); z80.sp.w++;
@@ -101,305 +232,148 @@ do_acceleration( void )
   length_long1 = length_long2;
 }
 
-static acceleration_mode_t
-acceleration_detector( libspectrum_word pc )
+static int
+pattern_matches( const int *pattern, libspectrum_word start,
+                 libspectrum_word loop )
 {
-  int state = 0, count = 0;
-  while( 1 ) {
-    libspectrum_byte b = readbyte_internal( pc ); pc++; count++;
-    switch( state ) {
-    case 0:
-      switch( b ) {
-      case 0x03: state = 28; break;     /* Data byte of JR NZ, ... - Alkatraz */
-      case 0x04: state = 1; break;	/* INC B - Many loaders */
-      default: state = 13; break;	/* Possible Digital Integration */
-      }
-      break;
-    case 1:
-      switch( b ) {
-      case 0x20: state = 40; break;     /* JR NZ - variant Alkatraz */
-      case 0xc8: state = 2; break;	/* RET Z */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 2:
-      switch( b ) {
-      case 0x3e: state = 3; break;	/* LD A,nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 3:
-      switch( b ) {
-      case 0x00:			/* Search Loader */
-      case 0x7f:			/* ROM loader and variants */
-      case 0xff:                        /* Dinaload */
-	state = 4; break;		/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 4:
-      switch( b ) {
-      case 0xdb: state = 5; break;	/* IN A,(nn) */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 5:
-      switch( b ) {
-      case 0xfe: state = 6; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 6:
-      switch( b ) {
-      case 0x1f: state = 7; break;	/* RRA */
-      case 0xa9: state = 24; break;	/* XOR C - Search Loader */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 7:
-      switch( b ) {
-      case 0x00:			/* NOP - Bleepload */
-      case 0xa7:			/* AND A - Microsphere */
-      case 0xc8:			/* RET Z - Paul Owens */
-      case 0xd0:			/* RET NC - ROM loader */
-	state = 8; break;
-      case 0xa9: state = 9; break;	/* XOR C - Speedlock */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 8:
-      switch( b ) {
-      case 0xa9: state = 9; break;	/* XOR C */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 9:
-      switch( b ) {
-      case 0xe6: state = 10; break;	/* AND nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 10:
-      switch( b ) {
-      case 0x20: state = 11; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 11:
-      switch( b ) {
-      case 0x28: state = 12; break;	/* JR nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 12:
-      if( b == 0x100 - count ) {
-	return ACCELERATION_MODE_INCREASING;
-      } else {
-	return ACCELERATION_MODE_NONE;
-      }
-      break;
+  libspectrum_word pc = start;
 
-      /* Digital Integration loader */
+  for( ; *pattern != SIGNATURE_END; pattern++ ) {
+    libspectrum_byte b = readbyte_internal( pc ); pc++;
 
-    case 13:
-      state = 14; break;		/* Possible Digital Integration */
-    case 14:
-      switch( b ) {
-      case 0x05: state = 15; break;	/* DEC B - Digital Integration */
-      default: return ACCELERATION_MODE_NONE;
-      }
+    switch( *pattern ) {
+    case SIGNATURE_ANY:
       break;
-    case 15:
-      switch( b ) {
-      case 0xc8: state = 16; break;	/* RET Z */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 16:
-      switch( b ) {
-      case 0xdb: state = 17; break;	/* IN A,(nn) */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 17:
-      switch( b ) {
-      case 0xfe: state = 18; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 18:
-      switch( b ) {
-      case 0xa9: state = 19; break;	/* XOR C */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 19:
-      switch( b ) {
-      case 0xe6: state = 20; break;	/* AND nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
+    case SIGNATURE_LOOP_JR:
+      if( (libspectrum_word)( pc + (libspectrum_signed_byte)b ) != loop )
+        return 0;
       break;
-    case 20:
-      switch( b ) {
-      case 0x40: state = 21; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
+    case SIGNATURE_LOOP_LOW:
+      if( b != ( loop & 0xff ) ) return 0;
       break;
-    case 21:
-      switch( b ) {
-      case 0xca: state = 22; break;	/* JP Z,nnnn */
-      default: return ACCELERATION_MODE_NONE;
-      }
+    case SIGNATURE_LOOP_HIGH:
+      if( b != ( loop >> 8 ) ) return 0;
       break;
-    case 22:				/* LSB of jump target */
-      if( b == ( z80.pc.w - 4 ) % 0x100 ) {
-	state = 23;
-      } else {
-	return ACCELERATION_MODE_NONE;
-      }
+    default:
+      if( b != *pattern ) return 0;
       break;
-    case 23:				/* MSB of jump target */
-      if( b == ( z80.pc.w - 4 ) / 0x100 ) {
-	return ACCELERATION_MODE_DECREASING;
-      } else {
-	return ACCELERATION_MODE_NONE;
-      }
+    }
+  }
 
-      /* Search loader */
+  return 1;
+}
 
-    case 24:
-      switch( b ) {
-      case 0xe6: state = 25; break;	/* AND nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 25:
-      switch( b ) {
-      case 0x40: state = 26; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 26:
-      switch( b ) {
-      case 0x28: state = 12; break;     /* JR Z - Space Crusade */
-      case 0xd8: state = 27; break;	/* RET C */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 27:
-      switch( b ) {
-      case 0x00: state = 11; break;	/* NOP */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
+static const loader_signature_t*
+acceleration_detector( libspectrum_word pc )
+{
+  size_t i;
 
-    /* Alkatraz */
+  for( i = 0; i < ARRAY_SIZE( signatures ); i++ )
+    if( pattern_matches( signatures[i].pattern, pc,
+                         pc + signatures[i].loop_offset ) )
+      return &signatures[i];
 
-    case 28:
-      switch( b ) {
-      case 0xc3: state = 29; break;     /* JP nnnn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 29:
-      state = 30; break;                /* First data byte of JP */
-    case 30:
-      state = 31; break;                /* Second data byte of JP */
-    case 31:
-      switch( b ) {
-      case 0xdb: state = 32; break;	/* IN A,(nn) */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 32:
-      switch( b ) {
-      case 0xfe: state = 33; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 33:
-      switch( b ) {
-      case 0x1f: state = 34; break;	/* RRA */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 34:
-      switch( b ) {
-      case 0xc8: state = 35; break;	/* RET Z */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 35:
-      switch( b ) {
-      case 0xa9: state = 36; break;	/* XOR C */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 36:
-      switch( b ) {
-      case 0xe6: state = 37; break;	/* AND nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 37:
-      switch( b ) {
-      case 0x20: state = 38; break;	/* Data byte */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 38:
-      switch( b ) {
-      case 0x28: state = 39; break;	/* JR Z,nn */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 39:
-      switch( b ) {
-      case 0xf1:                        /* Normal data byte */
-      case 0xf3:                        /* Variant data byte */
-        return ACCELERATION_MODE_INCREASING;
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
+  return NULL;
+}
 
-    /* "Variant" Alkatraz */
+/* Is the tail of LD-BYTES at `start'? */
+static int
+ld_bytes_tail_matches( libspectrum_word start )
+{
+  return readbyte_internal( start ) == ld_bytes_tail[0] &&
+         pattern_matches( ld_bytes_tail, start,
+                          start + LD_BYTES_TAIL_LOOP_OFFSET );
+}
 
-    case 40:
-      switch( b ) {
-      case 0x01: state = 41; break;     /* Data byte of JR NZ */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
-    case 41:
-      switch( b ) {
-      case 0xc9: state = 31; break;     /* RET */
-      default: return ACCELERATION_MODE_NONE;
-      }
-      break;
+/* Find the end of the ROM-compatible LD-BYTES routine which called an
+   edge-finding loop, returning the address of its final RET or 0 */
+static libspectrum_word
+find_ld_bytes_ret( libspectrum_word caller )
+{
+  libspectrum_word start;
 
-    default:
-      /* Can't happen */
-      break;
-    }
+  for( start = caller; start != (libspectrum_word)( caller + LD_BYTES_SEARCH );
+       start++ ) {
+    if( ld_bytes_tail_matches( start ) )
+      return start + LD_BYTES_TAIL_RET_OFFSET;
+  }
+
+  return 0;
+}
+
+/* Read the little-endian word at `address' */
+static libspectrum_word
+read_word( libspectrum_word address )
+{
+  return readbyte_internal( address ) |
+         readbyte_internal( (libspectrum_word)( address + 1 ) ) << 8;
+}
+
+/* If the edge-finding loop was called from a ROM-compatible LD-BYTES while
+   it waits for the pilot tone, load the whole block in one go and return
+   from LD-BYTES; returns 0 if this happened */
+static int
+flash_load( void )
+{
+  libspectrum_word sp = z80.sp.w, caller;
+
+  caller = read_word( sp );
+
+  /* Step out of LD-EDGE-2, which is just CALL LD-EDGE-1 : RET NC */
+  if( readbyte_internal( caller ) == 0xd0 &&
+      readbyte_internal( caller - 3 ) == 0xcd &&
+      read_word( caller - 2 ) == (libspectrum_word)( caller + 1 ) ) {
+    sp += 2;
+    caller = read_word( sp );
   }
 
-}      
+  /* The code may have changed under a cached answer, say with a second
+     stage loader or a ROM page switch, so check it's still there */
+  if( caller != flash_load_caller ||
+      ( flash_load_ret &&
+        !ld_bytes_tail_matches( flash_load_ret -
+                                LD_BYTES_TAIL_RET_OFFSET ) ) ) {
+    flash_load_caller = caller;
+    flash_load_ret = find_ld_bytes_ret( caller );
+  }
+
+  if( !flash_load_ret ) return 1;
+
+  if( tape_flash_load() ) return 1;
+
+  /* Drop the return address(es) into LD-BYTES and jump to its final RET */
+  z80.sp.w = sp + 2;
+  z80.pc.w = flash_load_ret;
+
+  /* The block may have overwritten the loader */
+  flash_load_caller = flash_load_ret = 0;
+
+  acceleration_signature = NULL;
+  successive_reads = 0;
+
+  return 0;
+}
 
 static void
 check_for_acceleration( void )
 {
   /* If the IN occured at a different location to the one we're
      accelerating, stop acceleration */
-  if( acceleration_mode && z80.pc.w != acceleration_pc )
-    acceleration_mode = ACCELERATION_MODE_NONE;
+  if( acceleration_signature && z80.pc.w != acceleration_pc )
+    acceleration_signature = NULL;
 
   /* If we're not accelerating, check if this is a loader */
-  if( !acceleration_mode ) {
-    acceleration_mode = acceleration_detector( z80.pc.w - 6 );
+  if( !acceleration_signature ) {
+    acceleration_signature =
+      acceleration_detector( z80.pc.w - SIGNATURE_IN_OFFSET );
     acceleration_pc = z80.pc.w;
   }
 
-  if( acceleration_mode ) do_acceleration();
+  if( !acceleration_signature ) return;
+
+  if( settings_current.flash_load && !flash_load() ) return;
+
+  do_acceleration();
 }
 
 void
@@ -466,3 +440,50 @@ loader_set_acceleration_flags( int flags, int from_acceleration )
     length_known1 = 0;
   }
 }
+
+static libspectrum_byte test_rom_loader[] = {
+  0x04, 0xc8, 0x3e, 0x7f, 0xdb, 0xfe, 0x1f, 0xd0, 0xa9, 0xe6, 0x20, 0x28,
+  0xf3
+};
+static libspectrum_byte test_bad_jump[] = {
+  0x04, 0xc8, 0x3e, 0x7f, 0xdb, 0xfe, 0x1f, 0xd0, 0xa9, 0xe6, 0x20, 0x28,
+  0xf2
+};
+static libspectrum_byte test_digital_integration[] = {
+  0x00, 0x00, 0x05, 0xc8, 0xdb, 0xfe, 0xa9, 0xe6, 0x40, 0xca, 0x02, 0x40
+};
+static libspectrum_byte test_alkatraz[] = {
+  0x03, 0xc3, 0x12, 0x34, 0xdb, 0xfe, 0x1f, 0xc8, 0xa9, 0xe6, 0x20, 0x28,
+  0xf3
+};
+
+static int
+run_test( libspectrum_byte *data, size_t data_length, const char *expected )
+{
+  const loader_signature_t *signature;
+
+  memset( memory_map_read[8].page, 0, 0x20 );
+  memcpy( memory_map_read[8].page, data, data_length );
+
+  signature = acceleration_detector( 0x4000 );
+
+  if( !expected ) return signature != NULL;
+  if( !signature || strcmp( signature->name, expected ) ) return 1;
+
+  return 0;
+}
+
+int
+loader_unittest( void )
+{
+  int r = 0;
+
+  r += run_test( test_rom_loader, sizeof( test_rom_loader ), "ROM loader" );
+  r += run_test( test_bad_jump, sizeof( test_bad_jump ), NULL );
+  r += run_test( test_digital_integration, sizeof( test_digital_integration ),
+                 "Digital Integration" );
+  r += run_test( test_alkatraz, sizeof( test_alkatraz ),
+                 "Alkatraz (alternative)" );
+
+  return r;
+}
@@ -32,4 +32,6 @@ void loader_tape_stop( void );
 void loader_detect_loader( void );
 void loader_set_acceleration_flags( int flags, int from_acceleration );
 
+int loader_unittest( void );
+
 #endif			/* #ifndef FUSE_LOADER_H */
@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+
 #include "event.h"
 #include "fuse.h"
 #include "infrastructure/startup_manager.h"
@@ -41,6 +45,7 @@
 #include "movie.h"
 #include "peripherals/ula.h"
 #include "pokefinder/pokemem.h"
+#include "rawdump.h"
 #include "rzx.h"
 #include "settings.h"
 #include "snapshot.h"
@@ -58,10 +63,49 @@ fuse_machine_info *machine_current = NULL; /* The currently selected machine */
 static int machine_location;	/* Where is the current machine in
 				   machine_types[...]? */
 
+/* Every ROM image the emulator has used, keyed by its contents. Pages
+   just point into these, so resetting a machine, or using the same ROM in
+   several places, doesn't make another copy. They are read-only, and live
+   as long as the process does, so fuzx instances forked from one process
+   all share the same physical pages */
+typedef struct machine_rom_data_t {
+  libspectrum_qword hash;
+  size_t length;
+  libspectrum_byte *data;
+} machine_rom_data_t;
+
+static GSList *rom_data = NULL;
+
+/* ROM images which have been written to, and so can no longer be shared */
+static GSList *retired_rom_data = NULL;
+
+/* ROM files as read from disk, so that resetting a machine doesn't need
+   to go back to the filesystem or hash the file again. Emptied whenever a
+   machine is selected, which is when changed ROM settings or files get
+   picked up */
+typedef struct machine_rom_image_t {
+  char *filename;
+  machine_rom_data_t *contents;
+} machine_rom_image_t;
+
+static GSList *rom_images = NULL;
+
+/* Contention tables for machines without prebuilt ones, built once for
+   each machine type and first line time; nothing else affects them. Again
+   read-only and shared */
+typedef struct machine_contention_t {
+  libspectrum_machine machine;
+  libspectrum_dword line_time;
+  libspectrum_byte *data;	/* Both tables, MREQ active first */
+} machine_contention_t;
+
+static GSList *contention_tables = NULL;
+
 static int machine_add_machine( int (*init_function)(fuse_machine_info *machine) );
 static int machine_select_machine( fuse_machine_info *machine );
 static void machine_set_const_timings( fuse_machine_info *machine );
 static void machine_set_variable_timings( fuse_machine_info *machine );
+static void machine_rom_images_free( void );
 
 static int
 machine_init_machines( void *context )
@@ -142,6 +186,7 @@ machine_select( libspectrum_machine type )
   /* We don't want to have to deal with screen size changes in the movie code
      and recording movies where we change machines seems pretty obscure */
   movie_stop();
+  rawdump_stop();
 
   for( i=0; i < machine_count; i++ ) {
     if( machine_types[i]->machine == type ) {
@@ -209,6 +254,8 @@ machine_select_machine( fuse_machine_info *machine )
 
   settings_set_string( &settings_current.start_machine, machine->id );
 
+  machine_rom_images_free();
+
   tstates = 0;
 
   /* Reset the event stack */
@@ -249,16 +296,77 @@ machine_select_machine( fuse_machine_info *machine )
   return 0;
 }
 
-int
-machine_load_rom_bank_from_buffer( memory_page* bank_map, int page_num,
-  unsigned char *buffer, size_t length, int custom )
+/* Get a buffer which will become shared, read-only data once sealed */
+static libspectrum_byte*
+machine_shared_new( size_t length )
+{
+#if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS
+  void *data = mmap( NULL, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( data == MAP_FAILED ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    fuse_abort();
+  }
+  return data;
+#else			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+  return libspectrum_new( libspectrum_byte, length );
+#endif			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+}
+
+static void
+machine_shared_seal( libspectrum_byte *data, size_t length )
+{
+#if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS
+  mprotect( data, length, PROT_READ );
+#else			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+  (void)data; (void)length;
+#endif			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+}
+
+static void
+machine_shared_delete( libspectrum_byte *data, size_t length )
+{
+#if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS
+  munmap( data, length );
+#else			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+  (void)length;
+  libspectrum_free( data );
+#endif			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+}
+
+static machine_rom_data_t*
+machine_rom_data_get( const libspectrum_byte *buffer, size_t length )
+{
+  libspectrum_qword hash = utils_hash( UTILS_HASH_INIT, buffer, length );
+  machine_rom_data_t *contents;
+  GSList *ptr;
+
+  for( ptr = rom_data; ptr; ptr = ptr->next ) {
+    contents = ptr->data;
+    if( contents->hash == hash && contents->length == length &&
+        !memcmp( contents->data, buffer, length ) )
+      return contents;
+  }
+
+  contents = libspectrum_new( machine_rom_data_t, 1 );
+  contents->hash = hash;
+  contents->length = length;
+  contents->data = machine_shared_new( length );
+  memcpy( contents->data, buffer, length );
+  machine_shared_seal( contents->data, length );
+
+  rom_data = g_slist_prepend( rom_data, contents );
+
+  return contents;
+}
+
+static void
+machine_rom_bank_map( memory_page* bank_map, int page_num,
+                      libspectrum_byte *data, size_t length, int custom )
 {
   size_t offset;
-  libspectrum_byte *data = memory_pool_allocate( length );
   memory_page *page;
 
-  memcpy( data, buffer, length );
-
   for( page = &bank_map[ page_num * MEMORY_PAGES_IN_16K ], offset = 0;
        offset < length;
        page++, offset += MEMORY_PAGE_SIZE ) {
@@ -268,16 +376,107 @@ machine_load_rom_bank_from_buffer( memory_page* bank_map, int page_num,
     page->writable = 0;
     page->save_to_snapshot = custom;
   }
+}
+
+int
+machine_load_rom_bank_from_buffer( memory_page* bank_map, int page_num,
+  unsigned char *buffer, size_t length, int custom )
+{
+  libspectrum_byte *data;
+
+  if( !length ) return 0;
+
+  /* Writes to ROM need a copy of their own */
+  if( settings_current.writable_roms ) {
+    data = memory_pool_allocate( length );
+    memcpy( data, buffer, length );
+  } else {
+    data = machine_rom_data_get( buffer, length )->data;
+  }
+
+  machine_rom_bank_map( bank_map, page_num, data, length, custom );
 
   return 0;
 }
 
+void
+machine_rom_unshare( const libspectrum_byte *page )
+{
+  machine_rom_data_t *contents;
+  GSList *ptr;
+
+  for( ptr = rom_data; ptr; ptr = ptr->next ) {
+    contents = ptr->data;
+    if( page >= contents->data && page < contents->data + contents->length )
+      break;
+  }
+  if( !ptr ) return;
+
+  /* Writable ROMs have been turned on since the last reset. Hand the pages
+     over to the machine, which keeps them until it is next reset, and start
+     afresh for anything else which wants this ROM */
+  rom_data = g_slist_delete_link( rom_data, ptr );
+  retired_rom_data = g_slist_prepend( retired_rom_data, contents );
+  machine_rom_images_free();
+
+#if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS
+  mprotect( contents->data, contents->length, PROT_READ | PROT_WRITE );
+#endif			/* #if defined HAVE_SYS_MMAN_H && defined MAP_ANONYMOUS */
+}
+
+static void
+machine_rom_data_free( gpointer data, gpointer user_data GCC_UNUSED )
+{
+  machine_rom_data_t *contents = data;
+
+  machine_shared_delete( contents->data, contents->length );
+  libspectrum_free( contents );
+}
+
+static void
+machine_rom_image_free( gpointer data, gpointer user_data GCC_UNUSED )
+{
+  machine_rom_image_t *image = data;
+
+  libspectrum_free( image->filename );
+  libspectrum_free( image );
+}
+
+static void
+machine_rom_images_free( void )
+{
+  g_slist_foreach( rom_images, machine_rom_image_free, NULL );
+  g_slist_free( rom_images );
+  rom_images = NULL;
+}
+
+static gint
+machine_rom_image_compare( gconstpointer a, gconstpointer b )
+{
+  const machine_rom_image_t *image = a;
+
+  return strcmp( image->filename, b );
+}
+
 static int
 machine_load_rom_bank_from_file( memory_page* bank_map, int page_num,
   const char *filename, size_t expected_length, int custom )
 {
   int error;
   utils_file rom;
+  machine_rom_image_t *image;
+  GSList *cached;
+
+  cached = g_slist_find_custom( rom_images, filename,
+                                machine_rom_image_compare );
+  if( cached && !settings_current.writable_roms ) {
+    image = cached->data;
+    if( image->contents->length == expected_length ) {
+      machine_rom_bank_map( bank_map, page_num, image->contents->data,
+                            image->contents->length, custom );
+      return 0;
+    }
+  }
 
   error = utils_read_auxiliary_file( filename, &rom, UTILS_AUXILIARY_ROM );
   if( error == -1 ) {
@@ -298,6 +497,13 @@ machine_load_rom_bank_from_file( memory_page* bank_map, int page_num,
   error = machine_load_rom_bank_from_buffer( bank_map, page_num, rom.buffer,
     rom.length, custom );
 
+  if( !error && !cached && !settings_current.writable_roms ) {
+    image = libspectrum_new( machine_rom_image_t, 1 );
+    image->filename = utils_safe_strdup( filename );
+    image->contents = machine_rom_data_get( rom.buffer, rom.length );
+    rom_images = g_slist_prepend( rom_images, image );
+  }
+
   utils_close_file( &rom );
 
   return error;
@@ -328,10 +534,98 @@ machine_load_rom( int page_num, const char *filename, const char *fallback,
     expected_length );
 }
 
+static void
+machine_contention_set( libspectrum_byte *table, libspectrum_dword time,
+                        libspectrum_byte delay )
+{
+#ifdef USE_PACKED_CONTENTION
+  table[ time >> 1 ] |= delay << ( ( time & 1 ) << 2 );
+#else			/* #ifdef USE_PACKED_CONTENTION */
+  table[ time ] = delay;
+#endif			/* #ifdef USE_PACKED_CONTENTION */
+}
+
+/* Find the tables built along with Fuse for the current machine, if there
+   are any */
+static const ula_contention_prebuilt*
+machine_contention_prebuilt( void )
+{
+  const ula_contention_prebuilt *prebuilt;
+  const machine_timings *timings = &machine_current->timings;
+
+  for( prebuilt = ula_contention_prebuilt_tables; prebuilt->contend_delay;
+       prebuilt++ ) {
+    if( prebuilt->contend_delay == machine_current->ram.contend_delay &&
+        prebuilt->contend_delay_no_mreq ==
+          machine_current->ram.contend_delay_no_mreq &&
+        prebuilt->line_time == machine_current->line_times[0] &&
+        prebuilt->tstates_per_line == timings->tstates_per_line &&
+        prebuilt->left_border == timings->left_border &&
+        prebuilt->horizontal_screen == timings->horizontal_screen &&
+        prebuilt->tstates_per_frame == timings->tstates_per_frame )
+      return prebuilt;
+  }
+
+  return NULL;
+}
+
+/* Point the ULA at the contention tables for the current machine. These
+   normally come with Fuse; any others are built the first time they're
+   needed */
+static void
+machine_contention_select( void )
+{
+  const ula_contention_prebuilt *prebuilt;
+  machine_contention_t *table = NULL;
+  libspectrum_dword i;
+  GSList *ptr;
+
+  if( machine_current->ram.contend_delay == spectrum_contend_delay_none &&
+      machine_current->ram.contend_delay_no_mreq ==
+        spectrum_contend_delay_none ) {
+    ula_contention = ula_contention_none;
+    ula_contention_no_mreq = ula_contention_none;
+    return;
+  }
+
+  prebuilt = machine_contention_prebuilt();
+  if( prebuilt ) {
+    ula_contention = prebuilt->contention;
+    ula_contention_no_mreq = prebuilt->contention_no_mreq;
+    return;
+  }
+
+  for( ptr = contention_tables; ptr; ptr = ptr->next ) {
+    table = ptr->data;
+    if( table->machine == machine_current->machine &&
+        table->line_time == machine_current->line_times[0] ) break;
+  }
+
+  if( !ptr ) {
+    table = libspectrum_new( machine_contention_t, 1 );
+    table->machine = machine_current->machine;
+    table->line_time = machine_current->line_times[0];
+    table->data = machine_shared_new( 2 * ULA_CONTENTION_BYTES );
+    memset( table->data, 0, 2 * ULA_CONTENTION_BYTES );
+
+    for( i = 0; i < machine_current->timings.tstates_per_frame; i++ ) {
+      machine_contention_set( table->data, i,
+                              machine_current->ram.contend_delay( i ) );
+      machine_contention_set( table->data + ULA_CONTENTION_BYTES, i,
+                              machine_current->ram.contend_delay_no_mreq( i ) );
+    }
+
+    machine_shared_seal( table->data, 2 * ULA_CONTENTION_BYTES );
+    contention_tables = g_slist_prepend( contention_tables, table );
+  }
+
+  ula_contention = table->data;
+  ula_contention_no_mreq = table->data + ULA_CONTENTION_BYTES;
+}
+
 int
 machine_reset( int hard_reset )
 {
-  size_t i;
   int error;
 
   /* Clear poke list (undoes effects of active pokes on Spectrum memory) */
@@ -356,11 +650,7 @@ machine_reset( int hard_reset )
 
   error = machine_current->memory_map(); if( error ) return error;
 
-  /* Set up the contention array */
-  for( i = 0; i < machine_current->timings.tstates_per_frame; i++ ) {
-    ula_contention[ i ] = machine_current->ram.contend_delay( i );
-    ula_contention_no_mreq[ i ] = machine_current->ram.contend_delay_no_mreq( i );
-  }
+  machine_contention_select();
 
   /* Update the disk menu items */
   ui_menu_disk_update();
@@ -435,6 +725,24 @@ machine_end( void )
   }
 
   libspectrum_free( machine_types );
+
+  machine_rom_images_free();
+
+  g_slist_foreach( rom_data, machine_rom_data_free, NULL );
+  g_slist_free( rom_data );
+  rom_data = NULL;
+
+  g_slist_foreach( retired_rom_data, machine_rom_data_free, NULL );
+  g_slist_free( retired_rom_data );
+  retired_rom_data = NULL;
+
+  while( contention_tables ) {
+    machine_contention_t *table = contention_tables->data;
+    machine_shared_delete( table->data, 2 * ULA_CONTENTION_BYTES );
+    libspectrum_free( table );
+    contention_tables = g_slist_delete_link( contention_tables,
+                                             contention_tables );
+  }
 }
 
 void
@@ -106,6 +106,10 @@ int machine_load_rom_bank( memory_page* bank_map, int page_num,
 int machine_load_rom( int page_num, const char *filename, const char *fallback,
   size_t expected_length );
 
+/* ROMs are shared and read-only unless writable ROMs were on at reset. Call
+   before writing to `page' to give the machine its own copy if need be */
+void machine_rom_unshare( const libspectrum_byte *page );
+
 int machine_reset( int hard_reset );
 
 #endif			/* #ifndef FUSE_MACHINE_H */
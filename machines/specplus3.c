@@ -44,6 +44,7 @@
 #include "peripherals/disk/upd_fdc.h"
 #include "peripherals/printer.h"
 #include "phantom_typist.h"
+#include "rzx.h"
 #include "settings.h"
 #include "snapshot.h"
 #include "spec128.h"
@@ -53,8 +54,17 @@
 #include "ui/ui.h"
 #include "ui/uimedia.h"
 #include "utils.h"
+#include "z80/z80.h"
+#include "z80/z80_macros.h"
 #include "options.h"	/* needed for get combo options */
 
+/* The +3DOS ROM and the offsets into an extended disk parameter block
+   (XDPB) needed by the DD_READ_SECTOR trap */
+#define PLUS3DOS_ROM 2
+#define XDPB_SIDEDNESS 17
+#define XDPB_FIRST_SECTOR 20
+#define XDPB_SECTOR_SIZE 21
+
 static int normal_memory_map( int rom, int page );
 static void special_memory_map( int which );
 static void select_special_map( int page1, int page2, int page3, int page4 );
@@ -413,6 +423,68 @@ specplus3_get_fdd( specplus3_drive_number which )
   return &( specplus3_drives[ which ] );
 }
 
+/* Service a +3DOS DD_READ_SECTOR (#0163) call straight from the disk image:
+   read logical track D, sector E of unit C into HL, with page B at #C000,
+   using the XDPB at IX. Disks with successive or double-stepped sides are
+   left to the ROM and the FDC emulation */
+int
+specplus3_disk_trap( void )
+{
+  libspectrum_byte buffer[ 1024 ];
+  libspectrum_byte sidedness, last_byte;
+  libspectrum_word address;
+  size_t length, i;
+  fdd_t *d;
+  int head, cylinder;
+
+  if( !settings_current.disk_traps || rzx_playback || rzx_recording )
+    return 2;
+
+  if( !( machine_current->capabilities &
+         LIBSPECTRUM_MACHINE_CAPABILITY_PLUS3_DISK ) ||
+      machine_current->ram.special || machine_current->ram.romcs ||
+      machine_current->ram.current_rom != PLUS3DOS_ROM )
+    return 3;
+
+  d = &specplus3_drives[ C & 0x01 ];
+  if( !d->loaded || d->upsidedown || B > 7 ) return 1;
+
+  sidedness = readbyte_internal( IX + XDPB_SIDEDNESS );
+  length = readbyte_internal( IX + XDPB_SECTOR_SIZE ) |
+           ( readbyte_internal( IX + XDPB_SECTOR_SIZE + 1 ) << 8 );
+  if( length > sizeof( buffer ) ) return 1;
+
+  switch( sidedness & 0x83 ) {
+  case 0x00: head = 0; cylinder = D; break;
+  case 0x01: head = D & 0x01; cylinder = D >> 1; break;
+  default: return 1;
+  }
+
+  if( disk_read_sector( &d->disk, head, cylinder,
+                        E + readbyte_internal( IX + XDPB_FIRST_SECTOR ),
+                        buffer, length ) )
+    return 1;
+
+  /* Page in the requested bank just as the ROM does for the transfer */
+  last_byte = machine_current->ram.last_byte;
+  machine_current->ram.last_byte = ( last_byte & 0xf8 ) | B;
+  specplus3_memory_map();
+
+  address = HL;
+  for( i = 0; i < length; i++ )
+    writebyte_internal( address++, buffer[i] );
+
+  machine_current->ram.last_byte = last_byte;
+  specplus3_memory_map();
+
+  F |= FLAG_C;
+
+  PC = readbyte_internal( SP ) | ( readbyte_internal( SP + 1 ) << 8 );
+  SP += 2;
+
+  return 0;
+}
+
 static int
 ui_drive_is_available( void )
 {
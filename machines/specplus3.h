@@ -64,4 +64,6 @@ int specplus3_disk_insert( specplus3_drive_number which, const char *filename,
                            int autoload );
 fdd_t *specplus3_get_fdd( specplus3_drive_number which );
 
+int specplus3_disk_trap( void );
+
 #endif			/* #ifndef FUSE_SPECPLUS3_H */
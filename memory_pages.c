@@ -47,6 +47,7 @@
 #include "peripherals/ula.h"
 #include "settings.h"
 #include "spectrum.h"
+#include "statehash.h"
 #include "ui/ui.h"
 #include "utils.h"
 
@@ -382,7 +383,8 @@ readbyte( libspectrum_word address )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_READ, address );
 
-  if( mapping->contended ) tstates += ula_contention[ tstates ];
+  if( mapping->contended )
+    tstates += ula_contention_delay( ula_contention, tstates );
   tstates += 3;
 
   if( address < 0x4000 ) {
@@ -415,7 +417,8 @@ writebyte( libspectrum_word address, libspectrum_byte b )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_WRITE, address );
 
-  if( mapping->contended ) tstates += ula_contention[ tstates ];
+  if( mapping->contended )
+    tstates += ula_contention_delay( ula_contention, tstates );
 
   tstates += 3;
 
@@ -438,14 +441,14 @@ memory_display_dirty_pentagon_16_col( libspectrum_word address,
      the destination), redraw that bit.
      The trick here is that we need to check the home bank screen areas in
      page 5 and 4 (if screen 1 is in use), and page 7 & 6 (if screen 2 is in
-     use) and both the standard and ALTDFILE areas of those pages
+     use) and both the standard and ALTDFILE areas of those pages. The
+     screen is always in page 5 or 7, so setting the bottom bit of the page
+     number checks for both pages at once; and there are no attributes in
+     this mode, so only the bitmaps matter
    */
-  if( mapping->source == memory_source_ram && 
-      ( ( memory_current_screen  == 5 &&
-          ( mapping->page_num == 5 || mapping->page_num == 4 ) ) ||
-        ( memory_current_screen  == 7 &&
-          ( mapping->page_num == 7 || mapping->page_num == 6 ) ) ) &&
-      ( offset2 & 0xdfff ) < 0x1b00 &&
+  if( ( offset2 & 0xdfff ) < 0x1800 &&
+      ( mapping->page_num | 0x01 ) == memory_current_screen &&
+      mapping->source == memory_source_ram &&
       memory[ offset ] != b )
     display_dirty_pentagon_16_col( offset2 );
 }
@@ -507,8 +510,13 @@ writebyte_internal( libspectrum_word address, libspectrum_byte b )
     libspectrum_word offset = address & MEMORY_PAGE_SIZE_MASK;
     libspectrum_byte *memory = mapping->page;
 
+    if( !mapping->writable ) machine_rom_unshare( memory );
+
     memory_display_dirty( address, b );
 
+    if( statehash_active && mapping->source == memory_source_ram )
+      statehash_ram_write( mapping, offset, memory[ offset ], b );
+
     memory[ offset ] = b;
   }
 }
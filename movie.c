@@ -31,12 +31,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "libspectrum.h"
 #ifdef HAVE_ZLIB_H
 #define ZLIB_CONST
 #include <zlib.h>
 #endif
 
+#include "compat.h"
 #include "display.h"
 #include "fuse.h"
 #include "machine.h"
@@ -130,12 +135,66 @@ static int framesiz = 4;
 
 static libspectrum_byte sbuff[ 4096 ];
 #ifdef HAVE_ZLIB_H
-#define ZBUF_SIZE 8192
 static int fmf_compr = -1;
-static z_stream zstream;
-static unsigned char zbuf_o[ ZBUF_SIZE ];
 #endif	/* HAVE_ZLIB_H */
 
+/*
+  The emulation thread doesn't compress or write anything itself: the FMF
+  data is just copied into fixed size blocks, which are passed through a
+  bounded queue to `movie_threads' encoder threads to be compressed and
+  written out in order. Each block after the first is compressed as raw
+  deflate data with the end of the previous block as its dictionary, so the
+  blocks can be compressed in parallel but still concatenate to a single
+  zlib stream. With no encoder threads, each block is compressed and
+  written by the emulation thread as soon as it is full.
+*/
+
+#define MOVIE_BLOCK_SIZE 0x20000
+#define MOVIE_DICT_SIZE 0x8000
+#define MOVIE_QUEUE_LENGTH 8
+#define MOVIE_MAX_THREADS 8
+
+typedef enum movie_block_state {
+  MOVIE_BLOCK_FREE,		/* Owned by the emulation thread */
+  MOVIE_BLOCK_QUEUED,		/* Waiting for an encoder */
+  MOVIE_BLOCK_ENCODING,		/* Being compressed */
+  MOVIE_BLOCK_ENCODED,		/* Waiting to be written */
+} movie_block_state;
+
+typedef struct movie_block {
+  movie_block_state state;
+  int first;			/* Does this block start the zlib stream? */
+
+  libspectrum_byte data[ MOVIE_BLOCK_SIZE ];
+  size_t length;
+
+  libspectrum_byte dict[ MOVIE_DICT_SIZE ];
+  size_t dict_length;
+
+  const libspectrum_byte *output;	/* Either data or compressed */
+  size_t output_length;
+
+  libspectrum_byte *compressed;
+  size_t compressed_size;
+} movie_block;
+
+static movie_block *blocks = NULL;
+static size_t fill_index;	/* The block being filled */
+static int blocks_submitted;
+
+#ifdef HAVE_PTHREAD
+static pthread_t encoders[ MOVIE_MAX_THREADS ];
+static int encoder_count = 0;
+static pthread_mutex_t queue_lock;
+static pthread_cond_t work_cond;	/* A block has been queued */
+static pthread_cond_t free_cond;	/* A block has been written */
+static size_t encode_index;	/* The next block to be compressed */
+static size_t write_index;	/* The next block to be written */
+static int pending;		/* Blocks queued but not yet written */
+static int writing;		/* Is an encoder writing blocks? */
+static int stop_encoders;
+#endif	/* HAVE_PTHREAD */
+
 static unsigned char alaw_table[2048 + 1] = { ALAW_ENC_TAB };
 
 void movie_start_frame( void );
@@ -186,32 +245,246 @@ get_screentype( void )
   return '$';	/* STANDARD screen */
 }
 
-#ifdef HAVE_ZLIB_H
 static void
-fwrite_compr( const void *b, size_t n, size_t m, FILE *f )
+block_encode( movie_block *block )
 {
-  if( fmf_compr == 0 ) {
-    fwrite( b, n, m, f );
-  } else {
-    zstream.avail_in = n * m;
-    zstream.next_in = b;
-    zstream.avail_out = ZBUF_SIZE;
-    zstream.next_out = zbuf_o;
-    do {
-      deflate( &zstream, Z_NO_FLUSH );
-      while( zstream.avail_out != ZBUF_SIZE ) {
-        fwrite( zbuf_o, ZBUF_SIZE - zstream.avail_out, 1, of );
-	zstream.avail_out = ZBUF_SIZE;
-	zstream.next_out = zbuf_o;
-        deflate( &zstream, Z_NO_FLUSH );
+#ifdef HAVE_ZLIB_H
+  z_stream zstream;
+  size_t size;
+  int error;
+
+  if( fmf_compr != 0 && block->length ) {
+
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+
+    if( block->first ) {
+      error = deflateInit( &zstream, fmf_compr );
+    } else {
+      error = deflateInit2( &zstream, fmf_compr, Z_DEFLATED, -MAX_WBITS, 8,
+                            Z_DEFAULT_STRATEGY );
+      if( error == Z_OK && block->dict_length )
+        error = deflateSetDictionary( &zstream, block->dict,
+                                      block->dict_length );
+    }
+
+    if( error == Z_OK ) {
+      /* Room for the data, the zlib header and the sync flush marker */
+      size = deflateBound( &zstream, block->length ) + 16;
+      if( size > block->compressed_size ) {
+        block->compressed = libspectrum_renew( libspectrum_byte,
+                                               block->compressed, size );
+        block->compressed_size = size;
       }
-    } while ( zstream.avail_in != 0 );
+
+      zstream.next_in = block->data;
+      zstream.avail_in = block->length;
+      zstream.next_out = block->compressed;
+      zstream.avail_out = block->compressed_size;
+      deflate( &zstream, Z_SYNC_FLUSH );
+
+      block->output = block->compressed;
+      block->output_length = block->compressed_size - zstream.avail_out;
+      deflateEnd( &zstream );
+      return;
+    }
   }
-}
-#else	/* HAVE_ZLIB_H */
-#define fwrite_compr fwrite
 #endif	/* HAVE_ZLIB_H */
 
+  block->output = block->data;
+  block->output_length = block->length;
+}
+
+static void
+block_write( movie_block *block )
+{
+  if( block->output_length )
+    fwrite( block->output, block->output_length, 1, of );
+}
+
+#ifdef HAVE_PTHREAD
+
+/* Write out any blocks which are ready, in order. Must be called with
+   queue_lock held */
+static void
+write_blocks( void )
+{
+  movie_block *block;
+
+  writing = 1;
+
+  while( blocks[ write_index ].state == MOVIE_BLOCK_ENCODED ) {
+    block = &blocks[ write_index ];
+
+    pthread_mutex_unlock( &queue_lock );
+    block_write( block );
+    pthread_mutex_lock( &queue_lock );
+
+    block->state = MOVIE_BLOCK_FREE;
+    write_index = ( write_index + 1 ) % MOVIE_QUEUE_LENGTH;
+    pending--;
+    pthread_cond_broadcast( &free_cond );
+  }
+
+  writing = 0;
+}
+
+static void*
+encoder_thread( void *arg GCC_UNUSED )
+{
+  movie_block *block;
+
+  pthread_mutex_lock( &queue_lock );
+
+  while( 1 ) {
+    block = &blocks[ encode_index ];
+
+    if( block->state == MOVIE_BLOCK_QUEUED ) {
+      block->state = MOVIE_BLOCK_ENCODING;
+      encode_index = ( encode_index + 1 ) % MOVIE_QUEUE_LENGTH;
+
+      pthread_mutex_unlock( &queue_lock );
+      block_encode( block );
+      pthread_mutex_lock( &queue_lock );
+
+      block->state = MOVIE_BLOCK_ENCODED;
+      if( !writing ) write_blocks();
+    } else if( stop_encoders ) {
+      break;
+    } else {
+      pthread_cond_wait( &work_cond, &queue_lock );
+    }
+  }
+
+  pthread_mutex_unlock( &queue_lock );
+
+  return NULL;
+}
+
+static void
+encoders_start( void )
+{
+  int count, error;
+
+  pthread_mutex_init( &queue_lock, NULL );
+  pthread_cond_init( &work_cond, NULL );
+  pthread_cond_init( &free_cond, NULL );
+  encode_index = write_index = 0;
+  pending = writing = stop_encoders = 0;
+
+  count = settings_current.movie_threads;
+  if( count > MOVIE_MAX_THREADS ) count = MOVIE_MAX_THREADS;
+
+  for( encoder_count = 0; encoder_count < count; encoder_count++ ) {
+    error = pthread_create( &encoders[ encoder_count ], NULL, encoder_thread,
+                            NULL );
+    if( error ) {
+      ui_error( UI_ERROR_WARNING, "movie: error %d creating encoder thread",
+                error );
+      break;
+    }
+  }
+}
+
+static void
+encoders_stop( void )
+{
+  int i;
+
+  pthread_mutex_lock( &queue_lock );
+  while( pending ) pthread_cond_wait( &free_cond, &queue_lock );
+  stop_encoders = 1;
+  pthread_cond_broadcast( &work_cond );
+  pthread_mutex_unlock( &queue_lock );
+
+  for( i = 0; i < encoder_count; i++ )
+    pthread_join( encoders[i], NULL );
+  encoder_count = 0;
+
+  pthread_cond_destroy( &free_cond );
+  pthread_cond_destroy( &work_cond );
+  pthread_mutex_destroy( &queue_lock );
+}
+
+#endif	/* HAVE_PTHREAD */
+
+/* Hand the block being filled over to be compressed and written */
+static void
+block_submit( void )
+{
+  movie_block *block = &blocks[ fill_index ];
+
+  block->first = ( blocks_submitted++ == 0 );
+
+#ifdef HAVE_PTHREAD
+  if( encoder_count ) {
+    pthread_mutex_lock( &queue_lock );
+    block->state = MOVIE_BLOCK_QUEUED;
+    pending++;
+    pthread_cond_signal( &work_cond );
+    pthread_mutex_unlock( &queue_lock );
+    return;
+  }
+#endif	/* HAVE_PTHREAD */
+
+  block_encode( block );
+  block_write( block );
+}
+
+/* Move on to the next block, waiting for it to be written if the queue is
+   full */
+static void
+block_next( void )
+{
+  movie_block *previous = &blocks[ fill_index ], *block;
+
+  fill_index = ( fill_index + 1 ) % MOVIE_QUEUE_LENGTH;
+  block = &blocks[ fill_index ];
+
+#ifdef HAVE_PTHREAD
+  if( encoder_count ) {
+    pthread_mutex_lock( &queue_lock );
+    while( block->state != MOVIE_BLOCK_FREE )
+      pthread_cond_wait( &free_cond, &queue_lock );
+    pthread_mutex_unlock( &queue_lock );
+  }
+#endif	/* HAVE_PTHREAD */
+
+  block->length = 0;
+
+  /* The previous block isn't touched again until this one is submitted */
+  block->dict_length = previous->length < MOVIE_DICT_SIZE ?
+                       previous->length : MOVIE_DICT_SIZE;
+  memcpy( block->dict,
+          &previous->data[ previous->length - block->dict_length ],
+          block->dict_length );
+}
+
+static void
+movie_write( const void *b, size_t n )
+{
+  const libspectrum_byte *data = b;
+  movie_block *block;
+  size_t chunk;
+
+  while( n ) {
+    block = &blocks[ fill_index ];
+
+    chunk = MOVIE_BLOCK_SIZE - block->length;
+    if( chunk > n ) chunk = n;
+
+    memcpy( &block->data[ block->length ], data, chunk );
+    block->length += chunk;
+    data += chunk; n -= chunk;
+
+    if( block->length == MOVIE_BLOCK_SIZE ) {
+      block_submit();
+      block_next();
+    }
+  }
+}
+
 static void
 movie_compress_area( int x, int y, int w, int h, int s )
 {
@@ -247,7 +520,7 @@ movie_compress_area( int x, int y, int w, int h, int s )
 /*      d1 = d;				*/
     }
     if( b - buff > 960 - 128 ) {	/* worst case 40*1.5 per line */
-      fwrite_compr( buff, b - buff, 1, of );
+      movie_write( buff, b - buff );
       b = buff;
     }
   }
@@ -255,7 +528,7 @@ movie_compress_area( int x, int y, int w, int h, int s )
     *b++ = l;
   }
   if( b != buff ) {	/* dump remain */
-    fwrite_compr( buff, b - buff, 1, of );
+    movie_write( buff, b - buff );
   }
 }
 
@@ -281,7 +554,7 @@ movie_add_area( int x, int y, int w, int h )
   head[4] = w;
   head[5] = h & 0xff;
   head[6] = h >> 8;
-  fwrite_compr( head, 7, 1, of );
+  movie_write( head, 7 );
   movie_compress_area( x, y, w, h, 0 );	/* Bitmap1 */
   movie_compress_area( x, y, w, h, 8 );	/* Attrib/B2 */
   if( fmf_screen == 'R' ) {
@@ -291,12 +564,39 @@ movie_add_area( int x, int y, int w, int h )
 }
 
 static void
+blocks_alloc( void )
+{
+  size_t i;
+
+  blocks = libspectrum_new( movie_block, MOVIE_QUEUE_LENGTH );
+  for( i = 0; i < MOVIE_QUEUE_LENGTH; i++ ) {
+    blocks[i].state = MOVIE_BLOCK_FREE;
+    blocks[i].length = blocks[i].dict_length = 0;
+    blocks[i].compressed = NULL;
+    blocks[i].compressed_size = 0;
+  }
+  fill_index = 0;
+  blocks_submitted = 0;
+}
+
+static void
+blocks_free( void )
+{
+  size_t i;
+
+  for( i = 0; i < MOVIE_QUEUE_LENGTH; i++ )
+    libspectrum_free( blocks[i].compressed );
+  libspectrum_free( blocks );
+  blocks = NULL;
+}
+
+static int
 movie_start_fmf( const char *name )
 {
   if( ( of = fopen(name, "wb") ) == NULL ) {  /* trunc old file ? or append ? */
     ui_error( UI_ERROR_ERROR, "error opening movie file '%s': %s", name,
               strerror( errno ) );
-    return;
+    return 1;
   }
 #ifdef WORDS_BIGENDIAN
   fwrite( "FMF_V1E", 7, 1, of );	/* write magic header Fuse Movie File */
@@ -311,14 +611,6 @@ movie_start_fmf( const char *name )
     fmf_compr = Z_DEFAULT_COMPRESSION;
     fwrite( "Z", 1, 1, of );		/* compressed */
   }
-  if( fmf_compr != 0 ) {
-    zstream.zalloc = Z_NULL;
-    zstream.zfree = Z_NULL;
-    zstream.opaque = Z_NULL;
-    zstream.avail_in = 0;
-    zstream.next_in = Z_NULL;
-    deflateInit( &zstream, fmf_compr );
-  }
 #else	/* HAVE_ZLIB_H */
   fwrite( "U", 1, 1, of );		/* cannot be compressed */
 #endif	/* HAVE_ZLIB_H */
@@ -333,7 +625,16 @@ movie_start_fmf( const char *name )
   head[6] = stereo;
   head[7] = '\n';	/* padding */
   fwrite( head, 8, 1, of );		/* write initial params */
+
+  /* Everything from here on goes through the encoders */
+  blocks_alloc();
+#ifdef HAVE_PTHREAD
+  encoders_start();
+#endif	/* HAVE_PTHREAD */
+
   movie_add_area( 0, 0, 40, 240 );
+
+  return 0;
 }
 
 void
@@ -343,7 +644,7 @@ movie_start( const char *name )	/* some init, open file (name)*/
   if( name == NULL || *name == '\0' )
     name = "fuse.fmf";			/* fuse movie file */
 
-  movie_start_fmf( name );
+  if( movie_start_fmf( name ) ) return;
   movie_recording = 1;
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIE_RECORDING, 1 );
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIE_PAUSE, 1 );
@@ -354,22 +655,14 @@ movie_stop( void )
 {
   if( !movie_paused && !movie_recording ) return;
 
-  fwrite_compr( "X", 1, 1, of );	/* End of Recording! */
+  movie_write( "X", 1 );	/* End of Recording! */
+  block_submit();
+#ifdef HAVE_PTHREAD
+  encoders_stop();
+#endif	/* HAVE_PTHREAD */
+  blocks_free();
 #ifdef HAVE_ZLIB_H
-  {
-    if( fmf_compr != 0 ) {		/* close zlib */
-      zstream.avail_in = 0;
-      do {
-        zstream.avail_out = ZBUF_SIZE;
-        zstream.next_out = zbuf_o;
-        deflate( &zstream, Z_SYNC_FLUSH );
-        if( zstream.avail_out != ZBUF_SIZE )
-          fwrite( zbuf_o, ZBUF_SIZE - zstream.avail_out, 1, of );
-      } while ( zstream.avail_out != ZBUF_SIZE );
-      deflateEnd( &zstream );
-      fmf_compr = -1;
-    }
-  }
+  fmf_compr = -1;
 #endif	/* HAVE_ZLIB_H */
   format = '?';
   if( of ) {
@@ -422,11 +715,11 @@ write_alaw( libspectrum_signed_word *buff, int len )
     buff++;
     if( i == 4096 ) {
       i = 0;
-      fwrite_compr( sbuff, 4096, 1, of );	/* write frame */
+      movie_write( sbuff, 4096 );	/* write frame */
     }
   }
   if( i )
-    fwrite_compr( sbuff, i, 1, of );	/* write remaind */
+    movie_write( sbuff, i );	/* write remaind */
 }
 
 static void
@@ -441,9 +734,9 @@ add_sound( libspectrum_signed_word *buff, int len )
   head[5] = len & 0xff;
   head[6] = len >> 8;
   len++;		/* len :-) */
-  fwrite_compr( head, 7, 1, of );	/* Sound frame */
+  movie_write( head, 7 );	/* Sound frame */
   if( format == 'P' )
-    fwrite_compr( buff, len * framesiz , 1, of );	/* write frame */
+    movie_write( buff, len * framesiz );	/* write frame */
   else if( format == 'A' )
     write_alaw( buff, len * framesiz );
 }
@@ -472,7 +765,7 @@ movie_start_frame( void )
   head[1] = settings_current.frame_rate;
   head[2] = get_screentype();
   head[3] = get_timing();
-  fwrite_compr( head, 4, 1, of );	/* New frame! */
+  movie_write( head, 4 );	/* New frame! */
   frame_no++;
   if( movie_paused ) {
     movie_paused = 0;
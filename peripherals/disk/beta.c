@@ -46,6 +46,7 @@
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
 #include "module.h"
+#include "rzx.h"
 #include "settings.h"
 #include "ui/ui.h"
 #include "ui/uimedia.h"
@@ -89,6 +90,13 @@ static const periph_t beta_peripheral = {
   /* .activate = */ NULL,
 };
 
+/* TR-DOS #3D13 service call and the system variables it uses */
+#define TRDOS_READ_SECTORS 0x05
+#define TRDOS_CURRENT_DRIVE 0x5cf6
+#define TRDOS_ERROR_CODE 0x5d0f
+#define TRDOS_SECTOR_LENGTH 256
+#define TRDOS_SECTORS_PER_TRACK 16
+
 /* Debugger events */
 static const char * const event_type_string = "beta128";
 static int page_event, unpage_event;
@@ -500,6 +508,55 @@ beta_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_beta_system( snap, beta_system_register );
 }
 
+/* Service a TR-DOS #3D13 call straight from the disk image. Only
+   function 5 (read B sectors from track D, sector E to HL) is handled;
+   anything else, or a sector which isn't a plain 256 byte sector with a
+   good CRC, is left to the ROM and the FDC emulation */
+int
+beta_disk_trap( void )
+{
+  libspectrum_byte buffer[ TRDOS_SECTOR_LENGTH ];
+  fdd_t *d;
+  disk_t *disk;
+  int track, sector, count, i;
+  libspectrum_word address;
+
+  if( !settings_current.disk_traps || rzx_playback || rzx_recording )
+    return 2;
+
+  if( C != TRDOS_READ_SECTORS || B == 0 ) return 1;
+
+  d = &beta_drives[ readbyte_internal( TRDOS_CURRENT_DRIVE ) & 0x03 ];
+  if( !d->loaded || d->upsidedown ) return 1;
+  disk = &d->disk;
+
+  track = D; sector = E; address = HL;
+
+  for( count = B; count; count-- ) {
+    if( disk_read_sector( disk, disk->sides == 2 ? track & 0x01 : 0,
+                          disk->sides == 2 ? track >> 1 : track, sector + 1,
+                          buffer, TRDOS_SECTOR_LENGTH ) )
+      return 1;
+
+    for( i = 0; i < TRDOS_SECTOR_LENGTH; i++ )
+      writebyte_internal( address++, buffer[i] );
+
+    if( ++sector == TRDOS_SECTORS_PER_TRACK ) {
+      sector = 0;
+      track++;
+    }
+  }
+
+  /* Leave the registers as the ROM would, ready for the next read */
+  D = track; E = sector; HL = address; B = 0;
+  writebyte_internal( TRDOS_ERROR_CODE, 0 );
+
+  PC = readbyte_internal( SP ) | ( readbyte_internal( SP + 1 ) << 8 );
+  SP += 2;
+
+  return 0;
+}
+
 int
 beta_unittest( void )
 {
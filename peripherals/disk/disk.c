@@ -704,6 +704,64 @@ disk_close( disk_t *d )
   d->type = DISK_TYPE_NONE;
 }
 
+/* check the CRC of the `length' byte data field starting at d->i, just
+   after its data mark; the CRC also covers the mark and, for MFM, the
+   0xa1 sync bytes before it */
+static int
+data_crc_ok( disk_t *d, size_t length )
+{
+  libspectrum_word crc = 0xffff;
+  size_t i, mark = d->i - 1;
+  int sync = 0;
+
+  if( d->i + length + 2 > (size_t)d->bpt ) return 0;
+
+  while( sync < 3 && mark > (size_t)sync &&
+         d->track[ mark - sync - 1 ] == 0xa1 &&
+         bitmap_test( d->clocks, mark - sync - 1 ) )
+    sync++;
+
+  while( sync-- ) crc = crc_fdc( crc, 0xa1 );
+  for( i = mark; i < d->i + length + 2; i++ )
+    crc = crc_fdc( crc, d->track[i] );
+
+  return crc == 0x0000;
+}
+
+/* copy the data field of the sector with ID `sector' on cylinder
+   `cylinder' of side `head' into `buffer', without disturbing the
+   current track position used by the FDD */
+int
+disk_read_sector( disk_t *d, int head, int cylinder, int sector,
+                  libspectrum_byte *buffer, size_t length )
+{
+  disk_position_context_t c;
+  int h, t, s, l, del;
+  int found = 0;
+
+  if( d->data == NULL || d->have_weak ||
+      head >= d->sides || cylinder >= d->cylinders )
+    return 1;
+
+  position_context_save( d, &c );
+  DISK_SET_TRACK( d, head, cylinder );
+  d->i = 0;	/* start of the track */
+
+  while( id_read( d, &h, &t, &s, &l ) ) {
+    if( t != cylinder || s != sector ) continue;
+
+    if( l < 8 && ( 0x80U << l ) == length &&
+        datamark_read( d, &del ) && !del && data_crc_ok( d, length ) ) {
+      memcpy( buffer, d->track + d->i, length );
+      found = 1;
+    }
+    break;
+  }
+
+  position_context_restore( d, &c );
+  return found ? 0 : 1;
+}
+
 /*
  *  if d->density == DISK_DENS_AUTO => 
  *                            use d->tlen if d->bpt == 0
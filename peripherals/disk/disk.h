@@ -160,6 +160,12 @@ int disk_write( disk_t *d, const char *filename );
 /* format disk to plus3 accept for formatting
 */
 int disk_preformat( disk_t *d );
+/* read the data of sector `sector' on the given side and cylinder into
+   `buffer'; returns 0 if the sector was found with a normal data mark, a
+   size of exactly `length' bytes and a good data CRC, else 1
+*/
+int disk_read_sector( disk_t *d, int head, int cylinder, int sector,
+                      libspectrum_byte *buffer, size_t length );
 /* close a disk and free buffers
 */
 void disk_close( disk_t *d );
@@ -44,6 +44,7 @@
 #define FDD_STEP_FACT 34
 #define FDD_MAX_TRACK 99		/* absolute maximum number of track*/
 #define FDD_TRACK_TRESHOLD 10		/* unreadable disk*/
+#define FDD_TURBO_LATENCY 32		/* tstates for any delay in turbo mode */
 
 typedef enum fdd_write_t {
   FDD_READ = 0,
@@ -221,8 +222,8 @@ fdd_motoron( fdd_t *d, int on )
   */
   event_remove_type_user_data( motor_event, d );		/* remove pending motor-on event for *this* drive */
   if( on ) {
-    event_add_with_data( tstates + 4 *			/* 2 revolution: 2 * 200 / 1000 */
-			 machine_current->timings.processor_speed / 10,
+    event_add_with_data( tstates + fdd_latency( 4 *	/* 2 revolution: 2 * 200 / 1000 */
+			 machine_current->timings.processor_speed / 10 ),
 			 motor_event, d );
     if( d->loaded ) /* index rotating */
       event_add_with_data( tstates + ( d->index_pulse ? 10 : 190 ) *
@@ -443,6 +444,15 @@ fdd_wrprot( fdd_t *d, int wrprot )
   d->wrprot = d->disk.wrprot = wrprot;
 }
 
+libspectrum_dword
+fdd_latency( libspectrum_dword delay )
+{
+  if( settings_current.turbo_disk && delay > FDD_TURBO_LATENCY )
+    return FDD_TURBO_LATENCY;
+
+  return delay;
+}
+
 void
 fdd_wait_index_hole( fdd_t *d )
 {
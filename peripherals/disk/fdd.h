@@ -153,5 +153,9 @@ void fdd_wrprot( fdd_t *d, int wrprot );
 void fdd_wait_index_hole( fdd_t *d );
 /* set floppy position ( upsidedown or not )*/
 void fdd_flip( fdd_t *d, int upsidedown );
+/* length of a mechanical delay (spin-up, head load/settle, step, rotation
+   to a sector) which would take `delay' tstates in real time; collapsed
+   in turbo disk mode. Not for timeouts */
+libspectrum_dword fdd_latency( libspectrum_dword delay );
 
 #endif 	/* FUSE_FDD_H */
@@ -102,9 +102,9 @@ divide_init( void *context )
   divide_idechn1 = libspectrum_ide_alloc( LIBSPECTRUM_IDE_DATA16 );
   
   error = ide_init( divide_idechn0,
-		    settings_current.divide_master_file,
+		    &settings_current.divide_master_file,
 		    UI_MENU_ITEM_MEDIA_IDE_DIVIDE_MASTER_EJECT,
-		    settings_current.divide_slave_file,
+		    &settings_current.divide_slave_file,
 		    UI_MENU_ITEM_MEDIA_IDE_DIVIDE_SLAVE_EJECT );
   if( error ) return error;
 
@@ -167,11 +167,9 @@ divide_insert( const char *filename, libspectrum_ide_unit unit )
 int
 divide_commit( libspectrum_ide_unit unit )
 {
-  int error;
-
-  error = libspectrum_ide_commit( divide_idechn0, unit );
-
-  return error;
+  return ide_master_slave_commit( divide_idechn0, unit,
+                                  &settings_current.divide_master_file,
+                                  &settings_current.divide_slave_file );
 }
 
 int
@@ -30,6 +30,7 @@
 
 #include "debugger/debugger.h"
 #include "ide.h"
+#include "ideimage.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
 #include "module.h"
@@ -114,10 +115,13 @@ divmmc_init( void *context )
   ui_menu_activate( eject_menu_item, 0 );
 
   if( settings_current.divmmc_file ) {
+    const char *filename;
     int error;
 
-    error =
-      libspectrum_mmc_insert( card, settings_current.divmmc_file );
+    filename = ideimage_open( &settings_current.divmmc_file );
+    if( !filename ) return 1;
+
+    error = libspectrum_mmc_insert( card, filename );
     if( error ) return error;
 
     error = ui_menu_activate( eject_menu_item, 1 );
@@ -210,8 +214,14 @@ divmmc_insert( const char *filename )
 
   settings_set_string( &settings_current.divmmc_file, filename );
 
+  filename = ideimage_open( &settings_current.divmmc_file );
+  if( !filename ) return 1;
+
   error = libspectrum_mmc_insert( card, filename );
-  if( error ) return error;
+  if( error ) {
+    ideimage_close( &settings_current.divmmc_file );
+    return error;
+  }
   return ui_menu_activate( eject_menu_item, 1 );
 }
   
@@ -219,6 +229,7 @@ void
 divmmc_commit( void )
 {
   libspectrum_mmc_commit( card );
+  ideimage_commit( &settings_current.divmmc_file );
 }
 
 int
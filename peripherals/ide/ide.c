@@ -26,37 +26,42 @@
 #include "libspectrum.h"
 
 #include "ide.h"
+#include "ideimage.h"
 #include "ui/ui.h"
 #include "settings.h"
 
 static int
 ide_insert_file( libspectrum_ide_channel *channel, libspectrum_ide_unit unit,
-		 const char *filename, ui_menu_item menu_item )
+		 char **setting, ui_menu_item menu_item )
 {
+  const char *filename;
   int error;
 
+  filename = ideimage_open( setting );
+  if( !filename ) return 1;
+
   error = libspectrum_ide_insert( channel, unit, filename );
-  if( error ) return error;
+  if( error ) { ideimage_close( setting ); return error; }
   return ui_menu_activate( menu_item, 1 );
 }
 
 int
 ide_init( libspectrum_ide_channel *channel,
-	  char *master_setting, ui_menu_item master_menu_item,
-	  char *slave_setting, ui_menu_item slave_menu_item )
+	  char **master_setting, ui_menu_item master_menu_item,
+	  char **slave_setting, ui_menu_item slave_menu_item )
 {
   int error;
 
   ui_menu_activate( master_menu_item, 0 );
   ui_menu_activate( slave_menu_item, 0 );
 
-  if( master_setting ) {
+  if( *master_setting ) {
     error = ide_insert_file( channel, LIBSPECTRUM_IDE_MASTER, master_setting,
 		             master_menu_item );
     if( error ) return error;
   }
 
-  if( slave_setting ) {
+  if( *slave_setting ) {
     error = ide_insert_file( channel, LIBSPECTRUM_IDE_SLAVE, slave_setting,
                              slave_menu_item );
     if( error ) return error;
@@ -107,12 +112,38 @@ ide_insert( const char *filename, libspectrum_ide_channel *chn,
 
   settings_set_string( setting, filename );
 
-  error = ide_insert_file( chn, unit, filename, item );
+  error = ide_insert_file( chn, unit, setting, item );
   if( error ) return error;
 
   return 0;
 }
 
+int
+ide_commit( libspectrum_ide_channel *chn, libspectrum_ide_unit unit,
+            char **setting )
+{
+  int error;
+
+  error = libspectrum_ide_commit( chn, unit );
+  if( error ) return error;
+
+  return ideimage_commit( setting );
+}
+
+int
+ide_master_slave_commit(
+  libspectrum_ide_channel *channel, libspectrum_ide_unit unit,
+  char **master_setting, char **slave_setting )
+{
+  switch( unit ) {
+  case LIBSPECTRUM_IDE_MASTER:
+    return ide_commit( channel, unit, master_setting );
+  case LIBSPECTRUM_IDE_SLAVE:
+    return ide_commit( channel, unit, slave_setting );
+  default: return 1;
+  }
+}
+
 int
 ide_master_slave_eject(
   libspectrum_ide_channel *channel, libspectrum_ide_unit unit,
@@ -156,6 +187,7 @@ ide_eject_mass_storage(
 
     case UI_CONFIRM_SAVE_SAVE:
       error = commit_fn( context ); if( error ) return error;
+      error = ideimage_commit( setting ); if( error ) return error;
       break;
 
     case UI_CONFIRM_SAVE_DONTSAVE: break;
@@ -169,6 +201,8 @@ ide_eject_mass_storage(
   error = eject_fn( context );
   if( error ) return error;
 
+  ideimage_close( setting );
+
   error = ui_menu_activate( item, 0 );
   if( error ) return error;
 
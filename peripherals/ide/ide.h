@@ -29,8 +29,8 @@
 /* Insert the images into the master and slave units if appropriate */
 int
 ide_init( libspectrum_ide_channel *channel,
-	  char *master_setting, ui_menu_item master_menu_item,
-	  char *slave_setting, ui_menu_item slave_menu_item );
+	  char **master_setting, ui_menu_item master_menu_item,
+	  char **slave_setting, ui_menu_item slave_menu_item );
 
 int
 ide_master_slave_insert(
@@ -43,6 +43,16 @@ int
 ide_insert( const char *filename, libspectrum_ide_channel *chn,
 	    libspectrum_ide_unit unit, char **setting, ui_menu_item item );
 
+/* Commit any changes to the image, including those in its overlay */
+int
+ide_commit( libspectrum_ide_channel *chn, libspectrum_ide_unit unit,
+            char **setting );
+
+int
+ide_master_slave_commit(
+  libspectrum_ide_channel *channel, libspectrum_ide_unit unit,
+  char **master_setting, char **slave_setting );
+
 int
 ide_master_slave_eject(
   libspectrum_ide_channel *channel, libspectrum_ide_unit unit,
@@ -0,0 +1,397 @@
+/* ideimage.c: Copy-on-write overlays for IDE and MMC images
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* libspectrum does all the sector reads and writes for IDE and MMC images
+   itself, straight from the file it is given, and keeps written sectors in
+   memory until they are committed. With overlays enabled, the file it is
+   given is a private copy of the image in the temporary directory, so any
+   number of emulators can run from one image without changing it.
+
+   Where the filesystem supports it, the copy is a reflink which shares all
+   its blocks with the image until they are written, so even a multi-gigabyte
+   image is copied instantly and costs no space. As libspectrum reads the
+   file itself, we can't keep just the written sectors and consult them on
+   each read, so elsewhere the copy is made from a read-only mapping of the
+   image, leaving holes where the image is empty; as that can take a while
+   for a large image, we warn that it is happening.
+
+   Committing an overlay writes just the sectors which differ back to the
+   image; ejecting the image or exiting throws the overlay away. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined HAVE_LINUX_FS_H && defined HAVE_SYS_IOCTL_H
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif		/* #if defined HAVE_LINUX_FS_H && defined HAVE_SYS_IOCTL_H */
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+
+#include "libspectrum.h"
+
+#include "compat.h"
+#include "ideimage.h"
+#include "infrastructure/startup_manager.h"
+#include "settings.h"
+#include "ui/ui.h"
+#include "utils.h"
+
+#define IDEIMAGE_SECTOR_LENGTH 512
+
+/* How much of the image to look at a time when making a sparse copy */
+#define IDEIMAGE_COPY_CHUNK 0x10000
+
+typedef struct ideimage_overlay {
+
+  char **setting;		/* The setting holding the image's name */
+  char *image;			/* The image itself */
+  char *overlay;		/* Our private copy of the image */
+
+} ideimage_overlay;
+
+static GSList *overlays;
+
+static ideimage_overlay*
+find_overlay( char **setting )
+{
+  GSList *ptr;
+
+  for( ptr = overlays; ptr; ptr = ptr->next ) {
+    ideimage_overlay *overlay = ptr->data;
+    if( overlay->setting == setting ) return overlay;
+  }
+
+  return NULL;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+
+static int
+write_all( int fd, const libspectrum_byte *buffer, size_t length,
+           off_t offset )
+{
+  ssize_t written;
+
+  while( length ) {
+    written = pwrite( fd, buffer, length, offset );
+    if( written < 0 ) {
+      if( errno == EINTR ) continue;
+      return 1;
+    }
+    buffer += written; length -= written; offset += written;
+  }
+
+  return 0;
+}
+
+/* Map all of `fd' read-only; the mapping of an empty file is NULL */
+static int
+map_file( int fd, const char *filename, const libspectrum_byte **map,
+          size_t *length )
+{
+  struct stat file_info;
+  void *mapping;
+
+  if( fstat( fd, &file_info ) ) {
+    ui_error( UI_ERROR_ERROR, "couldn't stat '%s': %s", filename,
+              strerror( errno ) );
+    return 1;
+  }
+
+  if( (libspectrum_qword)file_info.st_size > (size_t)-1 ) {
+    ui_error( UI_ERROR_ERROR, "'%s' is too large to map", filename );
+    return 1;
+  }
+
+  *length = file_info.st_size;
+  *map = NULL;
+  if( !*length ) return 0;
+
+  mapping = mmap( NULL, *length, PROT_READ, MAP_SHARED, fd, 0 );
+  if( mapping == MAP_FAILED ) {
+    ui_error( UI_ERROR_ERROR, "couldn't map '%s': %s", filename,
+              strerror( errno ) );
+    return 1;
+  }
+
+  *map = mapping;
+  return 0;
+}
+
+static int
+is_zero( const libspectrum_byte *buffer, size_t length )
+{
+  static const libspectrum_byte zeros[ IDEIMAGE_COPY_CHUNK ];
+
+  return !memcmp( buffer, zeros, length );
+}
+
+static int
+copy_sparse( int src, int dest, const char *image )
+{
+  const libspectrum_byte *map;
+  size_t length, offset, chunk;
+  int error = 0;
+
+  if( map_file( src, image, &map, &length ) ) return 1;
+
+  if( ftruncate( dest, length ) ) {
+    ui_error( UI_ERROR_ERROR, "couldn't size overlay for '%s': %s", image,
+              strerror( errno ) );
+    error = 1;
+  }
+
+  for( offset = 0; !error && offset < length; offset += chunk ) {
+    chunk = length - offset;
+    if( chunk > IDEIMAGE_COPY_CHUNK ) chunk = IDEIMAGE_COPY_CHUNK;
+
+    if( is_zero( &map[ offset ], chunk ) ) continue;
+
+    if( write_all( dest, &map[ offset ], chunk, offset ) ) {
+      ui_error( UI_ERROR_ERROR, "couldn't write overlay for '%s': %s", image,
+                strerror( errno ) );
+      error = 1;
+    }
+  }
+
+  if( map ) munmap( (void*)map, length );
+
+  return error;
+}
+
+static int
+make_overlay( ideimage_overlay *overlay )
+{
+  int src, dest, error;
+
+  src = open( overlay->image, O_RDONLY );
+  if( src == -1 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't open '%s': %s", overlay->image,
+              strerror( errno ) );
+    return 1;
+  }
+
+  dest = mkstemp( overlay->overlay );
+  if( dest == -1 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't create overlay '%s': %s",
+              overlay->overlay, strerror( errno ) );
+    close( src );
+    return 1;
+  }
+
+#ifdef FICLONE
+  if( !ioctl( dest, FICLONE, src ) ) {
+    close( dest ); close( src );
+    return 0;
+  }
+#endif			/* #ifdef FICLONE */
+
+  ui_error( UI_ERROR_WARNING,
+            "can't share blocks between '%s' and an overlay in '%s'; copying "
+            "the whole image instead", overlay->image,
+            compat_get_temp_path() );
+
+  error = copy_sparse( src, dest, overlay->image );
+
+  close( dest ); close( src );
+  if( error ) remove( overlay->overlay );
+
+  return error;
+}
+
+static int
+write_back( ideimage_overlay *overlay, int image, int copy )
+{
+  const libspectrum_byte *image_map, *copy_map;
+  size_t image_length, copy_length, length, offset, run, sector;
+  int error = 0;
+
+  if( map_file( image, overlay->image, &image_map, &image_length ) )
+    return 1;
+  if( map_file( copy, overlay->overlay, &copy_map, &copy_length ) ) {
+    if( image_map ) munmap( (void*)image_map, image_length );
+    return 1;
+  }
+
+  /* libspectrum never changes the size of an image */
+  length = image_length < copy_length ? image_length : copy_length;
+
+  /* Write out each run of changed sectors as it ends */
+  run = 0;
+  for( offset = 0; !error && offset <= length; offset += sector ) {
+    sector = length - offset;
+    if( sector > IDEIMAGE_SECTOR_LENGTH ) sector = IDEIMAGE_SECTOR_LENGTH;
+
+    if( sector &&
+        memcmp( &image_map[ offset ], &copy_map[ offset ], sector ) )
+      continue;
+
+    if( run < offset )
+      error = write_all( image, &copy_map[ run ], offset - run, run );
+
+    if( !sector ) break;
+    run = offset + sector;
+  }
+
+  if( error )
+    ui_error( UI_ERROR_ERROR, "couldn't write to '%s': %s", overlay->image,
+              strerror( errno ) );
+
+#ifdef HAVE_FSYNC
+  if( !error ) fsync( image );
+#endif			/* #ifdef HAVE_FSYNC */
+
+  if( copy_map ) munmap( (void*)copy_map, copy_length );
+  if( image_map ) munmap( (void*)image_map, image_length );
+
+  return error;
+}
+
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+
+const char*
+ideimage_open( char **setting )
+{
+  ideimage_overlay *overlay;
+  const char *temp_path;
+  size_t length;
+
+  ideimage_close( setting );
+
+  if( !settings_current.mass_storage_overlay ) return *setting;
+
+#ifdef HAVE_SYS_MMAN_H
+
+  temp_path = compat_get_temp_path();
+  length = strlen( temp_path ) + strlen( FUSE_DIR_SEP_STR ) +
+           strlen( "fuse-overlay-XXXXXX" ) + 1;
+
+  overlay = libspectrum_new( ideimage_overlay, 1 );
+  overlay->setting = setting;
+  overlay->image = utils_safe_strdup( *setting );
+  overlay->overlay = libspectrum_new( char, length );
+  snprintf( overlay->overlay, length, "%s" FUSE_DIR_SEP_STR
+            "fuse-overlay-XXXXXX", temp_path );
+
+  if( make_overlay( overlay ) ) {
+    libspectrum_free( overlay->overlay );
+    libspectrum_free( overlay->image );
+    libspectrum_free( overlay );
+    return NULL;
+  }
+
+  overlays = g_slist_prepend( overlays, overlay );
+
+  return overlay->overlay;
+
+#else			/* #ifdef HAVE_SYS_MMAN_H */
+
+  (void)overlay; (void)temp_path; (void)length;
+
+  ui_error( UI_ERROR_WARNING,
+            "image overlays are not supported on this system; using '%s' "
+            "directly", *setting );
+  return *setting;
+
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+}
+
+int
+ideimage_commit( char **setting )
+{
+#ifdef HAVE_SYS_MMAN_H
+  ideimage_overlay *overlay;
+  int image, copy, error;
+
+  overlay = find_overlay( setting );
+  if( !overlay ) return 0;
+
+  /* libspectrum writes its changes with stdio, so make sure they've actually
+     reached the overlay before we look at it */
+  fflush( NULL );
+
+  image = open( overlay->image, O_RDWR );
+  if( image == -1 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't open '%s' for writing: %s",
+              overlay->image, strerror( errno ) );
+    return 1;
+  }
+
+  copy = open( overlay->overlay, O_RDONLY );
+  if( copy == -1 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't open overlay '%s': %s",
+              overlay->overlay, strerror( errno ) );
+    close( image );
+    return 1;
+  }
+
+  error = write_back( overlay, image, copy );
+
+  close( copy );
+  close( image );
+
+  return error;
+#else			/* #ifdef HAVE_SYS_MMAN_H */
+  (void)setting;
+  return 0;
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+}
+
+void
+ideimage_close( char **setting )
+{
+  ideimage_overlay *overlay = find_overlay( setting );
+
+  if( !overlay ) return;
+
+  overlays = g_slist_remove( overlays, overlay );
+
+  remove( overlay->overlay );
+  libspectrum_free( overlay->overlay );
+  libspectrum_free( overlay->image );
+  libspectrum_free( overlay );
+}
+
+static void
+ideimage_end( void )
+{
+  while( overlays ) {
+    ideimage_overlay *overlay = overlays->data;
+    ideimage_close( overlay->setting );
+  }
+}
+
+void
+ideimage_register_startup( void )
+{
+  startup_manager_register_no_dependencies( STARTUP_MANAGER_MODULE_IDEIMAGE,
+                                            NULL, NULL, ideimage_end );
+}
@@ -0,0 +1,41 @@
+/* ideimage.h: Copy-on-write overlays for IDE and MMC images
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_IDEIMAGE_H
+#define FUSE_IDEIMAGE_H
+
+void ideimage_register_startup( void );
+
+/* Get the file which should be handed to libspectrum for the image named
+   by `*setting': either the image itself or, if overlays are enabled, a
+   private copy-on-write copy of it. Returns NULL on error */
+const char* ideimage_open( char **setting );
+
+/* Copy any sectors changed in the overlay for `*setting' back to the image.
+   Call after libspectrum has committed its own changes to the overlay */
+int ideimage_commit( char **setting );
+
+/* Throw away the overlay for `*setting', if there is one */
+void ideimage_close( char **setting );
+
+#endif			/* #ifndef FUSE_IDEIMAGE_H */
@@ -79,9 +79,9 @@ simpleide_init( void *context )
   simpleide_idechn = libspectrum_ide_alloc( LIBSPECTRUM_IDE_DATA8 );
 
   error = ide_init( simpleide_idechn,
-		    settings_current.simpleide_master_file,
+		    &settings_current.simpleide_master_file,
 		    UI_MENU_ITEM_MEDIA_IDE_SIMPLE8BIT_MASTER_EJECT,
-		    settings_current.simpleide_slave_file,
+		    &settings_current.simpleide_slave_file,
 		    UI_MENU_ITEM_MEDIA_IDE_SIMPLE8BIT_SLAVE_EJECT );
   if( error ) return error;
 
@@ -129,11 +129,9 @@ simpleide_insert( const char *filename, libspectrum_ide_unit unit )
 int
 simpleide_commit( libspectrum_ide_unit unit )
 {
-  int error;
-
-  error = libspectrum_ide_commit( simpleide_idechn, unit );
-
-  return error;
+  return ide_master_slave_commit( simpleide_idechn, unit,
+                                  &settings_current.simpleide_master_file,
+                                  &settings_current.simpleide_slave_file );
 }
 
 int
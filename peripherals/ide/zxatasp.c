@@ -176,9 +176,9 @@ zxatasp_init( void *context )
   zxatasp_idechn1 = libspectrum_ide_alloc( LIBSPECTRUM_IDE_DATA16 );
 
   error = ide_init( zxatasp_idechn0,
-                    settings_current.zxatasp_master_file,
+                    &settings_current.zxatasp_master_file,
                     UI_MENU_ITEM_MEDIA_IDE_ZXATASP_MASTER_EJECT,
-                    settings_current.zxatasp_slave_file,
+                    &settings_current.zxatasp_slave_file,
                     UI_MENU_ITEM_MEDIA_IDE_ZXATASP_SLAVE_EJECT );
   if( error ) return error;
 
@@ -248,11 +248,9 @@ zxatasp_insert( const char *filename, libspectrum_ide_unit unit )
 int
 zxatasp_commit( libspectrum_ide_unit unit )
 {
-  int error;
-
-  error = libspectrum_ide_commit( zxatasp_idechn0, unit );
-
-  return error;
+  return ide_master_slave_commit( zxatasp_idechn0, unit,
+                                  &settings_current.zxatasp_master_file,
+                                  &settings_current.zxatasp_slave_file );
 }
 
 int
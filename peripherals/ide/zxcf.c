@@ -31,6 +31,7 @@
 
 #include "debugger/debugger.h"
 #include "ide.h"
+#include "ideimage.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
 #include "memory_pages.h"
@@ -121,8 +122,10 @@ zxcf_init( void *context )
   ui_menu_activate( UI_MENU_ITEM_MEDIA_IDE_ZXCF_EJECT, 0 );
 
   if( settings_current.zxcf_pri_file ) {
+    const char *filename = ideimage_open( &settings_current.zxcf_pri_file );
+    if( !filename ) return 1;
     error = libspectrum_ide_insert( zxcf_idechn, LIBSPECTRUM_IDE_MASTER,
-				    settings_current.zxcf_pri_file );
+				    filename );
     if( error ) return error;
     ui_menu_activate( UI_MENU_ITEM_MEDIA_IDE_ZXCF_EJECT, 1 );
   }
@@ -185,11 +188,8 @@ zxcf_insert( const char *filename )
 int
 zxcf_commit( void )
 {
-  int error;
-
-  error = libspectrum_ide_commit( zxcf_idechn, LIBSPECTRUM_IDE_MASTER );
-
-  return error;
+  return ide_commit( zxcf_idechn, LIBSPECTRUM_IDE_MASTER,
+                     &settings_current.zxcf_pri_file );
 }
 
 int
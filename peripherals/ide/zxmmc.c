@@ -28,6 +28,7 @@
 #include <string.h>
 
 #include "ide.h"
+#include "ideimage.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
 #include "module.h"
@@ -91,10 +92,13 @@ zxmmc_init( void *context )
   ui_menu_activate( eject_menu_item, 0 );
 
   if( settings_current.zxmmc_file ) {
+    const char *filename;
     int error;
 
-    error =
-      libspectrum_mmc_insert( card, settings_current.zxmmc_file );
+    filename = ideimage_open( &settings_current.zxmmc_file );
+    if( !filename ) return 1;
+
+    error = libspectrum_mmc_insert( card, filename );
     if( error ) return error;
 
     error = ui_menu_activate( eject_menu_item, 1 );
@@ -176,8 +180,14 @@ zxmmc_insert( const char *filename )
 
   settings_set_string( &settings_current.zxmmc_file, filename );
 
+  filename = ideimage_open( &settings_current.zxmmc_file );
+  if( !filename ) return 1;
+
   error = libspectrum_mmc_insert( card, filename );
-  if( error ) return error;
+  if( error ) {
+    ideimage_close( &settings_current.zxmmc_file );
+    return error;
+  }
   return ui_menu_activate( eject_menu_item, 1 );
 }
 
@@ -185,6 +195,7 @@ void
 zxmmc_commit( void )
 {
   libspectrum_mmc_commit( card );
+  ideimage_commit( &settings_current.zxmmc_file );
 }
 
 int
@@ -237,6 +237,24 @@ joystick_press( int which, joystick_button button, int press )
   fuse_abort();
 }
 
+void
+joystick_state_get( libspectrum_byte *state )
+{
+  state[0] = kempston_value;
+  state[1] = timex1_value;
+  state[2] = timex2_value;
+  state[3] = fuller_value;
+}
+
+void
+joystick_state_set( const libspectrum_byte *state )
+{
+  kempston_value = state[0];
+  timex1_value = state[1];
+  timex2_value = state[2];
+  fuller_value = state[3];
+}
+
 /* Read functions for specific interfaces */
 
 libspectrum_byte
@@ -70,6 +70,12 @@ typedef enum joystick_button {
    pressed */
 int joystick_press( int which, joystick_button button, int press );
 
+/* The values presented by the joystick interfaces, for the input log */
+#define JOYSTICK_STATE_LENGTH 4
+
+void joystick_state_get( libspectrum_byte *state );
+void joystick_state_set( const libspectrum_byte *state );
+
 /* Interface-specific read functions */
 libspectrum_byte joystick_kempston_read ( libspectrum_word port,
 					  libspectrum_byte *attached );
@@ -109,6 +109,22 @@ kempmouse_update( int dx, int dy, int btn, int down )
   }
 }
 
+void
+kempmouse_state_get( libspectrum_byte *state )
+{
+  state[0] = kempmouse.pos.x;
+  state[1] = kempmouse.pos.y;
+  state[2] = kempmouse.buttons;
+}
+
+void
+kempmouse_state_set( const libspectrum_byte *state )
+{
+  kempmouse.pos.x = state[0];
+  kempmouse.pos.y = state[1];
+  kempmouse.buttons = state[2];
+}
+
 static void
 kempmouse_snapshot_enabled( libspectrum_snap *snap )
 {
@@ -24,7 +24,15 @@
 #ifndef FUSE_KEMPMOUSE_H
 #define FUSE_KEMPMOUSE_H
 
+#include "libspectrum.h"
+
 void kempmouse_register_startup( void );
 void kempmouse_update( int dx, int dy, int button, int down );
 
+/* The position and buttons of the mouse, for the input log */
+#define KEMPMOUSE_STATE_LENGTH 3
+
+void kempmouse_state_get( libspectrum_byte *state );
+void kempmouse_state_set( const libspectrum_byte *state );
+
 #endif
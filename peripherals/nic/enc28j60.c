@@ -39,6 +39,7 @@
 #include "fuse.h"
 #include "settings.h"
 #include "ui/ui.h"
+#include "vnet.h"
 
 /* ---------------------------------------------------------------------------
  * ENC28J60 emulation
@@ -132,6 +133,8 @@ struct nic_enc28j60_t {
 
 };
 
+static int enc28j60_vnet_receive( const vnet_packet *packet, void *context );
+
 nic_enc28j60_t*
 nic_enc28j60_alloc( void )
 {
@@ -139,21 +142,65 @@ nic_enc28j60_alloc( void )
 
   self->tap_fd = -1;
   self->spi_state = SPI_IDLE;
+
+  vnet_attach( VNET_PACKET_ETHERNET, enc28j60_vnet_receive, self );
+
   return self;
 }
 
 void
 nic_enc28j60_init( nic_enc28j60_t *self )
 {
-  self->tap_fd = compat_get_tap( settings_current.speccyboot_tap );
+  /* No TAP is needed on the virtual network */
+  if( !settings_current.virtual_network )
+    self->tap_fd = compat_get_tap( settings_current.speccyboot_tap );
 }
 
 void
 nic_enc28j60_free( nic_enc28j60_t *self )
 {
+  vnet_detach( enc28j60_vnet_receive, self );
   libspectrum_free( self );
 }
 
+/* Copy the n byte frame in eth_rx_buf into the receive FIFO */
+static void
+enc28j60_store_frame( nic_enc28j60_t *self, ssize_t n )
+{
+  libspectrum_word erxwrpt = GET_PTR_REG( self, ERXWRPT );
+  libspectrum_word erxst   = GET_PTR_REG( self, ERXST );
+  libspectrum_word erxnd   = GET_PTR_REG( self, ERXND );
+
+  /* Round total_length upwards to an even value */
+  libspectrum_word total_length = (ETH_STATUS_LENGTH + n + 1) & 0x1ffe;
+  libspectrum_word next_addr    = erxwrpt + total_length;
+
+  /* Sanity check */
+  if (erxwrpt > erxnd)
+    return;
+
+  if ( next_addr > erxnd ) {  /* FIFO wrap-around? */  
+    libspectrum_word first_part = (erxnd - erxwrpt) + 1;
+
+    next_addr = (next_addr - erxnd) + erxst;
+        
+    self->eth_rx_buf[ ETH_STATUS_NEXT_LO ] = LOBYTE( next_addr );
+    self->eth_rx_buf[ ETH_STATUS_NEXT_HI ] = HIBYTE( next_addr );
+    
+    memcpy( self->sram + erxwrpt, self->eth_rx_buf, first_part );
+    memcpy( self->sram + erxst, self->eth_rx_buf + first_part, total_length - first_part );
+  } else {         
+    self->eth_rx_buf[ ETH_STATUS_NEXT_LO ] = LOBYTE( next_addr );
+    self->eth_rx_buf[ ETH_STATUS_NEXT_HI ] = HIBYTE( next_addr );
+
+    memcpy( self->sram + erxwrpt, self->eth_rx_buf, total_length );
+  }
+
+  SET_PTR_REG( self, ERXWRPT, next_addr );
+
+  ++EPKTCNT(self);
+}
+
 /* Poll for received frames. */
 void
 nic_enc28j60_poll( nic_enc28j60_t *self )
@@ -164,40 +211,52 @@ nic_enc28j60_poll( nic_enc28j60_t *self )
        && self->tap_fd > 0
        && (n = read( self->tap_fd,
                      self->eth_rx_buf + ETH_STATUS_LENGTH,
-                     ETH_MAX )) > 0) {
-    libspectrum_word erxwrpt = GET_PTR_REG( self, ERXWRPT );
-    libspectrum_word erxst   = GET_PTR_REG( self, ERXST );
-    libspectrum_word erxnd   = GET_PTR_REG( self, ERXND );
-
-    /* Round total_length upwards to an even value */
-    libspectrum_word total_length = (ETH_STATUS_LENGTH + n + 1) & 0x1ffe;
-    libspectrum_word next_addr    = erxwrpt + total_length;
-
-    /* Sanity check */
-    if (erxwrpt > erxnd)
-      return;
-
-    if ( next_addr > erxnd ) {  /* FIFO wrap-around? */  
-      libspectrum_word first_part = (erxnd - erxwrpt) + 1;
-
-      next_addr = (next_addr - erxnd) + erxst;
-          
-      self->eth_rx_buf[ ETH_STATUS_NEXT_LO ] = LOBYTE( next_addr );
-      self->eth_rx_buf[ ETH_STATUS_NEXT_HI ] = HIBYTE( next_addr );
-      
-      memcpy( self->sram + erxwrpt, self->eth_rx_buf, first_part );
-      memcpy( self->sram + erxst, self->eth_rx_buf + first_part, total_length - first_part );
-    } else {         
-      self->eth_rx_buf[ ETH_STATUS_NEXT_LO ] = LOBYTE( next_addr );
-      self->eth_rx_buf[ ETH_STATUS_NEXT_HI ] = HIBYTE( next_addr );
-
-      memcpy( self->sram + erxwrpt, self->eth_rx_buf, total_length );
-    }
+                     ETH_MAX )) > 0)
+    enc28j60_store_frame( self, n );
+}
 
-    SET_PTR_REG( self, ERXWRPT, next_addr );
+/* Free space in the receive FIFO, as given in the datasheet */
+static libspectrum_word
+enc28j60_rx_free( nic_enc28j60_t *self )
+{
+  libspectrum_word erxwrpt = GET_PTR_REG( self, ERXWRPT );
+  libspectrum_word erxrdpt = GET_PTR_REG( self, ERXRDPT );
+  libspectrum_word erxst   = GET_PTR_REG( self, ERXST );
+  libspectrum_word erxnd   = GET_PTR_REG( self, ERXND );
+
+  if ( erxnd < erxst )
+    return 0;
+
+  if ( erxwrpt > erxrdpt )
+    return (erxnd - erxst) - (erxwrpt - erxrdpt);
+  else if ( erxwrpt == erxrdpt )
+    return erxnd - erxst;
+  else
+    return erxrdpt - erxwrpt - 1;
+}
 
-    ++EPKTCNT(self);
-  }
+static int
+enc28j60_vnet_receive( const vnet_packet *packet, void *context )
+{
+  nic_enc28j60_t *self = context;
+
+  /* Frames wait until reception is enabled, as they would in the TAP */
+  if ( !(ECON1(self) & ECON1_RXEN) )
+    return 1;
+
+  if ( packet->length == 0 || packet->length > ETH_MAX )
+    return 0;
+
+  /* ...and until the program has made room for them in the FIFO */
+  if ( EPKTCNT(self) == 0xff ||
+       enc28j60_rx_free( self ) <
+         ((ETH_STATUS_LENGTH + packet->length + 1) & ~1) )
+    return 1;
+
+  memcpy( self->eth_rx_buf + ETH_STATUS_LENGTH, packet->data, packet->length );
+  enc28j60_store_frame( self, packet->length );
+
+  return 0;
 }
 
 /* Writing to some registers produces special side effects. */
@@ -208,7 +267,15 @@ perform_side_effects_for_write( nic_enc28j60_t *self )
     libspectrum_word frame_start = (GET_PTR_REG(self, ETXST) & 0x1fff) + 1;
     libspectrum_word frame_end   = GET_PTR_REG(self, ETXND) & 0x1fff;
 
-    if ( frame_end > frame_start && self->tap_fd >= 0) {
+    if ( frame_end > frame_start && settings_current.virtual_network ) {
+      vnet_packet packet;
+
+      memset( &packet, 0, sizeof( packet ) );
+      packet.type = VNET_PACKET_ETHERNET;
+      packet.data = self->sram + frame_start;
+      packet.length = (frame_end - frame_start) + 1;
+      vnet_send( VNET_NODE_PEER, &packet );
+    } else if ( frame_end > frame_start && self->tap_fd >= 0) {
       ssize_t length = (frame_end - frame_start) + 1;
       if ( write( self->tap_fd, self->sram + frame_start, length ) != length )
         self->tap_fd = -1; /* write failed: disable TAP */
@@ -220,6 +287,10 @@ perform_side_effects_for_write( nic_enc28j60_t *self )
   if ( ECON2(self) & ECON2_PKTDEC ) {    /* PKTDEC: decrease EPKTCNT */
     --EPKTCNT(self);
     ECON2(self) &= ~ECON2_PKTDEC;
+
+    /* There may be frames waiting for the space */
+    if ( settings_current.virtual_network )
+      vnet_deliver();
   }
 }
 
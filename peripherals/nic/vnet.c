@@ -0,0 +1,435 @@
+/* vnet.c: In-memory virtual network for the emulated network interfaces
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* With the virtual network enabled, the Spectranet and SpeccyBoot don't
+   touch the host's network at all. Everything they send is handed to the
+   peer, which is whatever is driving the emulator (a fuzx script, say),
+   and the peer's packets are handed back to them; packets the Spectranet
+   sends to its own address go straight back to it.
+
+   Every packet takes the same configured number of tstates to arrive, and
+   arrives from the emulation's own event loop, so a run behaves the same
+   every time, however fast it goes. Several machines can share a network
+   by having their peers relay packets to each other between frames. */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "event.h"
+#include "fuse.h"
+#include "infrastructure/startup_manager.h"
+#include "settings.h"
+#include "spectrum.h"
+#include "vnet.h"
+
+typedef struct vnet_flight {
+
+  vnet_packet *packet;
+  vnet_node destination;
+  libspectrum_dword tstates;	/* When the packet arrives */
+
+} vnet_flight;
+
+static struct {
+  vnet_receive_fn receive;
+  void *context;
+} receivers[ VNET_PACKET_TYPES ];
+
+/* Packets on their way, in order of arrival */
+static GSList *in_flight;
+
+/* Packets which have arrived for the peer, oldest first */
+static GSList *peer_queue, *peer_queue_last;
+
+static int delivering;
+
+static int vnet_event;
+
+static void
+vnet_event_fn( libspectrum_dword event_tstates GCC_UNUSED,
+               int type GCC_UNUSED, void *user_data GCC_UNUSED )
+{
+  vnet_deliver();
+}
+
+static int
+vnet_init( void *context )
+{
+  vnet_event = event_register( vnet_event_fn, "Virtual network" );
+
+  return 0;
+}
+
+static void
+vnet_end( void )
+{
+  vnet_reset();
+}
+
+void
+vnet_register_startup( void )
+{
+  startup_manager_module dependencies[] = {
+    STARTUP_MANAGER_MODULE_EVENT,
+    STARTUP_MANAGER_MODULE_SETUID,
+  };
+  startup_manager_register( STARTUP_MANAGER_MODULE_VNET, dependencies,
+                            ARRAY_SIZE( dependencies ), vnet_init, NULL,
+                            vnet_end );
+}
+
+void
+vnet_attach( vnet_packet_type type, vnet_receive_fn receive, void *context )
+{
+  receivers[ type ].receive = receive;
+  receivers[ type ].context = context;
+}
+
+void
+vnet_detach( vnet_receive_fn receive, void *context )
+{
+  int i;
+
+  for( i = 0; i < VNET_PACKET_TYPES; i++ ) {
+    if( receivers[i].receive == receive && receivers[i].context == context ) {
+      receivers[i].receive = NULL;
+      receivers[i].context = NULL;
+    }
+  }
+}
+
+void
+vnet_packet_free( vnet_packet *packet )
+{
+  libspectrum_free( packet->data );
+  libspectrum_free( packet );
+}
+
+static vnet_packet*
+packet_copy( const vnet_packet *packet, size_t offset, size_t length )
+{
+  vnet_packet *copy = libspectrum_new( vnet_packet, 1 );
+
+  *copy = *packet;
+  copy->length = length;
+  copy->data = NULL;
+
+  if( length ) {
+    copy->data = libspectrum_new( libspectrum_byte, length );
+    memcpy( copy->data, packet->data + offset, length );
+  }
+
+  return copy;
+}
+
+static gint
+flight_compare( gconstpointer a, gconstpointer b )
+{
+  const vnet_flight *flight1 = a, *flight2 = b;
+
+  /* Equal times compare equal so packets stay in the order they were sent */
+  return flight1->tstates < flight2->tstates ? -1 :
+         flight1->tstates > flight2->tstates ?  1 : 0;
+}
+
+static void
+send_one( vnet_node destination, vnet_packet *packet )
+{
+  vnet_flight *flight = libspectrum_new( vnet_flight, 1 );
+  int latency = settings_current.virtual_network_latency;
+
+  flight->packet = packet;
+  flight->destination = destination;
+  flight->tstates = tstates + ( latency > 0 ? latency : 0 );
+
+  in_flight = g_slist_insert_sorted( in_flight, flight, flight_compare );
+
+  event_add( flight->tstates, vnet_event );
+}
+
+void
+vnet_send( vnet_node destination, const vnet_packet *packet )
+{
+  size_t offset, length;
+
+  if( packet->type != VNET_PACKET_TCP_DATA ) {
+    send_one( destination, packet_copy( packet, 0, packet->length ) );
+    return;
+  }
+
+  /* Split TCP data into segments which any receive buffer can hold */
+  for( offset = 0; offset < packet->length; offset += length ) {
+    length = packet->length - offset;
+    if( length > VNET_TCP_MSS ) length = VNET_TCP_MSS;
+    send_one( destination, packet_copy( packet, offset, length ) );
+  }
+}
+
+static void
+peer_queue_push( vnet_packet *packet )
+{
+  GSList *link = g_slist_append( NULL, packet );
+
+  if( peer_queue_last ) {
+    peer_queue_last->next = link;
+  } else {
+    peer_queue = link;
+  }
+  peer_queue_last = link;
+}
+
+vnet_packet*
+vnet_peer_receive( void )
+{
+  vnet_packet *packet;
+
+  if( !peer_queue ) return NULL;
+
+  packet = peer_queue->data;
+  peer_queue = g_slist_delete_link( peer_queue, peer_queue );
+  if( !peer_queue ) peer_queue_last = NULL;
+
+  return packet;
+}
+
+/* Do two packets go to the same place on the same interface? A W5100 has
+   a receive buffer per socket, so one full socket mustn't hold up the
+   others; Ethernet frames have no addresses, so all share one FIFO */
+static int
+same_destination( const vnet_packet *packet1, const vnet_packet *packet2 )
+{
+  return receivers[ packet1->type ].receive ==
+           receivers[ packet2->type ].receive &&
+         receivers[ packet1->type ].context ==
+           receivers[ packet2->type ].context &&
+         !memcmp( packet1->dst_ip, packet2->dst_ip, 4 ) &&
+         packet1->dst_port == packet2->dst_port;
+}
+
+/* Hand a packet to the machine; returns non-zero if it must wait */
+static int
+offer( const vnet_packet *packet, GSList *held )
+{
+  vnet_receive_fn receive = receivers[ packet->type ].receive;
+  void *context = receivers[ packet->type ].context;
+  GSList *ptr;
+
+  /* Nothing is listening; the packet is lost, as on a real network */
+  if( !receive ) return 0;
+
+  /* Don't let anything overtake a packet turned down for the same place */
+  for( ptr = held; ptr; ptr = ptr->next ) {
+    vnet_flight *flight = ptr->data;
+    if( same_destination( flight->packet, packet ) ) return 1;
+  }
+
+  return receive( packet, context );
+}
+
+void
+vnet_deliver( void )
+{
+  GSList *held = NULL;
+
+  /* Interfaces may call back in here while taking a packet */
+  if( delivering ) return;
+  delivering = 1;
+
+  while( in_flight ) {
+    vnet_flight *flight = in_flight->data;
+
+    if( flight->tstates > tstates ) break;
+
+    /* Unlink the packet first, as receivers may send more */
+    in_flight = g_slist_delete_link( in_flight, in_flight );
+
+    if( flight->destination == VNET_NODE_PEER ) {
+      peer_queue_push( flight->packet );
+    } else if( offer( flight->packet, held ) ) {
+      held = g_slist_prepend( held, flight );
+      continue;
+    } else {
+      vnet_packet_free( flight->packet );
+    }
+
+    libspectrum_free( flight );
+  }
+
+  /* Anything turned down goes back to the front, still in order; it has
+     arrived already, so it sorts before everything left */
+  if( held ) {
+    held = g_slist_reverse( held );
+    g_slist_last( held )->next = in_flight;
+    in_flight = held;
+  }
+
+  delivering = 0;
+}
+
+void
+vnet_frame( libspectrum_dword frame_length )
+{
+  GSList *ptr;
+
+  if( !in_flight ) return;
+
+  for( ptr = in_flight; ptr; ptr = ptr->next ) {
+    vnet_flight *flight = ptr->data;
+    flight->tstates = flight->tstates > frame_length ?
+                      flight->tstates - frame_length : 0;
+  }
+
+  /* Retry anything turned down during the last frame, and make sure the
+     rest still has an event to deliver it, as a reset clears them all */
+  vnet_deliver();
+  if( in_flight )
+    event_add( ( (vnet_flight*)in_flight->data )->tstates, vnet_event );
+}
+
+void
+vnet_reset( void )
+{
+  vnet_packet *packet;
+
+  while( in_flight ) {
+    vnet_flight *flight = in_flight->data;
+    vnet_packet_free( flight->packet );
+    libspectrum_free( flight );
+    in_flight = g_slist_delete_link( in_flight, in_flight );
+  }
+
+  while( ( packet = vnet_peer_receive() ) ) vnet_packet_free( packet );
+}
+
+static int unittest_busy, unittest_count;
+static libspectrum_word unittest_busy_port, unittest_port;
+static libspectrum_byte unittest_received[6];
+
+static int
+unittest_receive( const vnet_packet *packet, void *context GCC_UNUSED )
+{
+  if( unittest_busy && packet->dst_port == unittest_busy_port ) return 1;
+
+  if( unittest_count < 6 ) unittest_received[ unittest_count ] = packet->data[0];
+  unittest_count++;
+
+  return 0;
+}
+
+static void
+unittest_send( vnet_node destination, vnet_packet_type type,
+               libspectrum_byte *data, size_t length )
+{
+  vnet_packet packet;
+
+  memset( &packet, 0, sizeof( packet ) );
+  packet.type = type;
+  packet.dst_port = unittest_port;
+  packet.data = data;
+  packet.length = length;
+
+  vnet_send( destination, &packet );
+}
+
+int
+vnet_unittest( void )
+{
+  libspectrum_dword old_tstates = tstates;
+  int old_latency = settings_current.virtual_network_latency;
+  vnet_receive_fn old_receive = receivers[ VNET_PACKET_ETHERNET ].receive;
+  void *old_context = receivers[ VNET_PACKET_ETHERNET ].context;
+  libspectrum_byte data[ VNET_TCP_MSS * 2 + 1 ];
+  vnet_packet *packet;
+  int segments, r = 0;
+
+  vnet_reset();
+  memset( data, 0, sizeof( data ) );
+  vnet_attach( VNET_PACKET_ETHERNET, unittest_receive, NULL );
+  settings_current.virtual_network_latency = 100;
+  unittest_busy = unittest_count = 0;
+  unittest_busy_port = unittest_port = 0;
+
+  /* Packets arrive after exactly the latency, in the order they were sent */
+  tstates = 1000;
+  data[0] = 1; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  data[0] = 2; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  tstates = 1099; vnet_deliver();
+  if( unittest_count != 0 ) r++;
+  tstates = 1100; vnet_deliver();
+  if( unittest_count != 2 || unittest_received[0] != 1 ||
+      unittest_received[1] != 2 ) r++;
+
+  /* A packet turned down is offered again, and nothing overtakes it */
+  unittest_busy = 1;
+  data[0] = 3; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  tstates = 1200; vnet_deliver();
+  data[0] = 4; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  if( unittest_count != 2 ) r++;
+  unittest_busy = 0;
+  tstates = 1300; vnet_deliver();
+  if( unittest_count != 4 || unittest_received[2] != 3 ||
+      unittest_received[3] != 4 ) r++;
+
+  /* ...but packets for somewhere else still get through */
+  unittest_busy = 1; unittest_busy_port = 1;
+  unittest_port = 1;
+  data[0] = 5; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  unittest_port = 0;
+  data[0] = 6; unittest_send( VNET_NODE_MACHINE, VNET_PACKET_ETHERNET, data, 1 );
+  tstates = 1400; vnet_deliver();
+  if( unittest_count != 5 || unittest_received[4] != 6 ) r++;
+  unittest_busy = 0;
+  vnet_deliver();
+  if( unittest_count != 6 || unittest_received[5] != 5 ) r++;
+
+  /* Arrival times carry over into the next frame */
+  data[0] = 5; unittest_send( VNET_NODE_PEER, VNET_PACKET_ETHERNET, data, 1 );
+  tstates = 0; vnet_frame( 1450 );
+  tstates = 49; vnet_deliver();
+  if( vnet_peer_receive() ) r++;
+  tstates = 50; vnet_deliver();
+  packet = vnet_peer_receive();
+  if( !packet || packet->length != 1 || packet->data[0] != 5 ) r++;
+  if( packet ) vnet_packet_free( packet );
+
+  /* TCP data is split into segments */
+  unittest_send( VNET_NODE_PEER, VNET_PACKET_TCP_DATA, data, sizeof( data ) );
+  tstates = 150; vnet_deliver();
+  segments = 0;
+  while( ( packet = vnet_peer_receive() ) ) {
+    if( packet->length > VNET_TCP_MSS ) r++;
+    vnet_packet_free( packet );
+    segments++;
+  }
+  if( segments != 3 ) r++;
+
+  vnet_reset();
+  vnet_attach( VNET_PACKET_ETHERNET, old_receive, old_context );
+  settings_current.virtual_network_latency = old_latency;
+  tstates = old_tstates;
+
+  return r;
+}
@@ -0,0 +1,106 @@
+/* vnet.h: In-memory virtual network for the emulated network interfaces
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_VNET_H
+#define FUSE_VNET_H
+
+#include <stddef.h>
+
+#include "libspectrum.h"
+
+/* The largest TCP segment the network will carry; longer data is split */
+#define VNET_TCP_MSS 1460
+
+typedef enum vnet_packet_type {
+
+  VNET_PACKET_ETHERNET,		/* A raw Ethernet frame (SpeccyBoot) */
+
+  /* The W5100 does its own TCP/IP, so the Spectranet is connected at the
+     transport level */
+  VNET_PACKET_UDP,		/* A UDP datagram */
+  VNET_PACKET_TCP_CONNECT,	/* Open a TCP connection */
+  VNET_PACKET_TCP_DATA,		/* Data on an open TCP connection */
+  VNET_PACKET_TCP_CLOSE,	/* Close a connection, or refuse to open one */
+
+  VNET_PACKET_TYPES
+
+} vnet_packet_type;
+
+/* Where a packet is going */
+typedef enum vnet_node {
+
+  VNET_NODE_MACHINE,		/* The emulated machine's interfaces */
+  VNET_NODE_PEER,		/* Whatever is at the other end of the wire */
+
+} vnet_node;
+
+typedef struct vnet_packet {
+
+  vnet_packet_type type;
+
+  /* Unused for Ethernet frames. The IP addresses are in network order, as
+     the W5100 holds them; the ports are plain numbers */
+  libspectrum_byte src_ip[4];
+  libspectrum_word src_port;
+  libspectrum_byte dst_ip[4];
+  libspectrum_word dst_port;
+
+  size_t length;
+  libspectrum_byte *data;
+
+} vnet_packet;
+
+/* Offer a packet to one of the machine's interfaces. Return zero once the
+   packet has been dealt with (including by dropping it), or non-zero if the
+   interface can't take it yet and it should be offered again later */
+typedef int (*vnet_receive_fn)( const vnet_packet *packet, void *context );
+
+void vnet_register_startup( void );
+
+/* Have packets of `type' for the machine handed to `receive' */
+void vnet_attach( vnet_packet_type type, vnet_receive_fn receive,
+                  void *context );
+void vnet_detach( vnet_receive_fn receive, void *context );
+
+/* Send a copy of `packet' to `destination'; it arrives once the configured
+   latency has passed */
+void vnet_send( vnet_node destination, const vnet_packet *packet );
+
+/* Hand over everything which has arrived by now. Interfaces call this when
+   they have made room for packets they turned down earlier */
+void vnet_deliver( void );
+
+void vnet_frame( libspectrum_dword frame_length );
+
+/* Throw away everything in flight or waiting for the peer */
+void vnet_reset( void );
+
+/* The next packet which has arrived for the peer, or NULL. Free it with
+   vnet_packet_free() */
+vnet_packet* vnet_peer_receive( void );
+
+void vnet_packet_free( vnet_packet *packet );
+
+int vnet_unittest( void );
+
+#endif			/* #ifndef FUSE_VNET_H */
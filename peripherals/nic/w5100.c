@@ -26,7 +26,6 @@
 
 #include "config.h"
 
-#include <pthread.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -84,66 +83,9 @@ nic_w5100_reset( nic_w5100_t *self )
     nic_w5100_socket_reset( &self->socket[i] );
 }
 
-static void*
-w5100_io_thread( void *arg )
-{
-  nic_w5100_t *self = arg;
-  int i;
-
-  while( !self->stop_io_thread ) {
-    fd_set readfds, writefds;
-    int active;
-    compat_socket_t selfpipe_socket =
-      compat_socket_selfpipe_get_read_fd( self->selfpipe );
-    int max_fd = selfpipe_socket;
-
-    FD_ZERO( &readfds );
-    FD_ZERO( &writefds );
-
-    FD_SET( selfpipe_socket, &readfds );
-
-    for( i = 0; i < 4; i++ )
-      nic_w5100_socket_add_to_sets( &self->socket[i], &readfds, &writefds,
-        &max_fd );
-
-    /* Note that if a socket is closed between when we added it to the sets
-       above and when we call select() below, it will cause the select to fail
-       with EBADF. We catch this and just run around the loop again - the
-       offending socket will not be added to the sets again as it's now been
-       closed */
-
-    nic_w5100_debug( "w5100: io thread select\n" );
-
-    active = select( max_fd + 1, &readfds, &writefds, NULL, NULL );
-
-    nic_w5100_debug( "w5100: io thread wake; %d active\n", active );
-
-    if( active != -1 ) {
-      if( FD_ISSET( selfpipe_socket, &readfds ) ) {
-        nic_w5100_debug( "w5100: discarding selfpipe data\n" );
-        compat_socket_selfpipe_discard_data( self->selfpipe );
-      }
-
-      for( i = 0; i < 4; i++ )
-        nic_w5100_socket_process_io( &self->socket[i], readfds, writefds );
-    }
-    else if( compat_socket_get_error() == compat_socket_EBADF ) {
-      /* Do nothing - just loop again */
-    }
-    else {
-      nic_w5100_debug( "w5100: select returned unexpected errno %d: %s\n",
-                       compat_socket_get_error(),
-                       compat_socket_get_strerror() );
-    }
-  }
-
-  return NULL;
-}
-
 nic_w5100_t*
 nic_w5100_alloc( void )
 {
-  int error;
   int i;
   nic_w5100_t *self;
 
@@ -151,20 +93,17 @@ nic_w5100_alloc( void )
 
   self = libspectrum_new( nic_w5100_t, 1 );
 
-  self->selfpipe = compat_socket_selfpipe_alloc();
-
   for( i = 0; i < 4; i++ )
     nic_w5100_socket_init( &self->socket[i], i );
 
   nic_w5100_reset( self );
 
-  self->stop_io_thread = 0;
+  nic_w5100_io_register( self );
 
-  error = pthread_create( &self->thread, NULL, w5100_io_thread, self );
-  if( error ) {
-    ui_error( UI_ERROR_ERROR, "w5100: error %d creating thread", error );
-    fuse_abort();
-  }
+  vnet_attach( VNET_PACKET_UDP, nic_w5100_socket_vnet_receive, self );
+  vnet_attach( VNET_PACKET_TCP_CONNECT, nic_w5100_socket_vnet_receive, self );
+  vnet_attach( VNET_PACKET_TCP_DATA, nic_w5100_socket_vnet_receive, self );
+  vnet_attach( VNET_PACKET_TCP_CLOSE, nic_w5100_socket_vnet_receive, self );
 
   return self;
 }
@@ -175,22 +114,27 @@ nic_w5100_free( nic_w5100_t *self )
   int i;
 
   if( self ) {
-    self->stop_io_thread = 1;
-    compat_socket_selfpipe_wake( self->selfpipe );
-
-    pthread_join( self->thread, NULL );
+    vnet_detach( nic_w5100_socket_vnet_receive, self );
+    nic_w5100_io_unregister( self );
 
     for( i = 0; i < 4; i++ )
       nic_w5100_socket_end( &self->socket[i] );
 
-    compat_socket_selfpipe_free( self->selfpipe );
-
     compat_socket_networking_end();
 
     libspectrum_free( self );
   }
 }
 
+void
+nic_w5100_frame( nic_w5100_t *self )
+{
+  int i;
+
+  for( i = 0; i < 4; i++ )
+    nic_w5100_socket_frame( &self->socket[i] );
+}
+
 libspectrum_byte
 nic_w5100_read( nic_w5100_t *self, libspectrum_word reg )
 {
@@ -36,6 +36,12 @@ void nic_w5100_free( nic_w5100_t *self );
 
 void nic_w5100_reset( nic_w5100_t *self );
 
+/* Do any host socket I/O which has become possible since the last frame */
+void nic_w5100_frame( nic_w5100_t *self );
+
+/* Is the shared host I/O thread running? */
+int nic_w5100_io_active( void );
+
 libspectrum_byte nic_w5100_read( nic_w5100_t *self, libspectrum_word reg);
 void nic_w5100_write( nic_w5100_t *self, libspectrum_word reg, libspectrum_byte b );
 
@@ -33,6 +33,8 @@
 #include <sys/select.h>
 #endif
 
+#include "vnet.h"
+
 typedef enum w5100_socket_mode {
   W5100_SOCKET_MODE_CLOSED = 0x00,
   W5100_SOCKET_MODE_TCP,
@@ -123,12 +125,14 @@ typedef struct nic_w5100_socket_t {
   int datagram_lengths[0x20]; /* The lengths of datagrams to be sent */
   int datagram_count;
 
-  /* Flag used to indicate that a socket has been closed since we started
-     waiting for it in a select() call and therefore the socket should no
-     longer be used */
-  int ok_for_io;
+  int vnet;                 /* True if the socket is on the virtual network */
 
-  pthread_mutex_t lock;     /* Mutex for this socket */
+  /* Host I/O loop state. io_ready and io_armed are shared with the I/O
+     thread and are only changed atomically */
+  compat_socket_t io_fd;    /* The descriptor the I/O loop is watching */
+  int io_interest;          /* What we last asked the I/O loop to watch for */
+  int io_armed;             /* What the I/O loop may still report */
+  int io_ready;             /* What the I/O loop has reported */
 
 } nic_w5100_socket_t;
 
@@ -139,10 +143,6 @@ struct nic_w5100_t {
   libspectrum_byte sip[4];  /* Our IP address */
 
   nic_w5100_socket_t socket[4];
-
-  pthread_t thread;         /* Thread for doing I/O */
-  sig_atomic_t stop_io_thread; /* Flag to stop I/O thread */
-  compat_socket_selfpipe_t *selfpipe; /* Device for waking I/O thread */
 };
 
 void nic_w5100_socket_init( nic_w5100_socket_t *socket, int which );
@@ -156,10 +156,27 @@ void nic_w5100_socket_write( nic_w5100_t *self, libspectrum_word reg, libspectru
 libspectrum_byte nic_w5100_socket_read_rx_buffer( nic_w5100_t *self, libspectrum_word reg );
 void nic_w5100_socket_write_tx_buffer( nic_w5100_t *self, libspectrum_word reg, libspectrum_byte b );
 
-void nic_w5100_socket_add_to_sets( nic_w5100_socket_t *socket, fd_set *readfds,
-  fd_set *writefds, int *max_fd );
-void nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
-  fd_set writefds );
+void nic_w5100_socket_frame( nic_w5100_socket_t *socket );
+
+/* Take a packet from the virtual network */
+int nic_w5100_socket_vnet_receive( const vnet_packet *packet, void *context );
+
+/* The host I/O loop shared by all W5100s */
+
+#define W5100_IO_READ  ( 1 << 0 )
+#define W5100_IO_WRITE ( 1 << 1 )
+
+void nic_w5100_io_register( nic_w5100_t *self );
+void nic_w5100_io_unregister( nic_w5100_t *self );
+
+/* Ask for the I/O loop to report when the socket is ready for `interest' */
+void nic_w5100_io_watch( nic_w5100_socket_t *socket, int interest );
+
+/* Get and clear what the I/O loop has reported for the socket */
+int nic_w5100_io_ready( nic_w5100_socket_t *socket );
+
+/* Stop watching the socket; must be called before its fd is closed */
+void nic_w5100_io_forget( nic_w5100_socket_t *socket );
 
 /* Debug routines */
 
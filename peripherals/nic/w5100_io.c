@@ -0,0 +1,481 @@
+/* w5100_io.c: Wiznet W5100 emulation - host I/O loop
+
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* One thread serves every W5100 in the process. It does no I/O itself: it
+   just waits for host sockets to become readable or writable and sets
+   bits in the socket's io_ready word. The emulation thread picks those up
+   once a frame in nic_w5100_frame() and does the actual reads and writes,
+   so the socket state is only ever touched by the emulation thread and
+   needs no locking.
+
+   Each socket is armed for one wakeup at a time: once the I/O thread has
+   reported a socket, it won't report it again until the emulation thread
+   has dealt with it and re-armed it. On Linux, this is done with epoll and
+   EPOLLONESHOT; elsewhere, the thread select()s on every armed socket. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif			/* #ifdef HAVE_SYS_EPOLL_H */
+
+#include "fuse.h"
+#include "ui/ui.h"
+#include "w5100.h"
+#include "w5100_internals.h"
+
+/* How many events to take from epoll at once */
+#define W5100_IO_MAX_EVENTS 16
+
+static struct {
+
+  int users;			/* How many W5100s are using the loop */
+
+  pthread_t thread;
+  int stop;
+  compat_socket_selfpipe_t *selfpipe;
+
+  /* Held by the I/O thread while it is reporting events, and by anyone
+     changing which W5100s are registered */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  /* Incremented each time the I/O thread has finished reporting events */
+  unsigned long generation;
+
+#ifdef HAVE_SYS_EPOLL_H
+  int epoll_fd;
+#else			/* #ifdef HAVE_SYS_EPOLL_H */
+  GSList *nics;			/* The registered W5100s */
+#endif			/* #ifdef HAVE_SYS_EPOLL_H */
+
+} io;
+
+static void
+io_report( nic_w5100_socket_t *socket, int ready )
+{
+  /* The socket is now disarmed until the emulation thread has dealt with
+     it. If it was disarmed while we were waiting, don't report it at all */
+  ready &= __atomic_exchange_n( &socket->io_armed, 0, __ATOMIC_ACQ_REL );
+  if( ready ) __atomic_fetch_or( &socket->io_ready, ready, __ATOMIC_RELEASE );
+}
+
+static void
+io_finish_batch( void )
+{
+  io.generation++;
+  pthread_cond_broadcast( &io.cond );
+  pthread_mutex_unlock( &io.lock );
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+static void
+io_wait( void )
+{
+  struct epoll_event events[ W5100_IO_MAX_EVENTS ];
+  int i, active;
+
+  nic_w5100_debug( "w5100: io thread epoll_wait\n" );
+
+  active = epoll_wait( io.epoll_fd, events, W5100_IO_MAX_EVENTS, -1 );
+
+  nic_w5100_debug( "w5100: io thread wake; %d active\n", active );
+
+  pthread_mutex_lock( &io.lock );
+
+  for( i = 0; i < active; i++ ) {
+    nic_w5100_socket_t *socket = events[i].data.ptr;
+    int ready = 0;
+
+    if( !socket ) {
+      nic_w5100_debug( "w5100: discarding selfpipe data\n" );
+      compat_socket_selfpipe_discard_data( io.selfpipe );
+      continue;
+    }
+
+    /* Errors and hangups are found by the next read or write */
+    if( events[i].events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) )
+      ready |= W5100_IO_READ;
+    if( events[i].events & ( EPOLLOUT | EPOLLERR | EPOLLHUP ) )
+      ready |= W5100_IO_WRITE;
+
+    io_report( socket, ready );
+  }
+
+  io_finish_batch();
+}
+
+static int
+io_init( void )
+{
+  struct epoll_event event;
+
+  io.epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+  if( io.epoll_fd == -1 ) {
+    ui_error( UI_ERROR_ERROR, "w5100: error %d creating epoll instance",
+              errno );
+    return 1;
+  }
+
+  memset( &event, 0, sizeof( event ) );
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  if( epoll_ctl( io.epoll_fd, EPOLL_CTL_ADD,
+                 compat_socket_selfpipe_get_read_fd( io.selfpipe ),
+                 &event ) ) {
+    ui_error( UI_ERROR_ERROR, "w5100: error %d watching selfpipe", errno );
+    close( io.epoll_fd ); io.epoll_fd = -1;
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+io_end( void )
+{
+  close( io.epoll_fd );
+  io.epoll_fd = -1;
+}
+
+static void
+io_arm( nic_w5100_socket_t *socket, int interest )
+{
+  struct epoll_event event;
+  int op;
+
+  memset( &event, 0, sizeof( event ) );
+  event.data.ptr = socket;
+  event.events = EPOLLONESHOT;
+  if( interest & W5100_IO_READ ) event.events |= EPOLLIN;
+  if( interest & W5100_IO_WRITE ) event.events |= EPOLLOUT;
+
+  if( socket->io_fd != socket->fd ) {
+    /* This fails harmlessly if the old fd has already been closed */
+    if( socket->io_fd != compat_socket_invalid )
+      epoll_ctl( io.epoll_fd, EPOLL_CTL_DEL, socket->io_fd, &event );
+    op = EPOLL_CTL_ADD;
+  } else {
+    op = EPOLL_CTL_MOD;
+  }
+
+  /* Arm before telling epoll so the report can't be lost */
+  socket->io_interest = interest;
+  __atomic_store_n( &socket->io_armed, interest, __ATOMIC_RELEASE );
+
+  if( epoll_ctl( io.epoll_fd, op, socket->fd, &event ) ) {
+    nic_w5100_debug( "w5100: error %d watching socket %d\n", errno,
+                     socket->id );
+    socket->io_fd = compat_socket_invalid;
+    return;
+  }
+
+  socket->io_fd = socket->fd;
+}
+
+static void
+io_disarm( nic_w5100_socket_t *socket )
+{
+  struct epoll_event event;
+
+  if( socket->io_fd != compat_socket_invalid ) {
+    memset( &event, 0, sizeof( event ) );
+    epoll_ctl( io.epoll_fd, EPOLL_CTL_DEL, socket->io_fd, &event );
+  }
+
+  socket->io_fd = compat_socket_invalid;
+}
+
+static void
+io_add_nic( nic_w5100_t *self GCC_UNUSED )
+{
+}
+
+static void
+io_remove_nic( nic_w5100_t *self GCC_UNUSED )
+{
+}
+
+#else			/* #ifdef HAVE_SYS_EPOLL_H */
+
+static void
+io_wait( void )
+{
+  fd_set readfds, writefds;
+  compat_socket_t selfpipe_socket =
+    compat_socket_selfpipe_get_read_fd( io.selfpipe );
+  int max_fd = selfpipe_socket;
+  int active, i;
+  GSList *ptr;
+
+  FD_ZERO( &readfds );
+  FD_ZERO( &writefds );
+
+  FD_SET( selfpipe_socket, &readfds );
+
+  pthread_mutex_lock( &io.lock );
+
+  for( ptr = io.nics; ptr; ptr = ptr->next ) {
+    nic_w5100_t *self = ptr->data;
+    for( i = 0; i < 4; i++ ) {
+      nic_w5100_socket_t *socket = &self->socket[i];
+      int armed = __atomic_load_n( &socket->io_armed, __ATOMIC_ACQUIRE );
+
+      if( socket->io_fd == compat_socket_invalid || !armed ) continue;
+
+      if( armed & W5100_IO_READ ) FD_SET( socket->io_fd, &readfds );
+      if( armed & W5100_IO_WRITE ) FD_SET( socket->io_fd, &writefds );
+      if( socket->io_fd > max_fd ) max_fd = socket->io_fd;
+    }
+  }
+
+  pthread_mutex_unlock( &io.lock );
+
+  /* Note that if a socket is closed between when we added it to the sets
+     above and when we call select() below, it will cause the select to fail
+     with EBADF. We catch this and just run around the loop again - the
+     offending socket will not be added to the sets again as it's now been
+     closed */
+
+  nic_w5100_debug( "w5100: io thread select\n" );
+
+  active = select( max_fd + 1, &readfds, &writefds, NULL, NULL );
+
+  nic_w5100_debug( "w5100: io thread wake; %d active\n", active );
+
+  pthread_mutex_lock( &io.lock );
+
+  if( active != -1 ) {
+    if( FD_ISSET( selfpipe_socket, &readfds ) ) {
+      nic_w5100_debug( "w5100: discarding selfpipe data\n" );
+      compat_socket_selfpipe_discard_data( io.selfpipe );
+    }
+
+    /* A socket which has been closed and reopened since the select() may
+       be reported spuriously; that's harmless as the emulation thread's
+       reads and writes don't block */
+    for( ptr = io.nics; ptr; ptr = ptr->next ) {
+      nic_w5100_t *self = ptr->data;
+      for( i = 0; i < 4; i++ ) {
+        nic_w5100_socket_t *socket = &self->socket[i];
+        int ready = 0;
+
+        if( socket->io_fd == compat_socket_invalid ) continue;
+
+        if( FD_ISSET( socket->io_fd, &readfds ) ) ready |= W5100_IO_READ;
+        if( FD_ISSET( socket->io_fd, &writefds ) ) ready |= W5100_IO_WRITE;
+
+        if( ready ) io_report( socket, ready );
+      }
+    }
+  }
+  else if( compat_socket_get_error() == compat_socket_EBADF ) {
+    /* Do nothing - just loop again */
+  }
+  else {
+    nic_w5100_debug( "w5100: select returned unexpected errno %d: %s\n",
+                     compat_socket_get_error(),
+                     compat_socket_get_strerror() );
+  }
+
+  io_finish_batch();
+}
+
+static int
+io_init( void )
+{
+  return 0;
+}
+
+static void
+io_end( void )
+{
+}
+
+static void
+io_arm( nic_w5100_socket_t *socket, int interest )
+{
+  /* The I/O thread looks at io_fd while holding the lock */
+  pthread_mutex_lock( &io.lock );
+  socket->io_interest = interest;
+  socket->io_fd = socket->fd;
+  __atomic_store_n( &socket->io_armed, interest, __ATOMIC_RELEASE );
+  pthread_mutex_unlock( &io.lock );
+
+  compat_socket_selfpipe_wake( io.selfpipe );
+}
+
+static void
+io_disarm( nic_w5100_socket_t *socket )
+{
+  pthread_mutex_lock( &io.lock );
+  socket->io_fd = compat_socket_invalid;
+  pthread_mutex_unlock( &io.lock );
+
+  compat_socket_selfpipe_wake( io.selfpipe );
+}
+
+static void
+io_add_nic( nic_w5100_t *self )
+{
+  pthread_mutex_lock( &io.lock );
+  io.nics = g_slist_prepend( io.nics, self );
+  pthread_mutex_unlock( &io.lock );
+}
+
+static void
+io_remove_nic( nic_w5100_t *self )
+{
+  pthread_mutex_lock( &io.lock );
+  io.nics = g_slist_remove( io.nics, self );
+  pthread_mutex_unlock( &io.lock );
+}
+
+#endif			/* #ifdef HAVE_SYS_EPOLL_H */
+
+static void*
+w5100_io_thread( void *arg GCC_UNUSED )
+{
+  while( !__atomic_load_n( &io.stop, __ATOMIC_ACQUIRE ) ) io_wait();
+
+  return NULL;
+}
+
+/* Wait until the I/O thread has finished with any events it collected
+   before now */
+static void
+io_quiesce( void )
+{
+  unsigned long start;
+
+  pthread_mutex_lock( &io.lock );
+
+  /* The first batch may have been collected before we were called; the
+     second wasn't */
+  start = io.generation;
+  while( io.generation - start < 2 ) {
+    compat_socket_selfpipe_wake( io.selfpipe );
+    pthread_cond_wait( &io.cond, &io.lock );
+  }
+
+  pthread_mutex_unlock( &io.lock );
+}
+
+void
+nic_w5100_io_register( nic_w5100_t *self )
+{
+  int error;
+
+  if( !io.users++ ) {
+    io.selfpipe = compat_socket_selfpipe_alloc();
+    pthread_mutex_init( &io.lock, NULL );
+    pthread_cond_init( &io.cond, NULL );
+    io.generation = 0;
+
+    if( io_init() ) fuse_abort();
+
+    io.stop = 0;
+
+    error = pthread_create( &io.thread, NULL, w5100_io_thread, NULL );
+    if( error ) {
+      ui_error( UI_ERROR_ERROR, "w5100: error %d creating thread", error );
+      fuse_abort();
+    }
+  }
+
+  io_add_nic( self );
+}
+
+void
+nic_w5100_io_unregister( nic_w5100_t *self )
+{
+  int i;
+
+  for( i = 0; i < 4; i++ )
+    nic_w5100_io_forget( &self->socket[i] );
+
+  io_remove_nic( self );
+
+  if( --io.users ) {
+    io_quiesce();
+    return;
+  }
+
+  __atomic_store_n( &io.stop, 1, __ATOMIC_RELEASE );
+  compat_socket_selfpipe_wake( io.selfpipe );
+  pthread_join( io.thread, NULL );
+
+  io_end();
+  pthread_cond_destroy( &io.cond );
+  pthread_mutex_destroy( &io.lock );
+  compat_socket_selfpipe_free( io.selfpipe );
+  io.selfpipe = NULL;
+}
+
+int
+nic_w5100_io_active( void )
+{
+  return io.users > 0;
+}
+
+void
+nic_w5100_io_watch( nic_w5100_socket_t *socket, int interest )
+{
+  if( socket->fd == compat_socket_invalid ) return;
+
+  /* If there's a report waiting, nic_w5100_frame() will re-arm the socket
+     once it has dealt with it */
+  if( __atomic_load_n( &socket->io_ready, __ATOMIC_ACQUIRE ) ) return;
+
+  /* Nothing to do if we're already waiting for the right thing */
+  if( socket->fd == socket->io_fd && interest == socket->io_interest &&
+      ( !interest || __atomic_load_n( &socket->io_armed, __ATOMIC_ACQUIRE ) ) )
+    return;
+
+  io_arm( socket, interest );
+}
+
+int
+nic_w5100_io_ready( nic_w5100_socket_t *socket )
+{
+  return __atomic_exchange_n( &socket->io_ready, 0, __ATOMIC_ACQ_REL );
+}
+
+void
+nic_w5100_io_forget( nic_w5100_socket_t *socket )
+{
+  __atomic_store_n( &socket->io_armed, 0, __ATOMIC_RELEASE );
+
+  if( socket->io_fd != compat_socket_invalid ) io_disarm( socket );
+
+  socket->io_interest = 0;
+  __atomic_store_n( &socket->io_ready, 0, __ATOMIC_RELEASE );
+}
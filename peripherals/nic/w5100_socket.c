@@ -26,7 +26,6 @@
 
 #include "config.h"
 
-#include <pthread.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -41,6 +40,7 @@
 #endif
 
 #include "fuse.h"
+#include "settings.h"
 #include "ui/ui.h"
 #include "w5100.h"
 #include "w5100_internals.h"
@@ -61,8 +61,11 @@ w5100_socket_init_common( nic_w5100_socket_t *socket )
   socket->fd = compat_socket_invalid;
   socket->bind_count = 0;
   socket->socket_bound = 0;
-  socket->ok_for_io = 0;
   socket->write_pending = 0;
+  socket->io_fd = compat_socket_invalid;
+  socket->io_interest = 0;
+  socket->io_armed = 0;
+  socket->io_ready = 0;
 }
 
 void
@@ -70,36 +73,12 @@ nic_w5100_socket_init( nic_w5100_socket_t *socket, int which )
 {
   socket->id = which;
   w5100_socket_init_common( socket );
-  pthread_mutex_init( &socket->lock, NULL );
 }
 
 void
 nic_w5100_socket_end( nic_w5100_socket_t *socket )
 {
   nic_w5100_socket_reset( socket );
-  pthread_mutex_destroy( &socket->lock );
-}
-
-static void
-w5100_socket_acquire_lock( nic_w5100_socket_t *socket )
-{
-  int error = pthread_mutex_lock( &socket->lock );
-  if( error ) {
-    nic_w5100_error( UI_ERROR_ERROR,
-                     "%s:%d: error %d locking mutex for socket %d\n",
-                     __FILE__, __LINE__, error, socket->id );
-    fuse_abort();
-  }
-}
-
-static void
-w5100_socket_release_lock( nic_w5100_socket_t *socket )
-{
-  int error = pthread_mutex_unlock( &socket->lock );
-  if( error ) {
-    nic_w5100_debug( "%s:%d: error %d unlocking mutex for socket %d\n", __FILE__, __LINE__, error, socket->id );
-    fuse_abort();
-  }
 }
 
 static void
@@ -116,24 +95,95 @@ w5100_socket_clean( nic_w5100_socket_t *socket )
   socket->last_send = 0;
   socket->datagram_count = 0;
 
+  socket->vnet = 0;
+
   if( socket->fd != compat_socket_invalid ) {
+    nic_w5100_io_forget( socket );
     compat_socket_close( socket->fd );
     w5100_socket_init_common( socket );
   }
 }
 
+static void
+w5100_socket_nonblocking( nic_w5100_socket_t *socket )
+{
+  if( compat_socket_blocking_mode( socket->fd, 1 ) ) {
+    nic_w5100_error( UI_ERROR_ERROR,
+      "w5100: failed to set socket %d non-blocking; errno %d: %s\n",
+      socket->id, compat_socket_get_error(), compat_socket_get_strerror() );
+  }
+}
+
+/* What we need to hear about from the host socket */
+static int
+w5100_socket_interest( nic_w5100_socket_t *socket )
+{
+  int interest = 0;
+
+  /* We can process a UDP read if we're in a UDP state and there are at least
+     9 bytes free in our buffer (8 byte UDP header and 1 byte of actual
+     data). */
+  int udp_read = socket->state == W5100_SOCKET_STATE_UDP &&
+    0x800 - socket->rx_rsr >= 9;
+  /* We can process a TCP read if we're in the established state and have
+     any room in our buffer (no header necessary for TCP). */
+  int tcp_read = socket->state == W5100_SOCKET_STATE_ESTABLISHED &&
+    0x800 - socket->rx_rsr >= 1;
+
+  int tcp_listen = socket->state == W5100_SOCKET_STATE_LISTEN;
+
+  if( udp_read || tcp_read || tcp_listen ) interest |= W5100_IO_READ;
+  if( socket->write_pending ) interest |= W5100_IO_WRITE;
+
+  return interest;
+}
+
+static void
+w5100_socket_update_io( nic_w5100_socket_t *socket )
+{
+  nic_w5100_io_watch( socket, w5100_socket_interest( socket ) );
+}
+
+static libspectrum_word
+w5100_socket_port( const libspectrum_byte *port )
+{
+  return ( port[0] << 8 ) | port[1];
+}
+
+/* Send a packet from this socket to its destination on the virtual
+   network */
+static void
+w5100_socket_vnet_send( nic_w5100_t *self, nic_w5100_socket_t *socket,
+                        vnet_packet_type type, libspectrum_byte *data,
+                        size_t length )
+{
+  vnet_packet packet;
+  vnet_node destination;
+
+  memset( &packet, 0, sizeof( packet ) );
+  packet.type = type;
+  memcpy( packet.src_ip, self->sip, 4 );
+  packet.src_port = w5100_socket_port( socket->port );
+  memcpy( packet.dst_ip, socket->dip, 4 );
+  packet.dst_port = w5100_socket_port( socket->dport );
+  packet.data = data;
+  packet.length = length;
+
+  /* Anything sent to our own address comes straight back to us */
+  destination = memcmp( socket->dip, self->sip, 4 ) ? VNET_NODE_PEER :
+                                                      VNET_NODE_MACHINE;
+
+  vnet_send( destination, &packet );
+}
+
 void
 nic_w5100_socket_reset( nic_w5100_socket_t *socket )
 {
-  w5100_socket_acquire_lock( socket );
-
   socket->mode = W5100_SOCKET_MODE_CLOSED;
   socket->flags = 0;
   socket->state = W5100_SOCKET_STATE_CLOSED;
 
   w5100_socket_clean( socket );
-
-  w5100_socket_release_lock( socket );
 }
 
 static void
@@ -192,6 +242,14 @@ w5100_socket_open( nic_w5100_socket_t *socket_obj )
 
     w5100_socket_clean( socket_obj );
 
+    if( settings_current.virtual_network ) {
+      socket_obj->vnet = 1;
+      socket_obj->state = final_state;
+      nic_w5100_debug( "w5100: opened virtual %s socket %d\n", description,
+                       socket_obj->id );
+      return;
+    }
+
     socket_obj->fd = socket( AF_INET, type, protocol );
     if( socket_obj->fd == compat_socket_invalid ) {
       nic_w5100_error( UI_ERROR_ERROR,
@@ -212,6 +270,10 @@ w5100_socket_open( nic_w5100_socket_t *socket_obj )
     }
 #endif
 
+    /* TCP sockets are made non blocking once they're connected or
+       listening */
+    if( !tcp ) w5100_socket_nonblocking( socket_obj );
+
     socket_obj->state = final_state;
 
     nic_w5100_debug( "w5100: opened %s fd %d for socket %d\n", description, socket_obj->fd, socket_obj->id );
@@ -223,6 +285,11 @@ w5100_socket_bind_port( nic_w5100_t *self, nic_w5100_socket_t *socket )
 {
   struct sockaddr_in sa;
 
+  if( socket->vnet ) {
+    socket->socket_bound = 1;
+    return 0;
+  }
+
   memset( &sa, 0, sizeof(sa) );
   sa.sin_family = AF_INET;
   memcpy( &sa.sin_port, socket->port, 2 );
@@ -255,6 +322,12 @@ w5100_socket_listen( nic_w5100_t *self, nic_w5100_socket_t *socket )
       if( w5100_socket_bind_port( self, socket ) )
         return;
 
+    if( socket->vnet ) {
+      socket->state = W5100_SOCKET_STATE_LISTEN;
+      nic_w5100_debug( "w5100: listening on virtual socket %d\n", socket->id );
+      return;
+    }
+
     if( listen( socket->fd, 1 ) == -1 ) {
       nic_w5100_error( UI_ERROR_ERROR, 
                        "w5100: failed to listen on socket %d; errno %d: %s\n",
@@ -263,11 +336,11 @@ w5100_socket_listen( nic_w5100_t *self, nic_w5100_socket_t *socket )
       return;
     }
 
+    w5100_socket_nonblocking( socket );
+
     socket->state = W5100_SOCKET_STATE_LISTEN;
 
     nic_w5100_debug( "w5100: listening on socket %d\n", socket->id );
-
-    compat_socket_selfpipe_wake( self->selfpipe );
   }
 }
 
@@ -281,6 +354,21 @@ w5100_socket_connect( nic_w5100_t *self, nic_w5100_socket_t *socket )
       if( w5100_socket_bind_port( self, socket ) )
         return;
 
+    if( socket->vnet ) {
+      /* Replies need somewhere to come back to, so pick a port as the host
+         would if we weren't given one */
+      if( !w5100_socket_port( socket->port ) ) {
+        socket->port[0] = 0xc0;
+        socket->port[1] = socket->id;
+      }
+
+      w5100_socket_vnet_send( self, socket, VNET_PACKET_TCP_CONNECT, NULL, 0 );
+
+      socket->ir |= 1 << 0;
+      socket->state = W5100_SOCKET_STATE_ESTABLISHED;
+      return;
+    }
+
     memset( &sa, 0, sizeof(sa) );
     sa.sin_family = AF_INET;
     memcpy( &sa.sin_port, socket->dport, 2 );
@@ -297,6 +385,8 @@ w5100_socket_connect( nic_w5100_t *self, nic_w5100_socket_t *socket )
       return;
     }
 
+    w5100_socket_nonblocking( socket );
+
     socket->ir |= 1 << 0;
     socket->state = W5100_SOCKET_STATE_ESTABLISHED;
   }
@@ -307,9 +397,11 @@ w5100_socket_discon( nic_w5100_t *self, nic_w5100_socket_t *socket )
 {
   if( socket->state == W5100_SOCKET_STATE_ESTABLISHED ||
     socket->state == W5100_SOCKET_STATE_CLOSE_WAIT ) {
+    if( socket->vnet )
+      w5100_socket_vnet_send( self, socket, VNET_PACKET_TCP_CLOSE, NULL, 0 );
+
     socket->ir |= 1 << 1;
     socket->state = W5100_SOCKET_STATE_CLOSED;
-    compat_socket_selfpipe_wake( self->selfpipe );
 
     nic_w5100_debug( "w5100: disconnected socket %d\n", socket->id );
   }
@@ -318,17 +410,78 @@ w5100_socket_discon( nic_w5100_t *self, nic_w5100_socket_t *socket )
 static void
 w5100_socket_close( nic_w5100_t *self, nic_w5100_socket_t *socket )
 {
-  if( socket->fd != compat_socket_invalid ) {
+  if( socket->vnet ) {
+    if( socket->state == W5100_SOCKET_STATE_ESTABLISHED ||
+        socket->state == W5100_SOCKET_STATE_CLOSE_WAIT )
+      w5100_socket_vnet_send( self, socket, VNET_PACKET_TCP_CLOSE, NULL, 0 );
+
+    socket->vnet = 0;
+    socket->socket_bound = 0;
+    socket->state = W5100_SOCKET_STATE_CLOSED;
+    nic_w5100_debug( "w5100: closed virtual socket %d\n", socket->id );
+  }
+  else if( socket->fd != compat_socket_invalid ) {
+    nic_w5100_io_forget( socket );
     compat_socket_close( socket->fd );
     socket->fd = compat_socket_invalid;
     socket->socket_bound = 0;
-    socket->ok_for_io = 0;
     socket->state = W5100_SOCKET_STATE_CLOSED;
-    compat_socket_selfpipe_wake( self->selfpipe );
     nic_w5100_debug( "w5100: closed socket %d\n", socket->id );
   }
 }
 
+/* Copy `length' bytes from the transmit buffer, starting at TX_RR */
+static void
+w5100_socket_tx_copy( nic_w5100_socket_t *socket, libspectrum_byte *dest,
+                      int length )
+{
+  int offset = socket->tx_rr & 0x7ff;
+
+  if( offset + length <= 0x800 ) {
+    memcpy( dest, &socket->tx_buffer[ offset ], length );
+  }
+  else {
+    int first_chunk = 0x800 - offset;
+    memcpy( dest, &socket->tx_buffer[ offset ], first_chunk );
+    memcpy( dest + first_chunk, socket->tx_buffer, length - first_chunk );
+  }
+}
+
+/* The virtual network never pushes back, so everything is sent at once */
+static void
+w5100_socket_vnet_write( nic_w5100_t *self, nic_w5100_socket_t *socket )
+{
+  libspectrum_byte buffer[0x800];
+  int length;
+
+  if( socket->state == W5100_SOCKET_STATE_UDP ) {
+    while( socket->datagram_count ) {
+      length = (libspectrum_word)socket->datagram_lengths[0];
+      if( length > 0x800 ) length = 0x800;
+
+      w5100_socket_tx_copy( socket, buffer, length );
+      w5100_socket_vnet_send( self, socket, VNET_PACKET_UDP, buffer, length );
+      socket->tx_rr += length;
+
+      if( --socket->datagram_count )
+        memmove( socket->datagram_lengths, &socket->datagram_lengths[1],
+          0x1f * sizeof(int) );
+    }
+  }
+  else {
+    length = (libspectrum_word)( socket->tx_wr - socket->tx_rr );
+    if( length > 0x800 ) length = 0x800;
+
+    w5100_socket_tx_copy( socket, buffer, length );
+    w5100_socket_vnet_send( self, socket, VNET_PACKET_TCP_DATA, buffer,
+                            length );
+    socket->tx_rr += length;
+  }
+
+  socket->write_pending = 0;
+  socket->ir |= 1 << 4;
+}
+
 static void
 w5100_socket_send( nic_w5100_t *self, nic_w5100_socket_t *socket )
 {
@@ -342,12 +495,13 @@ w5100_socket_send( nic_w5100_t *self, nic_w5100_socket_t *socket )
       socket->tx_wr - socket->last_send;
     socket->last_send = socket->tx_wr;
     socket->write_pending = 1;
-    compat_socket_selfpipe_wake( self->selfpipe );
   }
   else if( socket->state == W5100_SOCKET_STATE_ESTABLISHED ) {
     socket->write_pending = 1;
-    compat_socket_selfpipe_wake( self->selfpipe );
   }
+
+  if( socket->write_pending && socket->vnet )
+    w5100_socket_vnet_write( self, socket );
 }
 
 static void
@@ -359,7 +513,9 @@ w5100_socket_recv( nic_w5100_t *self, nic_w5100_socket_t *socket )
     socket->old_rx_rd = socket->rx_rd;
     if( socket->rx_rsr != 0 )
       socket->ir |= 1 << 2;
-    compat_socket_selfpipe_wake( self->selfpipe );
+
+    /* There may be packets waiting for the space */
+    if( socket->vnet ) vnet_deliver();
   }
 }
 
@@ -407,7 +563,6 @@ w5100_write_socket_port( nic_w5100_t *self, nic_w5100_socket_t *socket, int whic
         socket->bind_count = 0;
         return;
       }
-      compat_socket_selfpipe_wake( self->selfpipe );
     }
     socket->bind_count = 0;
   }
@@ -422,8 +577,6 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
   libspectrum_word fsr;
   libspectrum_byte b;
 
-  w5100_socket_acquire_lock( socket );
-
   switch( socket_reg ) {
     case W5100_SOCKET_MR:
       b = socket->mode;
@@ -473,8 +626,6 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
       break;
   }
 
-  w5100_socket_release_lock( socket );
-
   return b;
 }
 
@@ -484,8 +635,6 @@ nic_w5100_socket_write( nic_w5100_t *self, libspectrum_word reg, libspectrum_byt
   nic_w5100_socket_t *socket = &self->socket[(reg >> 8) - 4];
   int socket_reg = reg & 0xff;
 
-  w5100_socket_acquire_lock( socket );
-
   switch( socket_reg ) {
     case W5100_SOCKET_MR:
       w5100_write_socket_mr( socket, b );
@@ -532,7 +681,8 @@ nic_w5100_socket_write( nic_w5100_t *self, libspectrum_word reg, libspectrum_byt
   if( socket_reg != W5100_SOCKET_PORT0 && socket_reg != W5100_SOCKET_PORT1 )
     socket->bind_count = 0;
 
-  w5100_socket_release_lock( socket );
+  /* Any command may have changed what we're waiting for on the host */
+  w5100_socket_update_io( socket );
 }
 
 libspectrum_byte
@@ -554,45 +704,6 @@ nic_w5100_socket_write_tx_buffer( nic_w5100_t *self, libspectrum_word reg, libsp
   socket->tx_buffer[offset] = b;
 }
 
-void
-nic_w5100_socket_add_to_sets( nic_w5100_socket_t *socket, fd_set *readfds,
-  fd_set *writefds, int *max_fd )
-{
-  w5100_socket_acquire_lock( socket );
-
-  if( socket->fd != compat_socket_invalid ) {
-    /* We can process a UDP read if we're in a UDP state and there are at least
-       9 bytes free in our buffer (8 byte UDP header and 1 byte of actual
-       data). */
-    int udp_read = socket->state == W5100_SOCKET_STATE_UDP &&
-      0x800 - socket->rx_rsr >= 9;
-    /* We can process a TCP read if we're in the established state and have
-       any room in our buffer (no header necessary for TCP). */
-    int tcp_read = socket->state == W5100_SOCKET_STATE_ESTABLISHED &&
-      0x800 - socket->rx_rsr >= 1;
-
-    int tcp_listen = socket->state == W5100_SOCKET_STATE_LISTEN;
-
-    socket->ok_for_io = 1;
-
-    if( udp_read || tcp_read || tcp_listen ) {
-      FD_SET( socket->fd, readfds );
-      if( socket->fd > *max_fd )
-        *max_fd = socket->fd;
-      nic_w5100_debug( "w5100: checking for read on socket %d with fd %d; max fd %d\n", socket->id, socket->fd, *max_fd );
-    }
-
-    if( socket->write_pending ) {
-      FD_SET( socket->fd, writefds );
-      if( socket->fd > *max_fd )
-        *max_fd = socket->fd;
-      nic_w5100_debug( "w5100: write pending on socket %d with fd %d; max fd %d\n", socket->id, socket->fd, *max_fd );
-    }
-  }
-
-  w5100_socket_release_lock( socket );
-}
-
 static void
 w5100_socket_process_accept( nic_w5100_socket_t *socket )
 {
@@ -612,13 +723,36 @@ w5100_socket_process_accept( nic_w5100_socket_t *socket )
 
   nic_w5100_debug( "w5100: accepted connection from %s:%d on socket %d\n", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port), socket->id );
 
+  nic_w5100_io_forget( socket );
   if( compat_socket_close( socket->fd ) == -1 )
     nic_w5100_debug( "w5100: error attempting to close fd %d for socket %d\n", socket->fd, socket->id );
 
   socket->fd = new_fd;
+  w5100_socket_nonblocking( socket );
   socket->state = W5100_SOCKET_STATE_ESTABLISHED;
 }
 
+/* Add `length' bytes to the end of the data in the receive buffer */
+static void
+w5100_socket_rx_append( nic_w5100_socket_t *socket,
+                        const libspectrum_byte *data, int length )
+{
+  int offset = (socket->old_rx_rd + socket->rx_rsr) & 0x7ff;
+  libspectrum_byte *dest = &socket->rx_buffer[offset];
+
+  if( offset + length <= 0x800 ) {
+    memcpy( dest, data, length );
+  }
+  else {
+    int first_chunk = 0x800 - offset;
+    memcpy( dest, data, first_chunk );
+    memcpy( socket->rx_buffer, data + first_chunk, length - first_chunk );
+  }
+
+  socket->rx_rsr += length;
+  socket->ir |= 1 << 2;
+}
+
 static void
 w5100_socket_process_read( nic_w5100_socket_t *socket )
 {
@@ -643,9 +777,6 @@ w5100_socket_process_read( nic_w5100_socket_t *socket )
   nic_w5100_debug( "w5100: read 0x%03x bytes from %s socket %d\n", (int)bytes_read, description, socket->id );
 
   if( bytes_read > 0 || (udp && bytes_read == 0) ) {
-    int offset = (socket->old_rx_rd + socket->rx_rsr) & 0x7ff;
-    libspectrum_byte *dest = &socket->rx_buffer[offset];
-
     if( udp ) {
       /* Add the W5100's UDP header */
       memcpy( buffer, &sa.sin_addr.s_addr, 4 );
@@ -655,17 +786,7 @@ w5100_socket_process_read( nic_w5100_socket_t *socket )
       bytes_read += 8;
     }
 
-    socket->rx_rsr += bytes_read;
-    socket->ir |= 1 << 2;
-
-    if( offset + bytes_read <= 0x800 ) {
-      memcpy( dest, buffer, bytes_read );
-    }
-    else {
-      int first_chunk = 0x800 - offset;
-      memcpy( dest, buffer, first_chunk );
-      memcpy( socket->rx_buffer, buffer + first_chunk, bytes_read - first_chunk );
-    }
+    w5100_socket_rx_append( socket, buffer, bytes_read );
   }
   else if( bytes_read == 0 ) {  /* TCP */
     socket->state = W5100_SOCKET_STATE_CLOSE_WAIT;
@@ -761,22 +882,21 @@ w5100_socket_process_tcp_write( nic_w5100_socket_t *socket )
 }
 
 void
-nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
-  fd_set writefds )
+nic_w5100_socket_frame( nic_w5100_socket_t *socket )
 {
-  w5100_socket_acquire_lock( socket );
+  int ready = nic_w5100_io_ready( socket );
 
-  /* Process only if we're an open socket, and we haven't been closed and
-     re-opened since the select() started */
-  if( socket->fd != compat_socket_invalid && socket->ok_for_io ) {
-    if( FD_ISSET( socket->fd, &readfds ) ) {
+  /* A socket which was closed and reopened since it was reported may be
+     reported spuriously; that's harmless as the host socket doesn't block */
+  if( socket->fd != compat_socket_invalid ) {
+    if( ready & W5100_IO_READ ) {
       if( socket->state == W5100_SOCKET_STATE_LISTEN )
         w5100_socket_process_accept( socket );
-      else
+      else if( w5100_socket_interest( socket ) & W5100_IO_READ )
         w5100_socket_process_read( socket );
     }
 
-    if( FD_ISSET( socket->fd, &writefds ) ) {
+    if( ( ready & W5100_IO_WRITE ) && socket->write_pending ) {
       if( socket->state == W5100_SOCKET_STATE_UDP ) {
         w5100_socket_process_udp_write( socket );
       }
@@ -786,5 +906,118 @@ nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
     }
   }
 
-  w5100_socket_release_lock( socket );
+  w5100_socket_update_io( socket );
+}
+
+/* Find the virtual socket in `state' which `packet' is for; for connected
+   sockets, it must also have come from the other end of the connection */
+static nic_w5100_socket_t*
+w5100_socket_vnet_find( nic_w5100_t *self, const vnet_packet *packet,
+                        w5100_socket_state state, int connected )
+{
+  int i;
+
+  for( i = 0; i < 4; i++ ) {
+    nic_w5100_socket_t *socket = &self->socket[i];
+
+    if( !socket->vnet || socket->state != state ||
+        w5100_socket_port( socket->port ) != packet->dst_port )
+      continue;
+
+    if( connected &&
+        ( memcmp( socket->dip, packet->src_ip, 4 ) ||
+          w5100_socket_port( socket->dport ) != packet->src_port ) )
+      continue;
+
+    return socket;
+  }
+
+  return NULL;
+}
+
+/* Turn down a connection nothing is listening for */
+static void
+w5100_socket_vnet_refuse( nic_w5100_t *self, const vnet_packet *packet )
+{
+  vnet_packet reply;
+
+  memset( &reply, 0, sizeof( reply ) );
+  reply.type = VNET_PACKET_TCP_CLOSE;
+  memcpy( reply.src_ip, packet->dst_ip, 4 );
+  reply.src_port = packet->dst_port;
+  memcpy( reply.dst_ip, packet->src_ip, 4 );
+  reply.dst_port = packet->src_port;
+
+  vnet_send( memcmp( packet->src_ip, self->sip, 4 ) ? VNET_NODE_PEER :
+                                                      VNET_NODE_MACHINE,
+             &reply );
+}
+
+int
+nic_w5100_socket_vnet_receive( const vnet_packet *packet, void *context )
+{
+  nic_w5100_t *self = context;
+  nic_w5100_socket_t *socket;
+  libspectrum_byte header[8];
+
+  switch( packet->type ) {
+
+  case VNET_PACKET_UDP:
+    socket = w5100_socket_vnet_find( self, packet, W5100_SOCKET_STATE_UDP,
+                                     0 );
+    /* Like a real network, drop datagrams there's no room for */
+    if( !socket || packet->length > 0x800 - 8 ||
+        0x800 - socket->rx_rsr < packet->length + 8 )
+      return 0;
+
+    /* The W5100's UDP header */
+    memcpy( header, packet->src_ip, 4 );
+    header[4] = packet->src_port >> 8;
+    header[5] = packet->src_port & 0xff;
+    header[6] = packet->length >> 8;
+    header[7] = packet->length & 0xff;
+
+    w5100_socket_rx_append( socket, header, 8 );
+    w5100_socket_rx_append( socket, packet->data, packet->length );
+    break;
+
+  case VNET_PACKET_TCP_CONNECT:
+    socket = w5100_socket_vnet_find( self, packet, W5100_SOCKET_STATE_LISTEN,
+                                     0 );
+    if( !socket ) {
+      w5100_socket_vnet_refuse( self, packet );
+      return 0;
+    }
+
+    memcpy( socket->dip, packet->src_ip, 4 );
+    socket->dport[0] = packet->src_port >> 8;
+    socket->dport[1] = packet->src_port & 0xff;
+    socket->ir |= 1 << 0;
+    socket->state = W5100_SOCKET_STATE_ESTABLISHED;
+
+    nic_w5100_debug( "w5100: accepted virtual connection on socket %d\n",
+                     socket->id );
+    break;
+
+  case VNET_PACKET_TCP_DATA:
+    socket = w5100_socket_vnet_find( self, packet,
+                                     W5100_SOCKET_STATE_ESTABLISHED, 1 );
+    if( !socket ) return 0;
+    if( 0x800 - socket->rx_rsr < packet->length ) return 1;
+
+    w5100_socket_rx_append( socket, packet->data, packet->length );
+    break;
+
+  case VNET_PACKET_TCP_CLOSE:
+    socket = w5100_socket_vnet_find( self, packet,
+                                     W5100_SOCKET_STATE_ESTABLISHED, 1 );
+    if( socket ) socket->state = W5100_SOCKET_STATE_CLOSE_WAIT;
+    break;
+
+  default:
+    break;
+
+  }
+
+  return 0;
 }
@@ -149,6 +149,10 @@ speccyboot_reset( int hard_reset GCC_UNUSED )
                              settings_default.rom_speccyboot, 0x2000 ) )
     return;
 
+  /* Creating the ENC28J60 is deferred until SpeccyBoot is actually used */
+  if( startup_manager_require( STARTUP_MANAGER_MODULE_SPECCYBOOT_NIC ) )
+    return;
+
   out_register_state = 0xff;  /* force transitions to low */
 
   speccyboot_register_write( 0, 0 );
@@ -222,8 +226,6 @@ speccyboot_init( void *context )
 {
   int i;
 
-  nic = nic_enc28j60_alloc();
-
   module_register( &speccyboot_module_info );
 
   speccyboot_memory_source = memory_source_register( "SpeccyBoot" );
@@ -238,10 +240,19 @@ speccyboot_init( void *context )
   return 0;
 }
 
+static int
+speccyboot_nic_init( void *context )
+{
+  nic = nic_enc28j60_alloc();
+
+  return 0;
+}
+
 static void
-speccyboot_end( void )
+speccyboot_nic_end( void )
 {
   nic_enc28j60_free( nic );
+  nic = NULL;
 }
 
 void
@@ -252,9 +263,20 @@ speccyboot_register_startup( void )
     STARTUP_MANAGER_MODULE_MEMORY,
     STARTUP_MANAGER_MODULE_SETUID,
   };
+  startup_manager_module nic_dependencies[] = {
+    STARTUP_MANAGER_MODULE_SPECCYBOOT,
+    STARTUP_MANAGER_MODULE_VNET,
+  };
+
   startup_manager_register( STARTUP_MANAGER_MODULE_SPECCYBOOT, dependencies,
                             ARRAY_SIZE( dependencies ), speccyboot_init, NULL,
-                            speccyboot_end );
+                            NULL );
+
+  startup_manager_register_lazy( STARTUP_MANAGER_MODULE_SPECCYBOOT_NIC,
+                                 nic_dependencies,
+                                 ARRAY_SIZE( nic_dependencies ),
+                                 speccyboot_nic_init, NULL,
+                                 speccyboot_nic_end );
 }
 
 int
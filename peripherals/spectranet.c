@@ -200,6 +200,10 @@ spectranet_memory_map( void )
 static void
 spectranet_activate( void )
 {
+  /* The W5100 starts its own I/O thread, so don't create it until the
+     Spectranet is actually used */
+  startup_manager_require( STARTUP_MANAGER_MODULE_SPECTRANET_NIC );
+
   if( !spectranet_memory_allocated ) {
 
     int i, j;
@@ -455,7 +459,6 @@ spectranet_init( void *context )
   periph_register_paging_events( event_type_string, &page_event,
 				 &unpage_event );
 
-  w5100 = nic_w5100_alloc();
   flash_rom = flash_am29f010_alloc();
 
   return 0;
@@ -464,10 +467,30 @@ spectranet_init( void *context )
 static void
 spectranet_end( void )
 {
-  nic_w5100_free( w5100 );
   flash_am29f010_free( flash_rom );
 }
 
+void
+spectranet_frame( void )
+{
+  if( w5100 ) nic_w5100_frame( w5100 );
+}
+
+static int
+spectranet_nic_init( void *context )
+{
+  w5100 = nic_w5100_alloc();
+
+  return 0;
+}
+
+static void
+spectranet_nic_end( void )
+{
+  nic_w5100_free( w5100 );
+  w5100 = NULL;
+}
+
 void
 spectranet_register_startup( void )
 {
@@ -476,9 +499,20 @@ spectranet_register_startup( void )
     STARTUP_MANAGER_MODULE_MEMORY,
     STARTUP_MANAGER_MODULE_SETUID,
   };
+  startup_manager_module nic_dependencies[] = {
+    STARTUP_MANAGER_MODULE_SPECTRANET,
+    STARTUP_MANAGER_MODULE_VNET,
+  };
+
   startup_manager_register( STARTUP_MANAGER_MODULE_SPECTRANET, dependencies,
                             ARRAY_SIZE( dependencies ), spectranet_init, NULL,
                             spectranet_end );
+
+  startup_manager_register_lazy( STARTUP_MANAGER_MODULE_SPECTRANET_NIC,
+                                 nic_dependencies,
+                                 ARRAY_SIZE( nic_dependencies ),
+                                 spectranet_nic_init, NULL,
+                                 spectranet_nic_end );
 }
 
 static libspectrum_word
@@ -546,6 +580,11 @@ spectranet_retn( void )
 {
 }
 
+void
+spectranet_frame( void )
+{
+}
+
 int
 spectranet_nmi_flipflop( void )
 {
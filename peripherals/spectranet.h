@@ -29,6 +29,7 @@ void spectranet_page( int via_io );
 void spectranet_nmi( void );
 void spectranet_unpage( void );
 void spectranet_retn( void );
+void spectranet_frame( void );
 
 int spectranet_nmi_flipflop( void );
 
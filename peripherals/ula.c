@@ -46,8 +46,10 @@
 
 static libspectrum_byte last_byte;
 
-libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
-libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
+/* These point at read-only tables shared between every reset of the
+   machine; see machine_reset() */
+const libspectrum_byte *ula_contention = ula_contention_none;
+const libspectrum_byte *ula_contention_no_mreq = ula_contention_none;
 
 /* What to return if no other input pressed; depends on the last byte
    output to the ULA; see CSS FAQ | Technical Information | Port #FE
@@ -260,7 +262,7 @@ void
 ula_contend_port_early( libspectrum_word port )
 {
   if( memory_map_read[ port >> MEMORY_PAGE_SIZE_LOGARITHM ].contended )
-    tstates += ula_contention_no_mreq[ tstates ];
+    tstates += ula_contention_delay( ula_contention_no_mreq, tstates );
    
   tstates++;
 }
@@ -270,14 +272,17 @@ ula_contend_port_late( libspectrum_word port )
 {
   if( machine_current->ram.port_from_ula( port ) ) {
 
-    tstates += ula_contention_no_mreq[ tstates ]; tstates += 2;
+    tstates += ula_contention_delay( ula_contention_no_mreq, tstates );
+    tstates += 2;
 
   } else {
 
     if( memory_map_read[ port >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) {
-      tstates += ula_contention_no_mreq[ tstates ]; tstates++;
-      tstates += ula_contention_no_mreq[ tstates ]; tstates++;
-      tstates += ula_contention_no_mreq[ tstates ];
+      tstates += ula_contention_delay( ula_contention_no_mreq, tstates );
+      tstates++;
+      tstates += ula_contention_delay( ula_contention_no_mreq, tstates );
+      tstates++;
+      tstates += ula_contention_delay( ula_contention_no_mreq, tstates );
     } else {
       tstates += 2;
     }
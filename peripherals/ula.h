@@ -24,13 +24,55 @@
 #ifndef FUSE_ULA_H
 #define FUSE_ULA_H
 
+#include "spectrum.h"
+
 #define ULA_CONTENTION_SIZE 80000
 
-/* How much contention do we get at every tstate when MREQ is active? */
-extern libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
+/* Packed tables hold the delays for two tstates in each byte, the earlier
+   one in the low nibble; that halves their size, at the cost of a shift
+   and a mask on every lookup */
+#ifdef USE_PACKED_CONTENTION
+#define ULA_CONTENTION_BYTES ( ULA_CONTENTION_SIZE / 2 )
+#define ULA_CONTENTION_INDEX( time ) ( ( time ) / 2 )
+#define ULA_CONTENTION_PAIR( first, second ) ( ( first ) | ( second ) << 4 )
+#define ula_contention_delay( table, time ) \
+  ( ( ( table )[ ( time ) >> 1 ] >> ( ( ( time ) & 1 ) << 2 ) ) & 0x0f )
+#else			/* #ifdef USE_PACKED_CONTENTION */
+#define ULA_CONTENTION_BYTES ULA_CONTENTION_SIZE
+#define ULA_CONTENTION_INDEX( time ) ( time )
+#define ULA_CONTENTION_PAIR( first, second ) first, second
+#define ula_contention_delay( table, time ) ( ( table )[ time ] )
+#endif			/* #ifdef USE_PACKED_CONTENTION */
+
+/* How much contention do we get at every tstate when MREQ is active?
+   ULA_CONTENTION_SIZE entries, zero after the end of the frame; read with
+   ula_contention_delay() */
+extern const libspectrum_byte *ula_contention;
 
 /* And how much when it is inactive */
-extern libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
+extern const libspectrum_byte *ula_contention_no_mreq;
+
+/* No contention at all */
+extern const libspectrum_byte ula_contention_none[ ULA_CONTENTION_BYTES ];
+
+/* Tables generated at build time by ula_contention.pl, for the timings in
+   ula_contention.dat. A machine can use them if its delay functions and
+   timings are the same as an entry's */
+typedef struct ula_contention_prebuilt {
+
+  spectrum_contention_delay_function contend_delay;
+  spectrum_contention_delay_function contend_delay_no_mreq;
+
+  libspectrum_dword line_time;		/* line_times[0] */
+  libspectrum_word tstates_per_line, left_border, horizontal_screen;
+  libspectrum_dword tstates_per_frame;
+
+  const libspectrum_byte *contention, *contention_no_mreq;
+
+} ula_contention_prebuilt;
+
+/* Ends with an entry with no delay functions */
+extern const ula_contention_prebuilt ula_contention_prebuilt_tables[];
 
 void ula_register_startup( void );
 
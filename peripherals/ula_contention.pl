@@ -0,0 +1,209 @@
+#!/usr/bin/perl -w
+
+# ula_contention.pl: generate the prebuilt contention tables
+# Copyright (c) 2026 Philip Kendall
+
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Author contact information:
+
+# E-mail: philip-fuse@shadowmagic.org.uk
+
+use strict;
+use integer;
+
+use Fuse;
+
+# From display.h
+my $border_height = 24;		# DISPLAY_BORDER_HEIGHT
+my $border_width = 16;		# DISPLAY_BORDER_WIDTH_COLS * 4 tstates
+my $display_height = 192;	# DISPLAY_HEIGHT
+
+# From spectrum.c: the delay at each tstate modulo 8, and how many tstates
+# before the screen the ULA starts fetching
+my %patterns = (
+    '65432100' => { delays => [ 5, 4, 3, 2, 1, 0, 0, 6 ], offset => 1 },
+    '76543210' => { delays => [ 5, 4, 3, 2, 1, 0, 7, 6 ], offset => 4 },
+);
+
+my @timings;
+
+while(<>) {
+
+    next if /^\s*$/;
+    next if /^\s*#/;
+
+    chomp;
+
+    my( $name, $top_left_pixel, $tstates_per_line, $left_border,
+	$horizontal_screen, $tstates_per_frame, $mreq, $no_mreq ) =
+	split /\s*,\s*/;
+
+    foreach my $pattern ( $mreq, $no_mreq ) {
+	die "Unknown contention pattern '$pattern'"
+	    unless $pattern eq 'none' or exists $patterns{$pattern};
+    }
+
+    push @timings, { name => $name, top_left_pixel => $top_left_pixel,
+		     tstates_per_line => $tstates_per_line,
+		     left_border => $left_border,
+		     horizontal_screen => $horizontal_screen,
+		     tstates_per_frame => $tstates_per_frame,
+		     mreq => $mreq, no_mreq => $no_mreq };
+}
+
+# What contend_delay_common() in spectrum.c gives at each tstate
+sub delays ($$$) {
+
+    my( $timing, $line_time, $pattern ) = @_;
+
+    my $tstates_per_line = $timing->{tstates_per_line};
+    my $left_border = $timing->{left_border};
+    my $offset = $patterns{$pattern}{offset};
+    my @delays;
+
+    foreach my $time ( 0 .. $timing->{tstates_per_frame} - 1 ) {
+
+	my $line = ( $time - $line_time ) / $tstates_per_line;
+	my $tstates_through_line =
+	    ( $time - $line_time + $left_border - $border_width ) %
+	    $tstates_per_line;
+
+	if( $line < $border_height ||
+	    $line >= $border_height + $display_height ||
+	    $tstates_through_line < $left_border - $offset ||
+	    $tstates_through_line >= $left_border +
+	                             $timing->{horizontal_screen} - $offset ) {
+	    push @delays, 0;
+	} else {
+	    push @delays,
+		$patterns{$pattern}{delays}[ $tstates_through_line % 8 ];
+	}
+    }
+
+    return @delays;
+}
+
+# Print a table, leaving out the runs of zeroes between the lines of the
+# screen. Entries go in pairs so that packed tables fill whole bytes, and
+# every line of the screen is the same, so each run is written out once as
+# a macro
+sub table ($@) {
+
+    my( $name, @delays ) = @_;
+
+    my( @runs, %macros, @macros );
+
+    my $time = 0;
+    while( $time < @delays ) {
+
+	if( !$delays[ $time ] ) { $time++; next; }
+
+	my $start = $time & ~1;
+	my $end = $start;
+	my @pairs;
+
+	# Carry on through the gaps in the contention pattern
+	while( $end < @delays && grep { $_ } @delays[ $end .. $end + 7 ] ) {
+	    push @pairs, sprintf "ULA_CONTENTION_PAIR( %d, %d )",
+		$delays[ $end ], $delays[ $end + 1 ] || 0;
+	    $end += 2;
+	}
+
+	my $run = join ', ', @pairs;
+	if( !exists $macros{$run} ) {
+	    $macros{$run} = uc( $name ) . '_' . scalar @macros;
+	    push @macros, $run;
+	}
+	push @runs, [ $start, $macros{$run} ];
+
+	$time = $end;
+    }
+
+    foreach my $run ( @macros ) {
+	my @pairs = split /, /, $run;
+	print "#define $macros{$run} \\\n";
+	while( @pairs ) {
+	    print "  ", join( ', ', splice( @pairs, 0, 4 ) ),
+		@pairs ? ", \\\n" : "\n";
+	}
+    }
+
+    print "\nstatic const libspectrum_byte $name\[ ULA_CONTENTION_BYTES \] = {\n";
+    foreach my $run ( @runs ) {
+	print "  [ ULA_CONTENTION_INDEX( $run->[0] ) ] = $run->[1],\n";
+    }
+    print "};\n\n";
+}
+
+print Fuse::GPL( 'ula_contention.c: Prebuilt contention tables',
+		 '2026 Philip Kendall' ), << "CODE";
+
+/* This file is autogenerated from ula_contention.dat by ula_contention.pl.
+   Do not edit unless you know what will happen! */
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include "libspectrum.h"
+
+#include "spectrum.h"
+#include "ula.h"
+
+const libspectrum_byte ula_contention_none[ ULA_CONTENTION_BYTES ];
+
+CODE
+
+my @entries;
+
+foreach my $timing ( @timings ) {
+
+    foreach my $late ( 0, 1 ) {
+
+	# As machine_set_variable_timings() works out line_times[0]
+	my $line_time = $timing->{top_left_pixel} -
+	    $border_height * $timing->{tstates_per_line} - $border_width +
+	    $late;
+
+	my %names;
+	foreach my $pattern ( $timing->{mreq}, $timing->{no_mreq} ) {
+
+	    next if exists $names{$pattern};
+
+	    if( $pattern eq 'none' ) {
+		$names{$pattern} = 'ula_contention_none';
+		next;
+	    }
+
+	    my $name = sprintf "contention_%s_%s_%s", $timing->{name},
+		$pattern, $late ? 'late' : 'early';
+	    table( $name, delays( $timing, $line_time, $pattern ) );
+	    $names{$pattern} = $name;
+	}
+
+	push @entries, sprintf
+	    "  { spectrum_contend_delay_%s, spectrum_contend_delay_%s,\n" .
+	    "    %d, %d, %d, %d, %d,\n" .
+	    "    %s, %s },\n",
+	    $timing->{mreq}, $timing->{no_mreq}, $line_time,
+	    $timing->{tstates_per_line}, $timing->{left_border},
+	    $timing->{horizontal_screen}, $timing->{tstates_per_frame},
+	    $names{ $timing->{mreq} }, $names{ $timing->{no_mreq} };
+    }
+}
+
+print "const ula_contention_prebuilt ula_contention_prebuilt_tables[] = {\n",
+    @entries, "  { NULL }\n};\n";
@@ -31,6 +31,7 @@
 #include "memory_pages.h"
 #include "pokemem.h"
 #include "spectrum.h"
+#include "statehash.h"
 #include "utils.h"
 
 enum {
@@ -411,6 +412,7 @@ pokemem_poke_activate( gpointer data, gpointer user_data )
     address &= 0x3fff;
     poke->restore = RAM[ bank ][ address ];
     RAM[ bank ][ address ] = value;
+    statehash_invalidate();
   }
 }
 
@@ -439,6 +441,7 @@ pokemem_poke_deactivate( gpointer data, gpointer user_data GCC_UNUSED )
     writebyte_internal( address, value );
   } else {
     RAM[ bank ][ address & 0x3fff ] = value;
+    statehash_invalidate();
   }
 
 }
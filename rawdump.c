@@ -0,0 +1,387 @@
+/* rawdump.c: streaming of raw frames and sound for external encoders
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* Unlike an FMF movie, a raw dump isn't compressed in any way: every frame
+   is written out in full as one byte per pixel, along with the sound
+   generated since the last frame, so something like ffmpeg can encode it
+   without Fuse having to do any more work than a copy.
+
+   Stream header:
+     Offset  Length  Contents
+          0       4  "FRAW"
+          4       1  Format version (1)
+          5       1  'e' or 'E': multi-byte values are little or big endian
+          6       1  Sound channels (0, 1 or 2)
+          7       1  Frame rate (1:#)
+          8       2  Width in pixels
+         10       2  Height in pixels
+         12       4  Sound frequency in Hz
+
+   Then, for every frame:
+          0       1  'F'
+          1       4  Frame number
+          5       4  Sound length in samples per channel
+          9       -  Width * height pixels, each a colour from 0 to 15
+          -       -  Sound as signed 16-bit samples, interleaved if stereo
+
+   On a Timex machine, the frame is 640 pixels wide but still 240 lines
+   high; each line needs to be doubled to get the correct aspect ratio.
+
+   When dumping to a ring file, the file starts with a 64 byte header
+   made up of the stream header, then 8 bytes giving the size of the ring
+   and 8 bytes giving the total number of bytes written to it so far; the
+   ring itself follows. The write count is only updated once a frame has
+   been written in full, so a reader which keeps up with it never sees a
+   partial frame. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+
+#include "libspectrum.h"
+
+#include "display.h"
+#include "machine.h"
+#include "rawdump.h"
+#include "settings.h"
+#include "sound.h"
+#include "ui/ui.h"
+
+#define RAWDUMP_HEADER_LENGTH 16
+#define RAWDUMP_FRAME_HEADER_LENGTH 9
+#define RAWDUMP_RING_HEADER_LENGTH 64
+
+typedef enum rawdump_output_type {
+  RAWDUMP_OUTPUT_FILE,
+  RAWDUMP_OUTPUT_PIPE,
+  RAWDUMP_OUTPUT_RING,
+} rawdump_output_type;
+
+int rawdump_recording = 0;
+
+static rawdump_output_type output_type;
+static FILE *output;
+
+/* The ring file's mapping, and how much has been written to it */
+static libspectrum_byte *ring;
+static libspectrum_qword ring_size;
+static libspectrum_qword ring_written;
+static volatile libspectrum_qword *ring_written_field;
+
+static int width, height, channels;
+
+/* The current frame, one byte per pixel */
+static libspectrum_byte *frame;
+static libspectrum_dword frame_number;
+
+/* The sound generated since the last frame */
+static libspectrum_signed_word *sound;
+static size_t sound_length, sound_allocated;
+
+static void
+put_header( libspectrum_byte *header )
+{
+  libspectrum_word w = width, h = height;
+  libspectrum_dword freq = channels ? settings_current.sound_freq : 0;
+
+  memcpy( header, "FRAW", 4 );
+  header[4] = 1;
+#ifdef WORDS_BIGENDIAN
+  header[5] = 'E';
+#else			/* #ifdef WORDS_BIGENDIAN */
+  header[5] = 'e';
+#endif			/* #ifdef WORDS_BIGENDIAN */
+  header[6] = channels;
+  header[7] = settings_current.frame_rate;
+  memcpy( &header[8], &w, 2 );
+  memcpy( &header[10], &h, 2 );
+  memcpy( &header[12], &freq, 4 );
+}
+
+static void
+ring_write( const libspectrum_byte *data, size_t length )
+{
+  size_t offset, chunk;
+
+  while( length ) {
+    offset = ring_written % ring_size;
+    chunk = ring_size - offset;
+    if( chunk > length ) chunk = length;
+
+    memcpy( &ring[ RAWDUMP_RING_HEADER_LENGTH + offset ], data, chunk );
+    ring_written += chunk; data += chunk; length -= chunk;
+  }
+}
+
+static int
+output_write( const void *data, size_t length )
+{
+  if( !length ) return 0;
+
+  if( output_type == RAWDUMP_OUTPUT_RING ) {
+    ring_write( data, length );
+    return 0;
+  }
+
+  if( fwrite( data, length, 1, output ) != 1 ) {
+    ui_error( UI_ERROR_ERROR, "error writing raw dump: %s",
+              strerror( errno ) );
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+open_ring( const char *filename, libspectrum_dword megabytes )
+{
+#ifdef HAVE_SYS_MMAN_H
+  libspectrum_qword size = (libspectrum_qword)megabytes << 20;
+  size_t mapping_size = RAWDUMP_RING_HEADER_LENGTH + size;
+  int fd;
+
+  fd = open( filename, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+  if( fd == -1 ) {
+    ui_error( UI_ERROR_ERROR, "error opening raw dump ring '%s': %s",
+              filename, strerror( errno ) );
+    return 1;
+  }
+
+  if( ftruncate( fd, mapping_size ) ) {
+    ui_error( UI_ERROR_ERROR, "error sizing raw dump ring '%s': %s",
+              filename, strerror( errno ) );
+    close( fd );
+    return 1;
+  }
+
+  ring = mmap( NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+               0 );
+  close( fd );
+  if( ring == MAP_FAILED ) {
+    ui_error( UI_ERROR_ERROR, "error mapping raw dump ring '%s': %s",
+              filename, strerror( errno ) );
+    ring = NULL;
+    return 1;
+  }
+
+  ring_size = size;
+  ring_written = 0;
+
+  put_header( ring );
+  memcpy( &ring[ RAWDUMP_HEADER_LENGTH ], &ring_size, 8 );
+  ring_written_field =
+    (volatile libspectrum_qword*)&ring[ RAWDUMP_HEADER_LENGTH + 8 ];
+  *ring_written_field = 0;
+
+  return 0;
+#else			/* #ifdef HAVE_SYS_MMAN_H */
+  ui_error( UI_ERROR_ERROR, "raw dump rings are not supported on this system" );
+  return 1;
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+}
+
+static void
+close_output( void )
+{
+  switch( output_type ) {
+
+  case RAWDUMP_OUTPUT_FILE:
+    fclose( output );
+    break;
+
+  case RAWDUMP_OUTPUT_PIPE:
+#ifdef HAVE_POPEN
+    pclose( output );
+#endif			/* #ifdef HAVE_POPEN */
+    break;
+
+  case RAWDUMP_OUTPUT_RING:
+#ifdef HAVE_SYS_MMAN_H
+    munmap( ring, RAWDUMP_RING_HEADER_LENGTH + ring_size );
+#endif			/* #ifdef HAVE_SYS_MMAN_H */
+    ring = NULL;
+    break;
+
+  }
+
+  output = NULL;
+}
+
+/* Copy one chunk of display_last_screen into the frame */
+static void
+copy_chunk( int column, int line )
+{
+  int chunk_width = machine_current->timex ? 16 : 8;
+
+  display_chunk_pixels( column, line,
+                        &frame[ line * width + column * chunk_width ] );
+}
+
+int
+rawdump_start( const char *target, libspectrum_dword ring_megabytes )
+{
+  libspectrum_byte header[ RAWDUMP_HEADER_LENGTH ];
+  int line, column;
+
+  if( rawdump_recording ) return 1;
+
+  width = machine_current->timex ? 2 * DISPLAY_ASPECT_WIDTH :
+                                   DISPLAY_ASPECT_WIDTH;
+  height = DISPLAY_SCREEN_HEIGHT;
+  channels = !sound_enabled ? 0 :
+             sound_stereo_ay != SOUND_STEREO_AY_NONE ? 2 : 1;
+
+  if( target[0] == '|' ) {
+#ifdef HAVE_POPEN
+    output_type = RAWDUMP_OUTPUT_PIPE;
+#ifdef SIGPIPE
+    /* Report the encoder going away rather than dying with it */
+    signal( SIGPIPE, SIG_IGN );
+#endif			/* #ifdef SIGPIPE */
+    output = popen( &target[1], "w" );
+    if( !output ) {
+      ui_error( UI_ERROR_ERROR, "error running '%s': %s", &target[1],
+                strerror( errno ) );
+      return 1;
+    }
+#else			/* #ifdef HAVE_POPEN */
+    ui_error( UI_ERROR_ERROR,
+              "raw dumps to a pipe are not supported on this system" );
+    return 1;
+#endif			/* #ifdef HAVE_POPEN */
+  } else if( ring_megabytes ) {
+    output_type = RAWDUMP_OUTPUT_RING;
+    if( open_ring( target, ring_megabytes ) ) return 1;
+  } else {
+    output_type = RAWDUMP_OUTPUT_FILE;
+    output = fopen( target, "wb" );
+    if( !output ) {
+      ui_error( UI_ERROR_ERROR, "error opening raw dump '%s': %s", target,
+                strerror( errno ) );
+      return 1;
+    }
+  }
+
+  if( output_type != RAWDUMP_OUTPUT_RING ) {
+    put_header( header );
+    if( output_write( header, RAWDUMP_HEADER_LENGTH ) ) {
+      close_output();
+      return 1;
+    }
+  }
+
+  frame = libspectrum_new( libspectrum_byte, width * height );
+  frame_number = 0;
+  sound_length = 0;
+
+  rawdump_recording = 1;
+
+  /* Start with the whole of the current screen */
+  for( line = 0; line < DISPLAY_SCREEN_HEIGHT; line++ )
+    for( column = 0; column < DISPLAY_SCREEN_WIDTH_COLS; column++ )
+      copy_chunk( column, line );
+
+  return 0;
+}
+
+void
+rawdump_stop( void )
+{
+  if( !rawdump_recording ) return;
+
+  rawdump_recording = 0;
+
+  close_output();
+
+  libspectrum_free( frame ); frame = NULL;
+  libspectrum_free( sound ); sound = NULL;
+  sound_allocated = 0;
+}
+
+void
+rawdump_add_sound( libspectrum_signed_word *buf, int len )
+{
+  if( !channels ) return;
+
+  if( sound_length + len > sound_allocated ) {
+    sound_allocated = sound_length + len;
+    sound = libspectrum_renew( libspectrum_signed_word, sound,
+                               sound_allocated );
+  }
+
+  memcpy( &sound[ sound_length ], buf, len * sizeof( *buf ) );
+  sound_length += len;
+}
+
+/* Bring the frame up to date with whatever display.c has redrawn, then
+   write it out along with the sound since the last one */
+void
+rawdump_frame( void )
+{
+  libspectrum_byte header[ RAWDUMP_FRAME_HEADER_LENGTH ];
+  libspectrum_dword samples = channels ? sound_length / channels : 0;
+  const libspectrum_qword *dirty = display_get_frame_dirty();
+  libspectrum_qword mask;
+  int line;
+
+  for( line = 0; line < DISPLAY_SCREEN_HEIGHT; line++ )
+    for( mask = dirty[ line ]; mask; mask &= mask - 1 )
+      copy_chunk( display_dirty_lowest( mask ), line );
+
+  header[0] = 'F';
+  memcpy( &header[1], &frame_number, 4 );
+  memcpy( &header[5], &samples, 4 );
+
+  if( output_write( header, RAWDUMP_FRAME_HEADER_LENGTH ) ||
+      output_write( frame, width * height ) ||
+      output_write( sound, sound_length * sizeof( *sound ) ) ) {
+    rawdump_stop();
+    return;
+  }
+
+  if( output_type == RAWDUMP_OUTPUT_RING ) {
+#ifdef __GNUC__
+    __sync_synchronize();
+#endif			/* #ifdef __GNUC__ */
+    *ring_written_field = ring_written;
+  }
+
+  frame_number++;
+  sound_length = 0;
+}
+
+void
+rawdump_init( void )
+{
+  if( settings_current.rawdump )
+    rawdump_start( settings_current.rawdump, settings_current.rawdump_ring );
+}
@@ -0,0 +1,44 @@
+/* rawdump.h: streaming of raw frames and sound for external encoders
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_RAWDUMP_H
+#define FUSE_RAWDUMP_H
+
+#include "libspectrum.h"
+
+extern int rawdump_recording;	/* Are we dumping raw frames? */
+
+void rawdump_init( void );
+
+/* Start dumping to `target': a file name, or `|command' to pipe the dump
+   into a command. If ring_size is non-zero, the file is instead a memory
+   mapped ring of that many megabytes */
+int rawdump_start( const char *target, libspectrum_dword ring_size );
+void rawdump_stop( void );
+
+void rawdump_add_sound( libspectrum_signed_word *buf, int len );
+
+/* Called once the UI has been updated, but before uidisplay_frame_end() */
+void rawdump_frame( void );
+
+#endif			/* #ifndef FUSE_RAWDUMP_H */
@@ -35,6 +35,7 @@
 #include "peripherals/scld.h"
 #include "screenshot.h"
 #include "settings.h"
+#include "statehash.h"
 #include "ui/scaler/scaler.h"
 #include "ui/ui.h"
 #include "utils.h"
@@ -657,6 +658,7 @@ screenshot_scr_read( const char *filename )
 
   utils_close_file( &screen );
 
+  statehash_invalidate();
   display_refresh_all();
 
   return error;
@@ -700,6 +702,7 @@ screenshot_mlt_read( const char *filename )
 
   utils_close_file( &screen );
 
+  statehash_invalidate();
   display_refresh_all();
 
   return error;
@@ -23,6 +23,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "libspectrum.h"
 
 #include "fuse.h"
@@ -176,3 +178,338 @@ snapshot_copy_to( libspectrum_snap *snap )
 
   return 0;
 }
+
+/* Delta snapshots.
+
+   Both the base and the current state are held as uncompressed SZX images,
+   so a change to any part of the machine, registers included, changes only
+   the bytes which hold it. The delta is a header, followed by each
+   MEMORY_PAGE_SIZE chunk of the current image which differs from the base,
+   XORed with the base and run-length encoded:
+
+   Offset  Length  Contents
+        0       4  "FDLT"
+        4       1  Format version (1)
+        5       8  FNV-1a hash of the base image (little endian)
+       13       4  Length of the current image (little endian)
+       17       -  Chunks, each:
+                      4  Chunk number (little endian)
+                      2  Length of the encoded data (little endian)
+                      -  Encoded data
+                   then a chunk number of 0xffffffff
+
+   In the encoded data, a byte n < 0x80 stands for n + 1 zero bytes, and a
+   byte n >= 0x80 is followed by n - 0x7f literal bytes. Any part of the
+   current image beyond the end of the base is XORed with zero. */
+
+static const libspectrum_byte delta_signature[] = { 'F', 'D', 'L', 'T', 1 };
+
+#define DELTA_HEADER_LENGTH 17
+#define DELTA_CHUNK_HEADER_LENGTH 6
+#define DELTA_CHUNK_END 0xffffffff
+#define DELTA_RUN_LENGTH 0x80
+
+/* Worst case is alternate bytes changed: each changed byte needs its own
+   literal run, and each unchanged one its own zero run, so every two bytes
+   take three */
+#define DELTA_ENCODED_MAX \
+  ( MEMORY_PAGE_SIZE + MEMORY_PAGE_SIZE / 2 + 1 )
+
+static void
+delta_put( libspectrum_byte *buffer, libspectrum_qword value, size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ ) { buffer[i] = value & 0xff; value >>= 8; }
+}
+
+static libspectrum_qword
+delta_get( const libspectrum_byte *buffer, size_t length )
+{
+  libspectrum_qword value = 0;
+
+  while( length-- ) value = ( value << 8 ) | buffer[length];
+
+  return value;
+}
+
+/* The byte of the base image which the current image is XORed with */
+static libspectrum_byte
+delta_base_byte( const libspectrum_byte *base, size_t base_length,
+                 size_t offset )
+{
+  return offset < base_length ? base[offset] : 0;
+}
+
+/* XOR one chunk against the base and encode it into `out'; returns the
+   encoded length, or 0 if the chunk is unchanged */
+static size_t
+delta_encode_chunk( libspectrum_byte *out, const libspectrum_byte *current,
+                    size_t start, size_t length,
+                    const libspectrum_byte *base, size_t base_length )
+{
+  size_t i = 0, out_length = 0, run;
+  int changed = 0;
+
+  while( i < length ) {
+
+    /* A run of unchanged bytes */
+    for( run = 0;
+         run < DELTA_RUN_LENGTH && i + run < length &&
+           current[ start + i + run ] ==
+             delta_base_byte( base, base_length, start + i + run );
+         run++ )
+      ;
+
+    if( run ) {
+      out[ out_length++ ] = run - 1;
+      i += run;
+      continue;
+    }
+
+    /* A run of changed bytes */
+    changed = 1;
+    for( run = 0;
+         run < DELTA_RUN_LENGTH && i + run < length &&
+           current[ start + i + run ] !=
+             delta_base_byte( base, base_length, start + i + run );
+         run++ )
+      ;
+
+    out[ out_length++ ] = 0x7f + run;
+    for( ; run; run--, i++ )
+      out[ out_length++ ] = current[ start + i ] ^
+                            delta_base_byte( base, base_length, start + i );
+  }
+
+  return changed ? out_length : 0;
+}
+
+static int
+delta_decode_chunk( libspectrum_byte *current, size_t start, size_t length,
+                    const libspectrum_byte *in, size_t in_length )
+{
+  size_t i = 0, j = 0, run;
+
+  while( j < in_length ) {
+
+    if( in[j] < DELTA_RUN_LENGTH ) {
+      run = in[j++] + 1;
+      if( i + run > length ) return 1;
+      i += run;
+      continue;
+    }
+
+    run = in[j++] - 0x7f;
+    if( i + run > length || j + run > in_length ) return 1;
+    for( ; run; run--, i++, j++ ) current[ start + i ] ^= in[j];
+  }
+
+  return 0;
+}
+
+/* The current state as an uncompressed SZX image, for use as the base for
+   snapshot_delta_write() and snapshot_delta_read() */
+int
+snapshot_write_base( libspectrum_byte **buffer, size_t *length )
+{
+  libspectrum_snap *snap;
+  int flags, error;
+
+  snap = libspectrum_snap_alloc();
+
+  error = snapshot_copy_to( snap );
+  if( error ) { libspectrum_snap_free( snap ); return error; }
+
+  flags = 0;
+  *length = 0;
+  *buffer = NULL;
+  error = libspectrum_snap_write( buffer, length, &flags, snap,
+                                  LIBSPECTRUM_ID_SNAPSHOT_SZX, fuse_creator,
+                                  LIBSPECTRUM_FLAG_SNAPSHOT_NO_COMPRESSION );
+
+  libspectrum_snap_free( snap );
+
+  return error;
+}
+
+/* Write the current state as a delta from `base', one chunk at a time */
+int
+snapshot_delta_write( snapshot_delta_write_fn write_fn, void *context,
+                      const libspectrum_byte *base, size_t base_length )
+{
+  libspectrum_byte header[ DELTA_HEADER_LENGTH ];
+  libspectrum_byte chunk[ DELTA_CHUNK_HEADER_LENGTH + DELTA_ENCODED_MAX ];
+  libspectrum_byte *current; size_t length, start, chunk_length, encoded;
+  libspectrum_dword i;
+  int error;
+
+  error = snapshot_write_base( &current, &length );
+  if( error ) return error;
+
+  memcpy( header, delta_signature, sizeof( delta_signature ) );
+  delta_put( &header[5], utils_hash( UTILS_HASH_INIT, base, base_length ),
+             8 );
+  delta_put( &header[13], length, 4 );
+
+  error = write_fn( header, DELTA_HEADER_LENGTH, context );
+
+  for( i = 0, start = 0; !error && start < length;
+       i++, start += MEMORY_PAGE_SIZE ) {
+
+    chunk_length = length - start;
+    if( chunk_length > MEMORY_PAGE_SIZE ) chunk_length = MEMORY_PAGE_SIZE;
+
+    encoded = delta_encode_chunk( &chunk[ DELTA_CHUNK_HEADER_LENGTH ],
+                                  current, start, chunk_length, base,
+                                  base_length );
+    if( !encoded ) continue;
+
+    delta_put( &chunk[0], i, 4 );
+    delta_put( &chunk[4], encoded, 2 );
+    error = write_fn( chunk, DELTA_CHUNK_HEADER_LENGTH + encoded, context );
+  }
+
+  if( !error ) {
+    delta_put( &chunk[0], DELTA_CHUNK_END, 4 );
+    error = write_fn( chunk, 4, context );
+  }
+
+  libspectrum_free( current );
+
+  return error;
+}
+
+/* Read a delta from `base', one chunk at a time, and restore the state it
+   describes */
+int
+snapshot_delta_read( snapshot_delta_read_fn read_fn, void *context,
+                     const libspectrum_byte *base, size_t base_length )
+{
+  libspectrum_byte header[ DELTA_HEADER_LENGTH ];
+  libspectrum_byte chunk[ DELTA_ENCODED_MAX ];
+  libspectrum_byte *current; size_t length, start, chunk_length, encoded;
+  libspectrum_dword i;
+  int error;
+
+  error = read_fn( header, DELTA_HEADER_LENGTH, context );
+  if( error ) return error;
+
+  if( memcmp( header, delta_signature, sizeof( delta_signature ) ) ) {
+    ui_error( UI_ERROR_ERROR, "Not a delta snapshot" );
+    return 1;
+  }
+
+  if( delta_get( &header[5], 8 ) !=
+      utils_hash( UTILS_HASH_INIT, base, base_length ) ) {
+    ui_error( UI_ERROR_ERROR, "Delta snapshot was made from a different base" );
+    return 1;
+  }
+
+  length = delta_get( &header[13], 4 );
+  current = libspectrum_new( libspectrum_byte, length );
+
+  if( length <= base_length ) {
+    memcpy( current, base, length );
+  } else {
+    memcpy( current, base, base_length );
+    memset( &current[ base_length ], 0, length - base_length );
+  }
+
+  while( 1 ) {
+
+    error = read_fn( chunk, 4, context );
+    if( error ) break;
+
+    i = delta_get( chunk, 4 );
+    if( i == DELTA_CHUNK_END ) break;
+
+    error = read_fn( chunk, 2, context );
+    if( error ) break;
+
+    encoded = delta_get( chunk, 2 );
+    start = (size_t)i * MEMORY_PAGE_SIZE;
+
+    if( start >= length || encoded > DELTA_ENCODED_MAX ) {
+      ui_error( UI_ERROR_ERROR, "Corrupt delta snapshot" );
+      error = 1;
+      break;
+    }
+
+    error = read_fn( chunk, encoded, context );
+    if( error ) break;
+
+    chunk_length = length - start;
+    if( chunk_length > MEMORY_PAGE_SIZE ) chunk_length = MEMORY_PAGE_SIZE;
+
+    error = delta_decode_chunk( current, start, chunk_length, chunk,
+                                encoded );
+    if( error ) {
+      ui_error( UI_ERROR_ERROR, "Corrupt delta snapshot" );
+      break;
+    }
+  }
+
+  if( !error )
+    error = snapshot_read_buffer( current, length,
+                                  LIBSPECTRUM_ID_SNAPSHOT_SZX );
+
+  libspectrum_free( current );
+
+  return error;
+}
+
+static int
+delta_unittest_round_trip( const libspectrum_byte *current,
+                           const libspectrum_byte *base, size_t base_length )
+{
+  libspectrum_byte encoded[ DELTA_ENCODED_MAX ];
+  libspectrum_byte decoded[ MEMORY_PAGE_SIZE ];
+  size_t encoded_length, i;
+
+  memset( encoded, 0, sizeof( encoded ) );
+  encoded_length = delta_encode_chunk( encoded, current, 0, MEMORY_PAGE_SIZE,
+                                       base, base_length );
+  if( encoded_length > DELTA_ENCODED_MAX ) return 1;
+
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ )
+    decoded[i] = delta_base_byte( base, base_length, i );
+
+  if( delta_decode_chunk( decoded, 0, MEMORY_PAGE_SIZE, encoded,
+                          encoded_length ) )
+    return 1;
+
+  return memcmp( decoded, current, MEMORY_PAGE_SIZE ) ? 1 : 0;
+}
+
+int
+snapshot_delta_unittest( void )
+{
+  libspectrum_byte base[ MEMORY_PAGE_SIZE ], current[ MEMORY_PAGE_SIZE ];
+  size_t i;
+  int r = 0;
+
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ ) base[i] = i * 7;
+
+  /* Nothing changed */
+  memcpy( current, base, MEMORY_PAGE_SIZE );
+  r += delta_unittest_round_trip( current, base, MEMORY_PAGE_SIZE );
+
+  /* Everything changed */
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ ) current[i] = ~base[i];
+  r += delta_unittest_round_trip( current, base, MEMORY_PAGE_SIZE );
+
+  /* Every other byte changed, starting with either; the worst case */
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ )
+    current[i] = i & 1 ? base[i] : ~base[i];
+  r += delta_unittest_round_trip( current, base, MEMORY_PAGE_SIZE );
+
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ )
+    current[i] = i & 1 ? ~base[i] : base[i];
+  r += delta_unittest_round_trip( current, base, MEMORY_PAGE_SIZE );
+
+  /* A chunk running past the end of the base */
+  r += delta_unittest_round_trip( current, base, MEMORY_PAGE_SIZE / 3 );
+
+  return r;
+}
@@ -37,4 +37,20 @@ int snapshot_copy_from( libspectrum_snap *snap );
 int snapshot_write( const char *filename );
 int snapshot_copy_to( libspectrum_snap *snap );
 
+/* Delta snapshots: the current state stored as the differences from a base
+   state written by snapshot_write_base() */
+
+typedef int (*snapshot_delta_write_fn)( const libspectrum_byte *data,
+                                        size_t length, void *context );
+typedef int (*snapshot_delta_read_fn)( libspectrum_byte *data, size_t length,
+                                       void *context );
+
+int snapshot_write_base( libspectrum_byte **buffer, size_t *length );
+int snapshot_delta_write( snapshot_delta_write_fn write_fn, void *context,
+                          const libspectrum_byte *base, size_t base_length );
+int snapshot_delta_read( snapshot_delta_read_fn read_fn, void *context,
+                         const libspectrum_byte *base, size_t base_length );
+
+int snapshot_delta_unittest( void );
+
 #endif
@@ -33,6 +33,7 @@
 #include "machine.h"
 #include "movie.h"
 #include "options.h"
+#include "rawdump.h"
 #include "settings.h"
 #include "sound.h"
 #include "tape.h"
@@ -718,6 +719,8 @@ sound_frame( void )
 
   if( movie_recording )
       movie_add_sound( samples, count );
+  if( rawdump_recording )
+    rawdump_add_sound( samples, count );
   ay_change_count = 0;
 }
 
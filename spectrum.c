@@ -31,11 +31,15 @@
 #include "event.h"
 #include "keyboard.h"
 #include "infrastructure/startup_manager.h"
+#include "inputlog.h"
+#include "inputseq.h"
 #include "loader.h"
 #include "machine.h"
 #include "memory_pages.h"
 #include "module.h"
+#include "peripherals/nic/vnet.h"
 #include "peripherals/printer.h"
+#include "peripherals/spectranet.h"
 #include "peripherals/ula.h"
 #include "phantom_typist.h"
 #include "psg.h"
@@ -100,11 +104,13 @@ spectrum_frame_event_fn( libspectrum_dword last_tstates, int type,
   timer_estimate_speed();
   debugger_add_time_events();
   ui_event();
+  inputseq_frame();
+  inputlog_frame();
   ui_error_frame();
 }
 
-static libspectrum_dword
-get_frame_count( void )
+libspectrum_dword
+spectrum_frame_count( void )
 {
   return frames_since_reset;
 }
@@ -118,7 +124,7 @@ spectrum_init( void *context )
   module_register( &module_info );
 
   debugger_system_variable_register( debugger_type_string,
-      frame_count_name, get_frame_count, NULL );
+      frame_count_name, spectrum_frame_count, NULL );
 
   return 0;
 }
@@ -160,6 +166,8 @@ spectrum_frame( void )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE ) debugger_track_frame(frame_length);
   
   printer_frame();
+  vnet_frame( frame_length );
+  spectranet_frame();
 
   /* Add an interrupt unless they're being generated by .rzx playback */
   if( !rzx_playback )
@@ -82,4 +82,7 @@ extern int spectrum_frame_event;
 void spectrum_register_startup( void );
 int spectrum_frame( void );
 
+/* The number of frames since the machine was last reset */
+libspectrum_dword spectrum_frame_count( void );
+
 #endif			/* #ifndef FUSE_SPECTRUM_H */
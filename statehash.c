@@ -0,0 +1,248 @@
+/* statehash.c: hashing of the emulated machine state
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* The RAM hash is kept up to date incrementally: each byte of RAM
+   contributes a value depending on its address and contents, and these are
+   XORed together. A write changes just one of these values, so the RAM
+   hash costs nothing to read no matter how much RAM the machine has. Zero
+   bytes contribute zero, so only non-zero bytes need to be looked at when
+   it's calculated from scratch.
+
+   Anything which changes RAM behind writebyte_internal()'s back must call
+   statehash_invalidate(), after which the hash will be recalculated the
+   next time it's needed. */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "event.h"
+#include "infrastructure/startup_manager.h"
+#include "machine.h"
+#include "module.h"
+#include "peripherals/ula.h"
+#include "spectrum.h"
+#include "statehash.h"
+#include "utils.h"
+#include "z80/z80.h"
+
+int statehash_active = 0;
+
+static libspectrum_qword ram_hash;
+static int ram_hash_valid = 0;
+
+static void statehash_reset( int hard_reset );
+static void statehash_from_snapshot( libspectrum_snap *snap );
+
+static module_info_t statehash_module_info = {
+
+  /* .reset = */ statehash_reset,
+  /* .romcs = */ NULL,
+  /* .snapshot_enabled = */ NULL,
+  /* .snapshot_from = */ statehash_from_snapshot,
+  /* .snapshot_to = */ NULL,
+
+};
+
+static int
+statehash_init( void *context )
+{
+  module_register( &statehash_module_info );
+
+  return 0;
+}
+
+void
+statehash_register_startup( void )
+{
+  startup_manager_module dependencies[] = {
+    STARTUP_MANAGER_MODULE_MEMORY,
+  };
+  startup_manager_register( STARTUP_MANAGER_MODULE_STATEHASH, dependencies,
+                            ARRAY_SIZE( dependencies ), statehash_init, NULL,
+                            NULL );
+}
+
+static void
+statehash_reset( int hard_reset GCC_UNUSED )
+{
+  statehash_invalidate();
+}
+
+static void
+statehash_from_snapshot( libspectrum_snap *snap GCC_UNUSED )
+{
+  statehash_invalidate();
+}
+
+/* The SplitMix64 finaliser */
+static libspectrum_qword
+mix( libspectrum_qword x )
+{
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+  return x ^ ( x >> 31 );
+}
+
+static libspectrum_qword
+byte_hash( size_t index, libspectrum_byte b )
+{
+  return b ? mix( ( (libspectrum_qword)index << 8 ) | b ) : 0;
+}
+
+static void
+calculate_ram_hash( void )
+{
+  size_t i, j;
+
+  ram_hash = 0;
+
+  for( i = 0; i < SPECTRUM_RAM_PAGES; i++ )
+    for( j = 0; j < 0x4000; j++ )
+      if( RAM[i][j] ) ram_hash ^= byte_hash( i * 0x4000 + j, RAM[i][j] );
+
+  ram_hash_valid = 1;
+}
+
+void
+statehash_ram_write( const memory_page *mapping, libspectrum_word offset,
+                     libspectrum_byte old, libspectrum_byte b )
+{
+  size_t index;
+
+  if( !ram_hash_valid ) return;
+
+  index = mapping->page_num * 0x4000 + mapping->offset + offset;
+  ram_hash ^= byte_hash( index, old ) ^ byte_hash( index, b );
+}
+
+void
+statehash_invalidate( void )
+{
+  ram_hash_valid = 0;
+}
+
+libspectrum_qword
+statehash_ram( void )
+{
+  statehash_active = 1;
+  if( !ram_hash_valid ) calculate_ram_hash();
+
+  return ram_hash;
+}
+
+static void
+put_value( libspectrum_byte *buffer, libspectrum_dword value, size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ ) { buffer[i] = value & 0xff; value >>= 8; }
+}
+
+static void
+hash_event( gpointer data, gpointer user_data )
+{
+  event_t *event = data;
+  libspectrum_qword *hash = user_data;
+  libspectrum_byte buffer[8];
+
+  put_value( buffer, event->tstates, 4 );
+  put_value( &buffer[4], event->type, 4 );
+
+  *hash = utils_hash( *hash, buffer, 8 );
+}
+
+libspectrum_qword
+statehash_full( void )
+{
+  libspectrum_byte state[ 40 + AY_REGISTERS ], *ptr = state;
+  libspectrum_qword hash;
+
+  put_value( ptr, z80.af.w, 2 ); ptr += 2;
+  put_value( ptr, z80.bc.w, 2 ); ptr += 2;
+  put_value( ptr, z80.de.w, 2 ); ptr += 2;
+  put_value( ptr, z80.hl.w, 2 ); ptr += 2;
+  put_value( ptr, z80.af_.w, 2 ); ptr += 2;
+  put_value( ptr, z80.bc_.w, 2 ); ptr += 2;
+  put_value( ptr, z80.de_.w, 2 ); ptr += 2;
+  put_value( ptr, z80.hl_.w, 2 ); ptr += 2;
+  put_value( ptr, z80.ix.w, 2 ); ptr += 2;
+  put_value( ptr, z80.iy.w, 2 ); ptr += 2;
+  put_value( ptr, z80.sp.w, 2 ); ptr += 2;
+  put_value( ptr, z80.pc.w, 2 ); ptr += 2;
+  put_value( ptr, z80.memptr.w, 2 ); ptr += 2;
+  *ptr++ = z80.i;
+  *ptr++ = ( z80.r7 & 0x80 ) | ( z80.r & 0x7f );
+  *ptr++ = z80.iff1;
+  *ptr++ = z80.iff2;
+  *ptr++ = z80.im;
+  *ptr++ = z80.halted;
+  *ptr++ = z80.q;
+  put_value( ptr, tstates, 4 ); ptr += 4;
+
+  *ptr++ = machine_current->ram.last_byte;
+  *ptr++ = machine_current->ram.last_byte2;
+  *ptr++ = ula_last_byte();
+
+  *ptr++ = machine_current->ay.current_register;
+  memcpy( ptr, machine_current->ay.registers, AY_REGISTERS );
+  ptr += AY_REGISTERS;
+
+  hash = utils_hash( UTILS_HASH_INIT ^ statehash_ram(), state, ptr - state );
+
+  event_foreach( hash_event, &hash );
+
+  return hash;
+}
+
+int
+statehash_unittest( void )
+{
+  int active = statehash_active;
+  libspectrum_byte old;
+  libspectrum_qword before, after;
+  int r = 0;
+
+  statehash_invalidate();
+  before = statehash_ram();
+
+  old = readbyte_internal( 0x8000 );
+  writebyte_internal( 0x8000, old ^ 0x55 );
+  after = statehash_ram();
+  if( after == before ) r++;
+
+  /* The incremental hash must match one calculated from scratch */
+  statehash_invalidate();
+  if( statehash_ram() != after ) r++;
+
+  writebyte_internal( 0x8000, old );
+  if( statehash_ram() != before ) r++;
+
+  /* With the hash inactive, writes from here on won't keep it up to date */
+  statehash_active = active;
+  statehash_invalidate();
+
+  return r;
+}
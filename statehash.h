@@ -0,0 +1,53 @@
+/* statehash.h: hashing of the emulated machine state
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_STATEHASH_H
+#define FUSE_STATEHASH_H
+
+#include "libspectrum.h"
+
+#include "memory_pages.h"
+
+/* Is the RAM hash being kept up to date by writebyte_internal()? This is
+   turned on the first time a hash is asked for */
+extern int statehash_active;
+
+void statehash_register_startup( void );
+
+/* A hash of the whole machine state: RAM, the Z80, paging, the AY and
+   pending events */
+libspectrum_qword statehash_full( void );
+
+/* A hash of just the contents of RAM, independent of the frame timing */
+libspectrum_qword statehash_ram( void );
+
+/* Called by writebyte_internal() before a byte of RAM is changed */
+void statehash_ram_write( const memory_page *mapping, libspectrum_word offset,
+                          libspectrum_byte old, libspectrum_byte b );
+
+/* Something has changed RAM without going through writebyte_internal() */
+void statehash_invalidate( void );
+
+int statehash_unittest( void );
+
+#endif			/* #ifndef FUSE_STATEHASH_H */
@@ -455,6 +455,58 @@ tape_load_trap( void )
   return 0;
 }
 
+static int
+flash_load_block_type( libspectrum_tape_type type )
+{
+  return type == LIBSPECTRUM_TAPE_BLOCK_ROM ||
+         type == LIBSPECTRUM_TAPE_BLOCK_TURBO;
+}
+
+/* Load the current tape block straight into memory on behalf of a
+   ROM-compatible loader in RAM which is still waiting for the pilot
+   tone; returns 0 if the block was loaded, with registers set as the
+   loader would leave them on its final RET, or non-zero if the block
+   should be loaded normally */
+int
+tape_flash_load( void )
+{
+  libspectrum_tape_block *block, *next_block;
+  int error;
+
+  if( !tape_playing || rzx_playback || rzx_recording ) return 2;
+
+  if( libspectrum_tape_state( tape ) != LIBSPECTRUM_TAPE_STATE_PILOT )
+    return 1;
+
+  block = libspectrum_tape_current_block( tape );
+  if( !flash_load_block_type( libspectrum_tape_block_type( block ) ) )
+    return 1;
+
+  /* As with the ROM trap, partial loads aren't handled */
+  if( libspectrum_tape_block_data_length( block ) != DE + 2 ) return 1;
+
+  /* Work out where the tape goes next before touching the registers or
+     memory, as once the block is loaded we must report success */
+  next_block = libspectrum_tape_peek_next_block( tape );
+  if( !next_block ) return 1;
+
+  error = trap_load_block( block );
+  if( error ) return error;
+
+  /* Move straight on to the next block if another loader could pick it
+     up, otherwise leave the pause at the end of this block to play out */
+  if( !flash_load_block_type( libspectrum_tape_block_type( next_block ) ) ||
+      !libspectrum_tape_select_next_block( tape ) )
+    libspectrum_tape_set_state( tape, LIBSPECTRUM_TAPE_STATE_PAUSE );
+
+  ui_tape_browser_update( UI_TAPE_BROWSER_SELECT_BLOCK, NULL );
+
+  event_remove_type( tape_edge_event );
+  tape_next_edge( tstates, 0 );
+
+  return 0;
+}
+
 static int
 trap_load_block( libspectrum_tape_block *block )
 {
@@ -45,6 +45,7 @@ int tape_write( const char *filename );
 int tape_can_autoload( void );
 
 int tape_load_trap( void );
+int tape_flash_load( void );
 int tape_save_trap( void );
 
 int tape_do_play( int autoplay );
@@ -27,10 +27,17 @@
 
 #include "config.h"
 
+#include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "libspectrum.h"
 
+#include "compat.h"
+#include "fuse.h"
 #include "scaler.h"
 #include "scaler_internals.h"
 #include "settings.h"
@@ -126,6 +133,25 @@ static const struct scaler_info available_scalers[] = {
     scaler_HQ4x_16,       scaler_HQ4x_32,       expand_1            },
 };
 
+struct scaler_simd_info {
+
+  scaler_type scaler;
+  ScalerProc *scaler16, *scaler32;
+
+};
+
+/* The scalers which also have versions using the row primitives in
+   scaler_simd.c */
+static const struct scaler_simd_info simd_scalers[] = {
+
+  { SCALER_PALTV2X, scaler_PalTV2x_simd_16, scaler_PalTV2x_simd_32 },
+  { SCALER_PALTV3X, scaler_PalTV3x_simd_16, scaler_PalTV3x_simd_32 },
+  { SCALER_PALTV4X, scaler_PalTV4x_simd_16, scaler_PalTV4x_simd_32 },
+  { SCALER_HQ2X,    scaler_HQ2x_simd_16,    scaler_HQ2x_simd_32    },
+  { SCALER_HQ3X,    scaler_HQ3x_simd_16,    scaler_HQ3x_simd_32    },
+  { SCALER_HQ4X,    scaler_HQ4x_simd_16,    scaler_HQ4x_simd_32    },
+};
+
 scaler_type current_scaler = SCALER_NUM;
 ScalerProc *scaler_proc16, *scaler_proc32;
 scaler_flags_t scaler_flags;
@@ -195,16 +221,45 @@ scaler_name( scaler_type scaler )
   return available_scalers[scaler].name;
 }
 
+/* The SIMD level the CPU supports, or -1 if we haven't looked yet */
+static int simd_level = -1;
+
+void
+scaler_init( void )
+{
+  simd_level = scaler_simd_init();
+}
+
+/* Find the SIMD versions of a scaler, if it has any and the CPU can run
+   them */
+static const struct scaler_simd_info*
+get_simd( scaler_type scaler )
+{
+  size_t i;
+
+  if( simd_level == -1 ) scaler_init();
+  if( simd_level == SCALER_SIMD_NONE ) return NULL;
+
+  for( i = 0; i < ARRAY_SIZE( simd_scalers ); i++ )
+    if( simd_scalers[i].scaler == scaler ) return &simd_scalers[i];
+
+  return NULL;
+}
+
 ScalerProc*
 scaler_get_proc16( scaler_type scaler )
 {
-  return available_scalers[scaler].scaler16;
+  const struct scaler_simd_info *simd = get_simd( scaler );
+
+  return simd ? simd->scaler16 : available_scalers[scaler].scaler16;
 }
 
 ScalerProc*
 scaler_get_proc32( scaler_type scaler )
 {
-  return available_scalers[scaler].scaler32;
+  const struct scaler_simd_info *simd = get_simd( scaler );
+
+  return simd ? simd->scaler32 : available_scalers[scaler].scaler32;
 }
 
 scaler_flags_t
@@ -225,6 +280,199 @@ scaler_get_expander( scaler_type scaler )
   return available_scalers[scaler].expander;
 }
 
+/* Large areas are scaled in horizontal bands, one on the calling thread and
+   one on each of up to `scaler_threads' persistent worker threads. Every
+   scaler reads the source lines either side of each line it scales, but
+   those lines are part of the source image whichever band they fall in,
+   so the bands can be scaled independently and the result is exactly the
+   same as one call over the whole area. */
+
+#define SCALER_MAX_THREADS 8
+
+/* Areas which scale to fewer pixels than this are done on the calling
+   thread, as waking the workers would cost more than it saves */
+#define SCALER_BAND_MIN_PIXELS ( 320 * 240 )
+
+#ifdef HAVE_PTHREAD
+
+typedef struct scaler_band {
+
+  ScalerProc *proc;
+  const libspectrum_byte *src;
+  libspectrum_dword src_pitch;
+  libspectrum_byte *dst;
+  libspectrum_dword dst_pitch;
+  int width, height;
+
+} scaler_band;
+
+static pthread_t workers[ SCALER_MAX_THREADS ];
+static int worker_count;
+
+static scaler_band bands[ SCALER_MAX_THREADS + 1 ];
+
+static pthread_mutex_t pool_lock;
+static pthread_cond_t work_cond;	/* New bands are ready */
+static pthread_cond_t done_cond;	/* All the workers' bands are done */
+static unsigned int generation;		/* Incremented for each area */
+static int pending;			/* Workers still to finish this area */
+static int stop_workers;
+
+static void
+band_run( const scaler_band *band )
+{
+  if( band->height > 0 )
+    band->proc( band->src, band->src_pitch, band->dst, band->dst_pitch,
+                band->width, band->height );
+}
+
+static void*
+worker_thread( void *arg )
+{
+  scaler_band *band = arg;
+  unsigned int seen = 0;
+
+  pthread_mutex_lock( &pool_lock );
+
+  while( 1 ) {
+    while( generation == seen && !stop_workers )
+      pthread_cond_wait( &work_cond, &pool_lock );
+    if( stop_workers ) break;
+    seen = generation;
+
+    pthread_mutex_unlock( &pool_lock );
+    band_run( band );
+    pthread_mutex_lock( &pool_lock );
+
+    if( --pending == 0 ) pthread_cond_signal( &done_cond );
+  }
+
+  pthread_mutex_unlock( &pool_lock );
+
+  return NULL;
+}
+
+static void
+workers_start( int count )
+{
+  int error;
+
+  pthread_mutex_init( &pool_lock, NULL );
+  pthread_cond_init( &work_cond, NULL );
+  pthread_cond_init( &done_cond, NULL );
+  generation = 0;
+  pending = stop_workers = 0;
+
+  if( count > SCALER_MAX_THREADS ) count = SCALER_MAX_THREADS;
+
+  for( worker_count = 0; worker_count < count; worker_count++ ) {
+    error = pthread_create( &workers[ worker_count ], NULL, worker_thread,
+                            &bands[ worker_count + 1 ] );
+    if( error ) {
+      ui_error( UI_ERROR_WARNING, "scaler: error %d creating worker thread",
+                error );
+      break;
+    }
+  }
+}
+
+static void
+workers_stop( void )
+{
+  int i;
+
+  pthread_mutex_lock( &pool_lock );
+  stop_workers = 1;
+  pthread_cond_broadcast( &work_cond );
+  pthread_mutex_unlock( &pool_lock );
+
+  for( i = 0; i < worker_count; i++ )
+    pthread_join( workers[i], NULL );
+  worker_count = 0;
+
+  pthread_cond_destroy( &done_cond );
+  pthread_cond_destroy( &work_cond );
+  pthread_mutex_destroy( &pool_lock );
+}
+
+/* The number of threads asked for when the pool was last started */
+static int pool_size;
+
+static void
+pool_resize( void )
+{
+  int wanted = settings_current.scaler_threads;
+
+  if( wanted > SCALER_MAX_THREADS ) wanted = SCALER_MAX_THREADS;
+  if( wanted < 0 ) wanted = 0;
+  if( wanted == pool_size ) return;
+
+  if( pool_size ) workers_stop();
+  pool_size = wanted;
+  if( pool_size ) workers_start( pool_size );
+}
+
+#endif				/* #ifdef HAVE_PTHREAD */
+
+void
+scaler_run( ScalerProc *proc, const libspectrum_byte *srcPtr,
+            libspectrum_dword srcPitch, libspectrum_byte *dstPtr,
+            libspectrum_dword dstPitch, int width, int height )
+{
+#ifdef HAVE_PTHREAD
+  float factor = scaler_get_scaling_factor( current_scaler );
+  int i, count, start, end;
+
+  pool_resize();
+
+  count = worker_count + 1;
+
+  /* Band boundaries are kept to even lines, so that every band starts on
+     a whole output line for the 0.5x and 1.5x scalers too */
+  if( worker_count == 0 || height < 2 * count ||
+      width * height * factor * factor < SCALER_BAND_MIN_PIXELS ) {
+    proc( srcPtr, srcPitch, dstPtr, dstPitch, width, height );
+    return;
+  }
+
+  for( i = 0, start = 0; i < count; i++, start = end ) {
+    end = ( ( height * ( i + 1 ) / count ) + 1 ) & ~1;
+    if( end > height || i == count - 1 ) end = height;
+
+    bands[i].proc = proc;
+    bands[i].src = srcPtr + start * srcPitch;
+    bands[i].src_pitch = srcPitch;
+    bands[i].dst = dstPtr + (int)( start * factor ) * dstPitch;
+    bands[i].dst_pitch = dstPitch;
+    bands[i].width = width;
+    bands[i].height = end - start;
+  }
+
+  pthread_mutex_lock( &pool_lock );
+  generation++;
+  pending = worker_count;
+  pthread_cond_broadcast( &work_cond );
+  pthread_mutex_unlock( &pool_lock );
+
+  band_run( &bands[0] );
+
+  pthread_mutex_lock( &pool_lock );
+  while( pending ) pthread_cond_wait( &done_cond, &pool_lock );
+  pthread_mutex_unlock( &pool_lock );
+#else				/* #ifdef HAVE_PTHREAD */
+  proc( srcPtr, srcPitch, dstPtr, dstPitch, width, height );
+#endif				/* #ifdef HAVE_PTHREAD */
+}
+
+void
+scaler_end( void )
+{
+#ifdef HAVE_PTHREAD
+  if( pool_size ) workers_stop();
+  pool_size = 0;
+#endif				/* #ifdef HAVE_PTHREAD */
+}
+
 /* The expansion functions */
 
 /* Clip after expansion */
@@ -282,3 +530,167 @@ expand_dotmatrix( int *x GCC_UNUSED, int *y GCC_UNUSED, int *w GCC_UNUSED,
   (*y)-=y_mod;
   (*h)+=y_mod;
 }
+
+/* Check the SIMD scalers give exactly the same output as the plain ones at
+   each SIMD level the CPU supports, in all three pixel formats and with
+   and without the PAL TV scanlines */
+
+#define TEST_WIDTH 37		/* Not a multiple of 4 or 8, to test the ends */
+#define TEST_HEIGHT 5
+#define TEST_PIXELS ( ( TEST_WIDTH + 2 ) * ( TEST_HEIGHT + 2 ) )
+#define TEST_OUTPUT ( TEST_WIDTH * TEST_HEIGHT * 4 * 4 )
+
+static libspectrum_dword
+test_random( void )
+{
+  static libspectrum_dword seed = 1;
+
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+/* Fill the source image from a small palette, with some colours close
+   enough together to exercise both sides of the HQnx thresholds */
+static void
+test_fill( libspectrum_byte *src, size_t pixel_size, libspectrum_dword mask,
+           libspectrum_dword close )
+{
+  libspectrum_dword palette[8];
+  size_t i;
+
+  for( i = 0; i < ARRAY_SIZE( palette ); i++ )
+    palette[i] = ( i && test_random() % 2 ) ?
+                 palette[ i - 1 ] ^ ( test_random() & close ) :
+                 test_random() & mask;
+
+  for( i = 0; i < TEST_PIXELS; i++ ) {
+    libspectrum_dword pixel = palette[ test_random() % ARRAY_SIZE( palette ) ];
+    if( pixel_size == 2 ) {
+      ((libspectrum_word*)src)[i] = pixel;
+    } else {
+      ((libspectrum_dword*)src)[i] = pixel;
+    }
+  }
+}
+
+static int
+test_scaler( const struct scaler_simd_info *simd, int format )
+{
+  libspectrum_dword src[ TEST_PIXELS ];
+  libspectrum_dword plain[ TEST_OUTPUT ], simd_output[ TEST_OUTPUT ];
+  size_t pixel_size = format ? 2 : 4;
+  libspectrum_dword src_pitch = ( TEST_WIDTH + 2 ) * pixel_size,
+                    dst_pitch = TEST_WIDTH * 4 * pixel_size;
+  const libspectrum_byte *origin =
+    (libspectrum_byte*)src + src_pitch + pixel_size;
+  ScalerProc *plain_proc, *simd_proc;
+
+  if( format ) {
+    scaler_select_bitformat( format );
+    plain_proc = available_scalers[ simd->scaler ].scaler16;
+    simd_proc = simd->scaler16;
+    test_fill( (libspectrum_byte*)src, pixel_size, 0xffff, 0x18e3 );
+  } else {
+    plain_proc = available_scalers[ simd->scaler ].scaler32;
+    simd_proc = simd->scaler32;
+    test_fill( (libspectrum_byte*)src, pixel_size, 0xffffff, 0x0f0f0f );
+  }
+
+  memset( plain, 0, sizeof( plain ) );
+  memset( simd_output, 0, sizeof( simd_output ) );
+
+  plain_proc( origin, src_pitch, (libspectrum_byte*)plain, dst_pitch,
+              TEST_WIDTH, TEST_HEIGHT );
+  simd_proc( origin, src_pitch, (libspectrum_byte*)simd_output, dst_pitch,
+             TEST_WIDTH, TEST_HEIGHT );
+
+  if( memcmp( plain, simd_output, sizeof( plain ) ) ) {
+    printf( "%s: SIMD %s differs from the plain version (format %d)\n",
+            fuse_progname, available_scalers[ simd->scaler ].name,
+            format ? format : 32 );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+scaler_simd_unittest( void )
+{
+  static const int formats[] = { 555, 565, 0 };
+  int pal_tv2x = settings_current.pal_tv2x;
+  int level, scanlines, repeat, r = 0;
+  size_t i, j;
+
+  for( level = SCALER_SIMD_NONE; level <= SCALER_SIMD_AVX2; level++ ) {
+    if( scaler_simd_select( level ) ) continue;
+
+    for( scanlines = 0; scanlines < 2; scanlines++ ) {
+      settings_current.pal_tv2x = scanlines;
+
+      for( i = 0; i < ARRAY_SIZE( simd_scalers ); i++ )
+        for( j = 0; j < ARRAY_SIZE( formats ); j++ )
+          for( repeat = 0; repeat < 16; repeat++ )
+            r += test_scaler( &simd_scalers[i], formats[j] );
+    }
+  }
+
+  settings_current.pal_tv2x = pal_tv2x;
+  scaler_simd_init();
+
+  return r;
+}
+
+/* Check that scaling a large area in bands gives the same output as doing
+   it in one go, for every scaler */
+int
+scaler_threads_unittest( void )
+{
+  const int width = 322, height = 242;	/* Odd bands, to test the rounding */
+  libspectrum_dword src_pitch = ( width + 4 ) * 4, dst_pitch = width * 4 * 4;
+  size_t dst_size = (size_t)dst_pitch * height * 4;
+  libspectrum_dword *src;
+  libspectrum_byte *plain, *bands, *origin;
+  scaler_type scaler, old_scaler = current_scaler;
+  int threads = settings_current.scaler_threads;
+  int i, r = 0;
+
+  /* 2xSaI and friends read two pixels beyond the area */
+  src = libspectrum_new( libspectrum_dword, ( width + 4 ) * ( height + 4 ) );
+  plain = libspectrum_new( libspectrum_byte, dst_size );
+  bands = libspectrum_new( libspectrum_byte, dst_size );
+
+  for( i = 0; i < ( width + 4 ) * ( height + 4 ); i++ )
+    src[i] = test_random() & 0xffffff;
+  origin = (libspectrum_byte*)src + 2 * src_pitch + 2 * 4;
+
+  settings_current.scaler_threads = 3;
+
+  for( scaler = 0; scaler < SCALER_NUM; scaler++ ) {
+    current_scaler = scaler;
+
+    memset( plain, 0, dst_size );
+    memset( bands, 0, dst_size );
+
+    available_scalers[ scaler ].scaler32( origin, src_pitch, plain, dst_pitch,
+                                          width, height );
+    scaler_run( available_scalers[ scaler ].scaler32, origin, src_pitch,
+                bands, dst_pitch, width, height );
+
+    if( memcmp( plain, bands, dst_size ) ) {
+      printf( "%s: %s differs when scaled in bands\n", fuse_progname,
+              available_scalers[ scaler ].name );
+      r++;
+    }
+  }
+
+  scaler_end();
+  settings_current.scaler_threads = threads;
+  current_scaler = old_scaler;
+
+  libspectrum_free( bands );
+  libspectrum_free( plain );
+  libspectrum_free( src );
+
+  return r;
+}
@@ -91,6 +91,18 @@ scaler_flags_t scaler_get_flags( scaler_type scaler );
 float scaler_get_scaling_factor( scaler_type scaler );
 scaler_expand_fn* scaler_get_expander( scaler_type scaler );
 
+/* Run scaler_proc16 or scaler_proc32 over an area, splitting large areas
+   between the scaler threads */
+void scaler_run( ScalerProc *proc, const libspectrum_byte *srcPtr,
+                 libspectrum_dword srcPitch, libspectrum_byte *dstPtr,
+                 libspectrum_dword dstPitch, int width, int height );
+/* Find the best row primitives this CPU supports, once and for all */
+void scaler_init( void );
+void scaler_end( void );
+
 int scaler_select_bitformat( libspectrum_dword BitFormat );
 
+int scaler_simd_unittest( void );
+int scaler_threads_unittest( void );
+
 #endif
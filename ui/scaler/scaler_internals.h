@@ -68,4 +68,79 @@ DECLARE_SCALER(HQ2x);
 DECLARE_SCALER(HQ3x);
 DECLARE_SCALER(HQ4x);
 
+/* The scalers with SIMD row primitives, which are used only when
+   scaler_simd_init() finds the CPU supports them */
+DECLARE_SCALER(PalTV2x_simd);
+DECLARE_SCALER(PalTV3x_simd);
+DECLARE_SCALER(PalTV4x_simd);
+DECLARE_SCALER(HQ2x_simd);
+DECLARE_SCALER(HQ3x_simd);
+DECLARE_SCALER(HQ4x_simd);
+
+#ifndef MIN
+#define MIN(a,b)    (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef ABS
+#define ABS(x)     ((x)>=0?(x):-(x))
+#endif
+
+/*
+    Y  =  0.29900 * R + 0.58700 * G + 0.11400 * B
+    U  = -0.16874 * R - 0.33126 * G + 0.50000 * B  (+ 128)
+    V  =  0.50000 * R - 0.41869 * G - 0.08131 * B  (+ 128)
+*/
+
+#define RGB_TO_Y(r, g, b) ( ( 2449L * r + 4809L * g + 934L * b + 1024 ) >> 11 )
+#define RGB_TO_U(r, g, b) ( ( 4096L * b - 1383L * r - 2713L * g + 1024 ) >> 11 )
+#define RGB_TO_V(r, g, b) ( ( 4096L * r - 3430L * g - 666L * b +  1024 ) >> 11 )
+
+/*
+    R = Y + 1.402 (V-128)
+    G = Y - 0.34414 (U-128) - 0.71414 (V-128)
+    B = Y + 1.772 (U-128)
+*/
+
+#define YUV_TO_R(y, u, v) ( MIN( ABS( ( 8192L * y              + 11485L * v + 16384 ) >> 15 ), 255 ) )
+#define YUV_TO_G(y, u, v) ( MIN( ABS( ( 8192L * y - 2819L  * u -  5850L * v + 16384 ) >> 15 ), 255 ) )
+#define YUV_TO_B(y, u, v) ( MIN( ABS( ( 8192L * y + 14516L * u              + 16384 ) >> 15 ), 255 ) )
+
+
+/* The widest line the SIMD scalers handle; anything wider falls back to
+   the plain C versions */
+#define SCALER_SIMD_MAX_WIDTH 1024
+
+typedef enum scaler_simd_level {
+  SCALER_SIMD_NONE = 0,
+  SCALER_SIMD_SSE2,
+  SCALER_SIMD_AVX2,
+} scaler_simd_level;
+
+/* Select the best row primitives this CPU supports, returning the level
+   chosen */
+scaler_simd_level scaler_simd_init( void );
+
+/* Force a particular level; returns non-zero if the CPU doesn't support it */
+int scaler_simd_select( scaler_simd_level level );
+
+/* Convert n pixels laid out as red|green<<8|blue<<16 to YUV */
+void scaler_yuv_row( const libspectrum_dword *rgb, int n,
+                     libspectrum_signed_dword *y, libspectrum_signed_dword *u,
+                     libspectrum_signed_dword *v );
+
+/* Work out the HQnx neighbour pattern for n pixels. rows[line][component]
+   points to column 0 of the YUV of the previous, current and next lines,
+   each of which must also have columns -1 and n */
+void scaler_hq_pattern_row( const libspectrum_signed_dword *const rows[3][3],
+                            int n, int *pattern );
+
+/* Decode n pixels of a PAL TV line from YUV (with columns -1 and n
+   present) into the first and second halves of each output pixel, laid
+   out as red|green<<8|blue<<16 */
+void scaler_pal_row( const libspectrum_signed_dword *y,
+                     const libspectrum_signed_dword *u,
+                     const libspectrum_signed_dword *v, int n,
+                     libspectrum_dword *e, libspectrum_dword *g );
+
+
 #endif				/* #ifndef FUSE_SCALER_INTERNALS_H */
@@ -0,0 +1,562 @@
+/* scaler_simd.c: SIMD row primitives for the HQnx and PAL TV scalers
+   Copyright (c) 2026 Philip Kendall
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* The HQnx and PAL TV scalers spend most of their time converting every
+   pixel to and from YUV, which is the same fixed point arithmetic for
+   each pixel and so can be done a whole line at a time. The SSE2 and AVX2
+   versions here do that using _mm_madd_epi16() on pairs of 16-bit values,
+   which gives exactly the same results as the RGB_TO_Y() etc. macros; the
+   plain C versions are used for the ends of lines and on other CPUs. */
+
+#include "config.h"
+
+#include "libspectrum.h"
+
+#include "compat.h"
+#include "scaler_internals.h"
+
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) ) \
+    && ( GNUC_PREREQ( 4, 9 ) || defined( __clang__ ) )
+#define SCALER_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#define HQ_trY 0x00000030
+#define HQ_trU 0x00000007
+#define HQ_trV 0x00000006
+
+/* A 32-bit lane holding the 16-bit values a (low) and b (high), as
+   multiplied by _mm_madd_epi16() */
+#define PAIR( a, b ) \
+  ( (int)( (libspectrum_dword)(libspectrum_word)(a) | \
+           ( (libspectrum_dword)(libspectrum_word)(b) << 16 ) ) )
+
+typedef void yuv_row_fn( const libspectrum_dword *rgb, int n,
+                         libspectrum_signed_dword *y,
+                         libspectrum_signed_dword *u,
+                         libspectrum_signed_dword *v );
+typedef void hq_pattern_row_fn( const libspectrum_signed_dword *const rows[3][3],
+                                int n, int *pattern );
+typedef void pal_row_fn( const libspectrum_signed_dword *y,
+                         const libspectrum_signed_dword *u,
+                         const libspectrum_signed_dword *v, int n,
+                         libspectrum_dword *e, libspectrum_dword *g );
+
+static void
+yuv_row_c( const libspectrum_dword *rgb, int n, libspectrum_signed_dword *y,
+           libspectrum_signed_dword *u, libspectrum_signed_dword *v )
+{
+  libspectrum_dword r, g, b;
+  int i;
+
+  for( i = 0; i < n; i++ ) {
+    r =   rgb[i]         & 0xff;
+    g = ( rgb[i] >>  8 ) & 0xff;
+    b = ( rgb[i] >> 16 ) & 0xff;
+    y[i] = RGB_TO_Y( r, g, b );
+    u[i] = RGB_TO_U( r, g, b );
+    v[i] = RGB_TO_V( r, g, b );
+  }
+}
+
+static void
+hq_pattern_row_c( const libspectrum_signed_dword *const rows[3][3], int n,
+                  int *pattern )
+{
+  libspectrum_signed_dword y, u, v;
+  int i, line, k;
+
+  for( i = 0; i < n; i++ ) {
+    y = rows[1][0][i]; u = rows[1][1][i]; v = rows[1][2][i];
+    pattern[i] = 0;
+
+    /* Neighbours 1 to 9, skipping the pixel itself */
+    for( line = 0, k = 0; line < 3; line++ ) {
+      int dx;
+      for( dx = -1; dx <= 1; dx++ ) {
+        if( line == 1 && dx == 0 ) continue;
+        if( ABS( y - rows[line][0][i + dx] ) > HQ_trY ||
+            ABS( u - rows[line][1][i + dx] ) > HQ_trU ||
+            ABS( v - rows[line][2][i + dx] ) > HQ_trV )
+          pattern[i] |= 1 << k;
+        k++;
+      }
+    }
+  }
+}
+
+static libspectrum_dword
+yuv_to_rgb( libspectrum_signed_dword y, libspectrum_signed_dword u,
+            libspectrum_signed_dword v )
+{
+  return YUV_TO_R( y, u, v ) | ( YUV_TO_G( y, u, v ) << 8 ) |
+         ( YUV_TO_B( y, u, v ) << 16 );
+}
+
+static void
+pal_row_c( const libspectrum_signed_dword *y, const libspectrum_signed_dword *u,
+           const libspectrum_signed_dword *v, int n, libspectrum_dword *e,
+           libspectrum_dword *g )
+{
+  libspectrum_signed_dword u1, v1, u2, v2;
+  int i;
+
+  for( i = 0; i < n; i++ ) {
+    /* 4:2:2 cosited subsampling of this pixel and the next */
+    u1 = ( u[i - 1] + 3 * u[i] ) >> 2;
+    v1 = ( v[i - 1] + 3 * v[i] ) >> 2;
+    u2 = ( u[i] + 3 * u[i + 1] ) >> 2;
+    v2 = ( v[i] + 3 * v[i + 1] ) >> 2;
+
+    e[i] = yuv_to_rgb( y[i], u1, v1 );
+
+    u2 = ( u1 + u2 ) >> 1;
+    v2 = ( v1 + v2 ) >> 1;
+    g[i] = yuv_to_rgb( y[i], u2, v2 );
+  }
+}
+
+#ifdef SCALER_SIMD_X86
+
+__attribute__(( target( "sse2" ) ))
+static void
+yuv_row_sse2( const libspectrum_dword *rgb, int n, libspectrum_signed_dword *y,
+              libspectrum_signed_dword *u, libspectrum_signed_dword *v )
+{
+  const __m128i mask = _mm_set1_epi32( 0xff ), one = _mm_set1_epi32( 1 << 16 );
+  const __m128i y_rg = _mm_set1_epi32( PAIR(  2449,  4809 ) ),
+                y_b1 = _mm_set1_epi32( PAIR(   934,  1024 ) ),
+                u_rg = _mm_set1_epi32( PAIR( -1383, -2713 ) ),
+                u_b1 = _mm_set1_epi32( PAIR(  4096,  1024 ) ),
+                v_rg = _mm_set1_epi32( PAIR(  4096, -3430 ) ),
+                v_b1 = _mm_set1_epi32( PAIR(  -666,  1024 ) );
+  __m128i px, rg, b1;
+  int i;
+
+  for( i = 0; i + 4 <= n; i += 4 ) {
+    px = _mm_loadu_si128( (const __m128i*)&rgb[i] );
+    rg = _mm_or_si128( _mm_and_si128( px, mask ),
+                       _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( px, 8 ),
+                                                      mask ), 16 ) );
+    b1 = _mm_or_si128( _mm_and_si128( _mm_srli_epi32( px, 16 ), mask ), one );
+
+    _mm_storeu_si128( (__m128i*)&y[i],
+      _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( rg, y_rg ),
+                                     _mm_madd_epi16( b1, y_b1 ) ), 11 ) );
+    _mm_storeu_si128( (__m128i*)&u[i],
+      _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( rg, u_rg ),
+                                     _mm_madd_epi16( b1, u_b1 ) ), 11 ) );
+    _mm_storeu_si128( (__m128i*)&v[i],
+      _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( rg, v_rg ),
+                                     _mm_madd_epi16( b1, v_b1 ) ), 11 ) );
+  }
+
+  yuv_row_c( &rgb[i], n - i, &y[i], &u[i], &v[i] );
+}
+
+/* Lanes set where |a - b| exceeds the threshold t */
+__attribute__(( target( "sse2" ) ))
+static inline __m128i
+diff_sse2( __m128i a, __m128i b, __m128i t, __m128i minus_t )
+{
+  __m128i d = _mm_sub_epi32( a, b );
+  return _mm_or_si128( _mm_cmpgt_epi32( d, t ), _mm_cmpgt_epi32( minus_t, d ) );
+}
+
+__attribute__(( target( "sse2" ) ))
+static void
+hq_pattern_row_sse2( const libspectrum_signed_dword *const rows[3][3], int n,
+                     int *pattern )
+{
+  const __m128i ty = _mm_set1_epi32( HQ_trY ), tu = _mm_set1_epi32( HQ_trU ),
+                tv = _mm_set1_epi32( HQ_trV ), mty = _mm_set1_epi32( -HQ_trY ),
+                mtu = _mm_set1_epi32( -HQ_trU ), mtv = _mm_set1_epi32( -HQ_trV );
+  __m128i y, u, v, acc, d;
+  int i, line, dx, k;
+
+  for( i = 0; i + 4 <= n; i += 4 ) {
+    y = _mm_loadu_si128( (const __m128i*)&rows[1][0][i] );
+    u = _mm_loadu_si128( (const __m128i*)&rows[1][1][i] );
+    v = _mm_loadu_si128( (const __m128i*)&rows[1][2][i] );
+    acc = _mm_setzero_si128();
+
+    for( line = 0, k = 0; line < 3; line++ ) {
+      for( dx = -1; dx <= 1; dx++ ) {
+        if( line == 1 && dx == 0 ) continue;
+        d = _mm_or_si128(
+              _mm_or_si128(
+                diff_sse2( y, _mm_loadu_si128(
+                  (const __m128i*)&rows[line][0][i + dx] ), ty, mty ),
+                diff_sse2( u, _mm_loadu_si128(
+                  (const __m128i*)&rows[line][1][i + dx] ), tu, mtu ) ),
+              diff_sse2( v, _mm_loadu_si128(
+                (const __m128i*)&rows[line][2][i + dx] ), tv, mtv ) );
+        acc = _mm_or_si128( acc, _mm_and_si128( d, _mm_set1_epi32( 1 << k ) ) );
+        k++;
+      }
+    }
+
+    _mm_storeu_si128( (__m128i*)&pattern[i], acc );
+  }
+
+  if( i < n ) {
+    const libspectrum_signed_dword *const tail[3][3] = {
+      { &rows[0][0][i], &rows[0][1][i], &rows[0][2][i] },
+      { &rows[1][0][i], &rows[1][1][i], &rows[1][2][i] },
+      { &rows[2][0][i], &rows[2][1][i], &rows[2][2][i] },
+    };
+    hq_pattern_row_c( tail, n - i, &pattern[i] );
+  }
+}
+
+/* MIN( ABS( x >> 15 ), 255 ) */
+__attribute__(( target( "sse2" ) ))
+static inline __m128i
+clamp_sse2( __m128i x )
+{
+  __m128i sign, big;
+
+  x = _mm_srai_epi32( x, 15 );
+  sign = _mm_srai_epi32( x, 31 );
+  x = _mm_sub_epi32( _mm_xor_si128( x, sign ), sign );
+  big = _mm_cmpgt_epi32( x, _mm_set1_epi32( 255 ) );
+  return _mm_or_si128( _mm_and_si128( big, _mm_set1_epi32( 255 ) ),
+                       _mm_andnot_si128( big, x ) );
+}
+
+__attribute__(( target( "sse2" ) ))
+static inline __m128i
+yuv_to_rgb_sse2( __m128i y, __m128i u, __m128i v )
+{
+  const __m128i r_yv = _mm_set1_epi32( PAIR(  8192, 11485 ) ),
+                g_yu = _mm_set1_epi32( PAIR(  8192, -2819 ) ),
+                g_v1 = _mm_set1_epi32( PAIR( -5850, 16384 ) ),
+                b_yu = _mm_set1_epi32( PAIR(  8192, 14516 ) ),
+                round = _mm_set1_epi32( 16384 );
+  __m128i yu = _mm_or_si128( y, _mm_slli_epi32( u, 16 ) ),
+          yv = _mm_or_si128( y, _mm_slli_epi32( v, 16 ) ),
+          v1 = _mm_or_si128( _mm_and_si128( v, _mm_set1_epi32( 0xffff ) ),
+                             _mm_set1_epi32( 1 << 16 ) );
+  __m128i r, g, b;
+
+  r = clamp_sse2( _mm_add_epi32( _mm_madd_epi16( yv, r_yv ), round ) );
+  g = clamp_sse2( _mm_add_epi32( _mm_madd_epi16( yu, g_yu ),
+                                 _mm_madd_epi16( v1, g_v1 ) ) );
+  b = clamp_sse2( _mm_add_epi32( _mm_madd_epi16( yu, b_yu ), round ) );
+
+  return _mm_or_si128( _mm_or_si128( r, _mm_slli_epi32( g, 8 ) ),
+                       _mm_slli_epi32( b, 16 ) );
+}
+
+/* ( a + 3 * b ) >> 2 */
+#define SUBSAMPLE_SSE2( a, b ) \
+  _mm_srai_epi32( _mm_add_epi32( a, _mm_add_epi32( b, _mm_add_epi32( b, b ) ) ), 2 )
+
+__attribute__(( target( "sse2" ) ))
+static void
+pal_row_sse2( const libspectrum_signed_dword *y,
+              const libspectrum_signed_dword *u,
+              const libspectrum_signed_dword *v, int n, libspectrum_dword *e,
+              libspectrum_dword *g )
+{
+  __m128i yy, u0, u1, u2, v0, v1, v2, su1, sv1, su2, sv2;
+  int i;
+
+  for( i = 0; i + 4 <= n; i += 4 ) {
+    yy = _mm_loadu_si128( (const __m128i*)&y[i] );
+    u0 = _mm_loadu_si128( (const __m128i*)&u[i - 1] );
+    u1 = _mm_loadu_si128( (const __m128i*)&u[i] );
+    u2 = _mm_loadu_si128( (const __m128i*)&u[i + 1] );
+    v0 = _mm_loadu_si128( (const __m128i*)&v[i - 1] );
+    v1 = _mm_loadu_si128( (const __m128i*)&v[i] );
+    v2 = _mm_loadu_si128( (const __m128i*)&v[i + 1] );
+
+    su1 = SUBSAMPLE_SSE2( u0, u1 ); sv1 = SUBSAMPLE_SSE2( v0, v1 );
+    su2 = SUBSAMPLE_SSE2( u1, u2 ); sv2 = SUBSAMPLE_SSE2( v1, v2 );
+
+    _mm_storeu_si128( (__m128i*)&e[i], yuv_to_rgb_sse2( yy, su1, sv1 ) );
+    _mm_storeu_si128( (__m128i*)&g[i],
+      yuv_to_rgb_sse2( yy, _mm_srai_epi32( _mm_add_epi32( su1, su2 ), 1 ),
+                           _mm_srai_epi32( _mm_add_epi32( sv1, sv2 ), 1 ) ) );
+  }
+
+  pal_row_c( &y[i], &u[i], &v[i], n - i, &e[i], &g[i] );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void
+yuv_row_avx2( const libspectrum_dword *rgb, int n, libspectrum_signed_dword *y,
+              libspectrum_signed_dword *u, libspectrum_signed_dword *v )
+{
+  const __m256i mask = _mm256_set1_epi32( 0xff ),
+                one = _mm256_set1_epi32( 1 << 16 );
+  const __m256i y_rg = _mm256_set1_epi32( PAIR(  2449,  4809 ) ),
+                y_b1 = _mm256_set1_epi32( PAIR(   934,  1024 ) ),
+                u_rg = _mm256_set1_epi32( PAIR( -1383, -2713 ) ),
+                u_b1 = _mm256_set1_epi32( PAIR(  4096,  1024 ) ),
+                v_rg = _mm256_set1_epi32( PAIR(  4096, -3430 ) ),
+                v_b1 = _mm256_set1_epi32( PAIR(  -666,  1024 ) );
+  __m256i px, rg, b1;
+  int i;
+
+  for( i = 0; i + 8 <= n; i += 8 ) {
+    px = _mm256_loadu_si256( (const __m256i*)&rgb[i] );
+    rg = _mm256_or_si256( _mm256_and_si256( px, mask ),
+           _mm256_slli_epi32( _mm256_and_si256( _mm256_srli_epi32( px, 8 ),
+                                                mask ), 16 ) );
+    b1 = _mm256_or_si256( _mm256_and_si256( _mm256_srli_epi32( px, 16 ),
+                                            mask ), one );
+
+    _mm256_storeu_si256( (__m256i*)&y[i],
+      _mm256_srai_epi32( _mm256_add_epi32( _mm256_madd_epi16( rg, y_rg ),
+                                           _mm256_madd_epi16( b1, y_b1 ) ),
+                         11 ) );
+    _mm256_storeu_si256( (__m256i*)&u[i],
+      _mm256_srai_epi32( _mm256_add_epi32( _mm256_madd_epi16( rg, u_rg ),
+                                           _mm256_madd_epi16( b1, u_b1 ) ),
+                         11 ) );
+    _mm256_storeu_si256( (__m256i*)&v[i],
+      _mm256_srai_epi32( _mm256_add_epi32( _mm256_madd_epi16( rg, v_rg ),
+                                           _mm256_madd_epi16( b1, v_b1 ) ),
+                         11 ) );
+  }
+
+  yuv_row_sse2( &rgb[i], n - i, &y[i], &u[i], &v[i] );
+}
+
+__attribute__(( target( "avx2" ) ))
+static void
+hq_pattern_row_avx2( const libspectrum_signed_dword *const rows[3][3], int n,
+                     int *pattern )
+{
+  const __m256i t[3] = { _mm256_set1_epi32( HQ_trY ),
+                         _mm256_set1_epi32( HQ_trU ),
+                         _mm256_set1_epi32( HQ_trV ) };
+  __m256i centre[3], acc, d;
+  int i, line, dx, c, k;
+
+  for( i = 0; i + 8 <= n; i += 8 ) {
+    for( c = 0; c < 3; c++ )
+      centre[c] = _mm256_loadu_si256( (const __m256i*)&rows[1][c][i] );
+    acc = _mm256_setzero_si256();
+
+    for( line = 0, k = 0; line < 3; line++ ) {
+      for( dx = -1; dx <= 1; dx++ ) {
+        if( line == 1 && dx == 0 ) continue;
+        d = _mm256_setzero_si256();
+        for( c = 0; c < 3; c++ )
+          d = _mm256_or_si256( d, _mm256_cmpgt_epi32(
+                _mm256_abs_epi32( _mm256_sub_epi32( centre[c],
+                  _mm256_loadu_si256(
+                    (const __m256i*)&rows[line][c][i + dx] ) ) ), t[c] ) );
+        acc = _mm256_or_si256( acc,
+                               _mm256_and_si256( d, _mm256_set1_epi32( 1 << k ) ) );
+        k++;
+      }
+    }
+
+    _mm256_storeu_si256( (__m256i*)&pattern[i], acc );
+  }
+
+  if( i < n ) {
+    const libspectrum_signed_dword *const tail[3][3] = {
+      { &rows[0][0][i], &rows[0][1][i], &rows[0][2][i] },
+      { &rows[1][0][i], &rows[1][1][i], &rows[1][2][i] },
+      { &rows[2][0][i], &rows[2][1][i], &rows[2][2][i] },
+    };
+    hq_pattern_row_sse2( tail, n - i, &pattern[i] );
+  }
+}
+
+__attribute__(( target( "avx2" ) ))
+static inline __m256i
+clamp_avx2( __m256i x )
+{
+  return _mm256_min_epi32( _mm256_abs_epi32( _mm256_srai_epi32( x, 15 ) ),
+                           _mm256_set1_epi32( 255 ) );
+}
+
+__attribute__(( target( "avx2" ) ))
+static inline __m256i
+yuv_to_rgb_avx2( __m256i y, __m256i u, __m256i v )
+{
+  const __m256i r_yv = _mm256_set1_epi32( PAIR(  8192, 11485 ) ),
+                g_yu = _mm256_set1_epi32( PAIR(  8192, -2819 ) ),
+                g_v1 = _mm256_set1_epi32( PAIR( -5850, 16384 ) ),
+                b_yu = _mm256_set1_epi32( PAIR(  8192, 14516 ) ),
+                round = _mm256_set1_epi32( 16384 );
+  __m256i yu = _mm256_or_si256( y, _mm256_slli_epi32( u, 16 ) ),
+          yv = _mm256_or_si256( y, _mm256_slli_epi32( v, 16 ) ),
+          v1 = _mm256_or_si256( _mm256_and_si256( v,
+                                                  _mm256_set1_epi32( 0xffff ) ),
+                                _mm256_set1_epi32( 1 << 16 ) );
+  __m256i r, g, b;
+
+  r = clamp_avx2( _mm256_add_epi32( _mm256_madd_epi16( yv, r_yv ), round ) );
+  g = clamp_avx2( _mm256_add_epi32( _mm256_madd_epi16( yu, g_yu ),
+                                    _mm256_madd_epi16( v1, g_v1 ) ) );
+  b = clamp_avx2( _mm256_add_epi32( _mm256_madd_epi16( yu, b_yu ), round ) );
+
+  return _mm256_or_si256( _mm256_or_si256( r, _mm256_slli_epi32( g, 8 ) ),
+                          _mm256_slli_epi32( b, 16 ) );
+}
+
+#define SUBSAMPLE_AVX2( a, b ) \
+  _mm256_srai_epi32( _mm256_add_epi32( a, _mm256_add_epi32( b, \
+                       _mm256_add_epi32( b, b ) ) ), 2 )
+
+__attribute__(( target( "avx2" ) ))
+static void
+pal_row_avx2( const libspectrum_signed_dword *y,
+              const libspectrum_signed_dword *u,
+              const libspectrum_signed_dword *v, int n, libspectrum_dword *e,
+              libspectrum_dword *g )
+{
+  __m256i yy, u0, u1, u2, v0, v1, v2, su1, sv1, su2, sv2;
+  int i;
+
+  for( i = 0; i + 8 <= n; i += 8 ) {
+    yy = _mm256_loadu_si256( (const __m256i*)&y[i] );
+    u0 = _mm256_loadu_si256( (const __m256i*)&u[i - 1] );
+    u1 = _mm256_loadu_si256( (const __m256i*)&u[i] );
+    u2 = _mm256_loadu_si256( (const __m256i*)&u[i + 1] );
+    v0 = _mm256_loadu_si256( (const __m256i*)&v[i - 1] );
+    v1 = _mm256_loadu_si256( (const __m256i*)&v[i] );
+    v2 = _mm256_loadu_si256( (const __m256i*)&v[i + 1] );
+
+    su1 = SUBSAMPLE_AVX2( u0, u1 ); sv1 = SUBSAMPLE_AVX2( v0, v1 );
+    su2 = SUBSAMPLE_AVX2( u1, u2 ); sv2 = SUBSAMPLE_AVX2( v1, v2 );
+
+    _mm256_storeu_si256( (__m256i*)&e[i], yuv_to_rgb_avx2( yy, su1, sv1 ) );
+    _mm256_storeu_si256( (__m256i*)&g[i],
+      yuv_to_rgb_avx2( yy,
+                       _mm256_srai_epi32( _mm256_add_epi32( su1, su2 ), 1 ),
+                       _mm256_srai_epi32( _mm256_add_epi32( sv1, sv2 ), 1 ) ) );
+  }
+
+  pal_row_sse2( &y[i], &u[i], &v[i], n - i, &e[i], &g[i] );
+}
+
+#endif				/* #ifdef SCALER_SIMD_X86 */
+
+static yuv_row_fn *yuv_row = yuv_row_c;
+static hq_pattern_row_fn *hq_pattern_row = hq_pattern_row_c;
+static pal_row_fn *pal_row = pal_row_c;
+
+static int
+level_supported( scaler_simd_level level )
+{
+  switch( level ) {
+
+  case SCALER_SIMD_NONE: return 1;
+
+#ifdef SCALER_SIMD_X86
+  case SCALER_SIMD_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "sse2" );
+
+  case SCALER_SIMD_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif				/* #ifdef SCALER_SIMD_X86 */
+
+  default: return 0;
+
+  }
+}
+
+int
+scaler_simd_select( scaler_simd_level level )
+{
+  if( !level_supported( level ) ) return 1;
+
+  switch( level ) {
+
+#ifdef SCALER_SIMD_X86
+  case SCALER_SIMD_SSE2:
+    yuv_row = yuv_row_sse2;
+    hq_pattern_row = hq_pattern_row_sse2;
+    pal_row = pal_row_sse2;
+    break;
+
+  case SCALER_SIMD_AVX2:
+    yuv_row = yuv_row_avx2;
+    hq_pattern_row = hq_pattern_row_avx2;
+    pal_row = pal_row_avx2;
+    break;
+#endif				/* #ifdef SCALER_SIMD_X86 */
+
+  default:
+    yuv_row = yuv_row_c;
+    hq_pattern_row = hq_pattern_row_c;
+    pal_row = pal_row_c;
+    break;
+
+  }
+
+  return 0;
+}
+
+scaler_simd_level
+scaler_simd_init( void )
+{
+  static int best = -1;
+
+  if( best == -1 ) {
+    if( !scaler_simd_select( SCALER_SIMD_AVX2 ) ) {
+      best = SCALER_SIMD_AVX2;
+    } else if( !scaler_simd_select( SCALER_SIMD_SSE2 ) ) {
+      best = SCALER_SIMD_SSE2;
+    } else {
+      best = SCALER_SIMD_NONE;
+    }
+  } else {
+    scaler_simd_select( best );
+  }
+
+  return best;
+}
+
+void
+scaler_yuv_row( const libspectrum_dword *rgb, int n,
+                libspectrum_signed_dword *y, libspectrum_signed_dword *u,
+                libspectrum_signed_dword *v )
+{
+  yuv_row( rgb, n, y, u, v );
+}
+
+void
+scaler_hq_pattern_row( const libspectrum_signed_dword *const rows[3][3],
+                       int n, int *pattern )
+{
+  hq_pattern_row( rows, n, pattern );
+}
+
+void
+scaler_pal_row( const libspectrum_signed_dword *y,
+                const libspectrum_signed_dword *u,
+                const libspectrum_signed_dword *v, int n,
+                libspectrum_dword *e, libspectrum_dword *g )
+{
+  pal_row( y, u, v, n, e, g );
+}
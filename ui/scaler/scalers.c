@@ -36,14 +36,6 @@
 #include "ui/ui.h"
 #include "ui/uidisplay.h"
 
-#ifndef MIN
-#define MIN(a,b)    (((a) < (b)) ? (a) : (b))
-#endif
-
-#ifndef ABS
-#define ABS(x)     ((x)>=0?(x):-(x))
-#endif
-
 /* The actual code for the scalers starts here */
 
 #if SCALER_DATA_SIZE == 2
@@ -1442,26 +1434,6 @@ FUNCTION( scaler_DotMatrix )( const libspectrum_byte *srcPtr,
   }
 }
 
-/*
-    Y  =  0.29900 * R + 0.58700 * G + 0.11400 * B
-    U  = -0.16874 * R - 0.33126 * G + 0.50000 * B  (+ 128)
-    V  =  0.50000 * R - 0.41869 * G - 0.08131 * B  (+ 128)
-*/
-
-#define RGB_TO_Y(r, g, b) ( ( 2449L * r + 4809L * g + 934L * b + 1024 ) >> 11 )
-#define RGB_TO_U(r, g, b) ( ( 4096L * b - 1383L * r - 2713L * g + 1024 ) >> 11 )
-#define RGB_TO_V(r, g, b) ( ( 4096L * r - 3430L * g - 666L * b +  1024 ) >> 11 )
-
-/*
-    R = Y + 1.402 (V-128)
-    G = Y - 0.34414 (U-128) - 0.71414 (V-128)
-    B = Y + 1.772 (U-128)
-*/
-
-#define YUV_TO_R(y, u, v) ( MIN( ABS( ( 8192L * y              + 11485L * v + 16384 ) >> 15 ), 255 ) )
-#define YUV_TO_G(y, u, v) ( MIN( ABS( ( 8192L * y - 2819L  * u -  5850L * v + 16384 ) >> 15 ), 255 ) )
-#define YUV_TO_B(y, u, v) ( MIN( ABS( ( 8192L * y + 14516L * u              + 16384 ) >> 15 ), 255 ) )
-
 #define RGB_TO_PIXEL_555(r,g,b) \
         (((r * 125) >> 10) + (((g * 125) >> 5) & greenMask) + \
                 ((b * 125) & blueMask))
@@ -2369,3 +2341,367 @@ FUNCTION( scaler_HQ4x ) ( const libspectrum_byte *srcPtr,
     q0 += ( nextlineDst << 2 );
   }
 }
+
+/* The versions of the HQnx and PAL TV scalers used when the CPU has SIMD
+   instructions. These do the YUV conversions and the HQnx neighbour tests
+   a line at a time using the row primitives in scaler_simd.c, and so must
+   give exactly the same output as the plain versions above */
+
+/* Convert columns -1 to width of a source line to YUV */
+static void
+FUNCTION( line_to_yuv )( const scaler_data_type *p, int width,
+                         libspectrum_signed_dword
+                           yuv[3][ SCALER_SIMD_MAX_WIDTH + 2 ] )
+{
+#if SCALER_DATA_SIZE == 2
+  libspectrum_dword rgb[ SCALER_SIMD_MAX_WIDTH + 2 ];
+  int i;
+
+  for( i = 0; i < width + 2; i++ )
+    rgb[i] = R_TO_R( p[ i - 1 ] ) | ( G_TO_G( p[ i - 1 ] ) << 8 ) |
+             ( B_TO_B( p[ i - 1 ] ) << 16 );
+
+  scaler_yuv_row( rgb, width + 2, yuv[0], yuv[1], yuv[2] );
+#else
+  scaler_yuv_row( p - 1, width + 2, yuv[0], yuv[1], yuv[2] );
+#endif
+}
+
+static inline scaler_data_type
+FUNCTION( rgb_to_pixel )( libspectrum_dword rgb )
+{
+#if SCALER_DATA_SIZE == 2
+  libspectrum_dword r = rgb & 0xff, g = ( rgb >> 8 ) & 0xff, b = rgb >> 16;
+
+  return green6bit ? RGB_TO_PIXEL_565( r, g, b ) : RGB_TO_PIXEL_555( r, g, b );
+#else
+  return rgb;
+#endif
+}
+
+static inline scaler_data_type
+FUNCTION( pal_scanline )( scaler_data_type pixel )
+{
+  if( !settings_current.pal_tv2x ) return pixel;
+
+  return ((((pixel & redblueMask) * 7) >> 3) & redblueMask) |
+             ((((pixel & greenMask  ) * 7) >> 3) & greenMask);
+}
+
+/* Decode one source line into the first (E) and second (G) halves of each
+   output pixel */
+static void
+FUNCTION( pal_line )( const scaler_data_type *p, int width,
+                      libspectrum_dword *e, libspectrum_dword *g )
+{
+  libspectrum_signed_dword yuv[3][ SCALER_SIMD_MAX_WIDTH + 2 ];
+
+  FUNCTION( line_to_yuv )( p, width, yuv );
+  scaler_pal_row( yuv[0] + 1, yuv[1] + 1, yuv[2] + 1, width, e, g );
+}
+
+void
+FUNCTION( scaler_PalTV2x_simd )( const libspectrum_byte *srcPtr,
+                                 libspectrum_dword srcPitch,
+                                 libspectrum_byte *dstPtr,
+                                 libspectrum_dword dstPitch,
+                                 int width, int height )
+{
+  int i, j;
+  unsigned int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p0 = (const scaler_data_type *)srcPtr;
+  unsigned int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q, *q0 = (scaler_data_type *)dstPtr;
+  libspectrum_dword e[ SCALER_SIMD_MAX_WIDTH ], g[ SCALER_SIMD_MAX_WIDTH ];
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_PalTV2x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                                height );
+    return;
+  }
+
+  for( j = height; j; j-- ) {
+    FUNCTION( pal_line )( p0, width, e, g );
+
+    for( i = 0, q = q0; i < width; i++, q += 2 ) {
+      q[0] = FUNCTION( rgb_to_pixel )( e[i] );
+      q[1] = FUNCTION( rgb_to_pixel )( g[i] );
+      q[ nextlineDst     ] = FUNCTION( pal_scanline )( q[0] );
+      q[ nextlineDst + 1 ] = FUNCTION( pal_scanline )( q[1] );
+    }
+
+    p0 += nextlineSrc;
+    q0 += nextlineDst << 1;
+  }
+}
+
+void
+FUNCTION( scaler_PalTV3x_simd )( const libspectrum_byte *srcPtr,
+                                 libspectrum_dword srcPitch,
+                                 libspectrum_byte *dstPtr,
+                                 libspectrum_dword dstPitch,
+                                 int width, int height )
+{
+  int i, j, k;
+  unsigned int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p0 = (const scaler_data_type *)srcPtr;
+  unsigned int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q, *q0 = (scaler_data_type *)dstPtr;
+  libspectrum_dword e[ SCALER_SIMD_MAX_WIDTH ], g[ SCALER_SIMD_MAX_WIDTH ], f;
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_PalTV3x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                                height );
+    return;
+  }
+
+  for( j = height; j; j-- ) {
+    FUNCTION( pal_line )( p0, width, e, g );
+
+/*
+    ab  => EFG
+    ab     EFG
+           efg
+*/
+    for( i = 0, q = q0; i < width; i++, q += 3 ) {
+      f = ( e[i] & g[i] ) + ( ( ( e[i] ^ g[i] ) >> 1 ) & 0x007f7f7f );
+      q[0] = FUNCTION( rgb_to_pixel )( e[i] );
+      q[1] = FUNCTION( rgb_to_pixel )( f );
+      q[2] = FUNCTION( rgb_to_pixel )( g[i] );
+      for( k = 0; k < 3; k++ ) {
+        q[ nextlineDst + k ] = q[k];
+        q[ ( nextlineDst << 1 ) + k ] = FUNCTION( pal_scanline )( q[k] );
+      }
+    }
+
+    p0 += nextlineSrc;
+    q0 += ( nextlineDst << 1 ) + nextlineDst;
+  }
+}
+
+void
+FUNCTION( scaler_PalTV4x_simd )( const libspectrum_byte *srcPtr,
+                                 libspectrum_dword srcPitch,
+                                 libspectrum_byte *dstPtr,
+                                 libspectrum_dword dstPitch,
+                                 int width, int height )
+{
+  int i, j, k;
+  unsigned int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p0 = (const scaler_data_type *)srcPtr;
+  unsigned int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q, *q0 = (scaler_data_type *)dstPtr, scanline;
+  libspectrum_dword e[ SCALER_SIMD_MAX_WIDTH ], g[ SCALER_SIMD_MAX_WIDTH ];
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_PalTV4x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                                height );
+    return;
+  }
+
+  for( j = height; j; j-- ) {
+    FUNCTION( pal_line )( p0, width, e, g );
+
+    for( i = 0, q = q0; i < width; i++, q += 4 ) {
+      q[0] = q[1] = FUNCTION( rgb_to_pixel )( e[i] );
+      q[2] = q[3] = FUNCTION( rgb_to_pixel )( g[i] );
+      for( k = 0; k < 4; k += 2 ) {
+        scanline = FUNCTION( pal_scanline )( q[k] );
+        q[     nextlineDst + k ] = q[     nextlineDst + k + 1 ] =
+        q[ 2 * nextlineDst + k ] = q[ 2 * nextlineDst + k + 1 ] =
+        q[ 3 * nextlineDst + k ] = q[ 3 * nextlineDst + k + 1 ] = scanline;
+      }
+    }
+
+    p0 += nextlineSrc;
+    q0 += nextlineDst << 2;
+  }
+}
+
+/* The YUV of the previous, current and next source lines. Source line l
+   is kept in line[ ( l + 1 ) % 3 ] */
+typedef struct FUNCTION( hq_lines ) {
+  libspectrum_signed_dword line[3][3][ SCALER_SIMD_MAX_WIDTH + 2 ];
+  const libspectrum_signed_dword *rows[3][3];
+  int pattern[ SCALER_SIMD_MAX_WIDTH ];
+} FUNCTION( hq_lines );
+
+static void
+FUNCTION( hq_next_line )( FUNCTION( hq_lines ) *lines,
+                          const scaler_data_type *p, int nextlineSrc,
+                          int width, int j )
+{
+  int k, c;
+
+  if( j == 0 ) {
+    FUNCTION( line_to_yuv )( p + prevline, width, lines->line[0] );
+    FUNCTION( line_to_yuv )( p, width, lines->line[1] );
+  }
+  FUNCTION( line_to_yuv )( p + nextline, width, lines->line[ ( j + 2 ) % 3 ] );
+
+  for( k = 0; k < 3; k++ )
+    for( c = 0; c < 3; c++ )
+      lines->rows[k][c] = lines->line[ ( j + k ) % 3 ][c] + 1;
+
+  scaler_hq_pattern_row( lines->rows, width, lines->pattern );
+}
+
+/* Fetch the neighbours of pixel i, and the YUV of the edge neighbours
+   which the pattern switches compare with each other */
+#define HQ_SIMD_FETCH( lines ) \
+      pattern = lines.pattern[i]; \
+      w[1] = *(p + prevline - 1); w[2] = *(p + prevline); \
+      w[3] = *(p + prevline + 1); \
+      w[4] = *(p - 1); w[5] = *p; w[6] = *(p + 1); \
+      w[7] = *(p + nextline - 1); w[8] = *(p + nextline); \
+      w[9] = *(p + nextline + 1); \
+      y[2] = lines.rows[0][0][i]; u[2] = lines.rows[0][1][i]; \
+      v[2] = lines.rows[0][2][i]; \
+      y[4] = lines.rows[1][0][i-1]; u[4] = lines.rows[1][1][i-1]; \
+      v[4] = lines.rows[1][2][i-1]; \
+      y[6] = lines.rows[1][0][i+1]; u[6] = lines.rows[1][1][i+1]; \
+      v[6] = lines.rows[1][2][i+1]; \
+      y[8] = lines.rows[2][0][i]; u[8] = lines.rows[2][1][i]; \
+      v[8] = lines.rows[2][2][i];
+
+void
+FUNCTION( scaler_HQ2x_simd ) ( const libspectrum_byte *srcPtr,
+                               libspectrum_dword srcPitch,
+                               libspectrum_byte *dstPtr,
+                               libspectrum_dword dstPitch,
+                               int width, int height )
+{
+  int i, j, pattern;
+  int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
+  int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q, *q1, *qN, *qN1, *q0 = (scaler_data_type *)dstPtr;
+  libspectrum_qword w[10];
+  libspectrum_signed_dword y[10], u[10], v[10];
+  FUNCTION( hq_lines ) lines;
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_HQ2x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                             height );
+    return;
+  }
+
+  for( j = 0; j < height; j++ ) {
+    p = p0;
+    q = q0; q1 = q + 1;
+    qN = q + nextlineDst; qN1 = qN + 1;
+
+    FUNCTION( hq_next_line )( &lines, p0, nextlineSrc, width, j );
+
+    for( i = 0; i < width; i++ ) {
+      HQ_SIMD_FETCH( lines )
+
+#include "scaler_hq2x.c"
+
+      p++;
+      q  += 2; q1  += 2;
+      qN += 2; qN1 += 2;
+    }
+    p0 += nextlineSrc;
+    q0 += nextlineDst << 1;
+  }
+}
+
+void
+FUNCTION( scaler_HQ3x_simd ) ( const libspectrum_byte *srcPtr,
+                               libspectrum_dword srcPitch,
+                               libspectrum_byte *dstPtr,
+                               libspectrum_dword dstPitch,
+                               int width, int height )
+{
+  int i, j, pattern;
+  int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
+  int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q, *qN, *qNN, *q1, *qN1, *qNN1, *q2, *qN2, *qNN2,
+		   *q0 = (scaler_data_type *)dstPtr;
+  libspectrum_qword w[10];
+  libspectrum_signed_dword y[10], u[10], v[10];
+  FUNCTION( hq_lines ) lines;
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_HQ3x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                             height );
+    return;
+  }
+
+  for( j = 0; j < height; j++ ) {
+    p = p0;
+    q = q0;
+    q1 = q + 1; q2 = q + 2;
+    qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2;
+    qNN = qN + nextlineDst;  qNN1 = qNN + 1; qNN2 = qNN + 2;
+
+    FUNCTION( hq_next_line )( &lines, p0, nextlineSrc, width, j );
+
+    for( i = 0; i < width; i++ ) {
+      HQ_SIMD_FETCH( lines )
+
+#include "scaler_hq3x.c"
+
+      p++;
+      q   += 3; q1   += 3; q2   += 3;
+      qN  += 3; qN1  += 3; qN2  += 3;
+      qNN += 3; qNN1 += 3; qNN2 += 3;
+    }
+    p0 += nextlineSrc;
+    q0 += ( nextlineDst << 1 ) + nextlineDst;
+  }
+}
+
+void
+FUNCTION( scaler_HQ4x_simd ) ( const libspectrum_byte *srcPtr,
+                               libspectrum_dword srcPitch,
+                               libspectrum_byte *dstPtr,
+                               libspectrum_dword dstPitch,
+                               int width, int height )
+{
+  int i, j, pattern;
+  int nextlineSrc = srcPitch / sizeof( scaler_data_type );
+  const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
+  int nextlineDst = dstPitch / sizeof( scaler_data_type );
+  scaler_data_type *q,  *qN,  *qNN,  *qNNN,
+                   *q1, *qN1, *qNN1, *qNNN1,
+                   *q2, *qN2, *qNN2, *qNNN2,
+                   *q3, *qN3, *qNN3, *qNNN3,
+                   *q0 = (scaler_data_type *)dstPtr;
+  libspectrum_qword w[10];
+  libspectrum_signed_dword y[10], u[10], v[10];
+  FUNCTION( hq_lines ) lines;
+
+  if( width > SCALER_SIMD_MAX_WIDTH ) {
+    FUNCTION( scaler_HQ4x )( srcPtr, srcPitch, dstPtr, dstPitch, width,
+                             height );
+    return;
+  }
+
+  for( j = 0; j < height; j++ ) {
+    p = p0;
+    q = q0;
+    q1 = q + 1; q2 = q + 2; q3 = q + 3;
+    qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2; qN3 = qN + 3;
+    qNN = qN + nextlineDst; qNN1 = qNN + 1; qNN2 = qNN + 2; qNN3 = qNN + 3;
+    qNNN = qNN + nextlineDst; qNNN1 = qNNN + 1; qNNN2 = qNNN + 2; qNNN3 = qNNN + 3;
+
+    FUNCTION( hq_next_line )( &lines, p0, nextlineSrc, width, j );
+
+    for( i = 0; i < width; i++ ) {
+      HQ_SIMD_FETCH( lines )
+
+#include "scaler_hq4x.c"
+
+      p++;
+      q    += 4; q1    += 4; q2    += 4; q3    += 4;
+      qN   += 4; qN1   += 4; qN2   += 4; qN3   += 4;
+      qNN  += 4; qNN1  += 4; qNN2  += 4; qNN3  += 4;
+      qNNN += 4; qNNN1 += 4; qNNN2 += 4; qNNN3 += 4;
+    }
+    p0 += nextlineSrc;
+    q0 += ( nextlineDst << 2 );
+  }
+}
@@ -536,7 +536,7 @@ sdl_blit_icon( SDL_Surface **icon,
   dst_h = h;
   dst_x = x * sdldisplay_current_size + fullscreen_x_off;
 
-  scaler_proc16(
+  scaler_run( scaler_proc16,
 	(libspectrum_byte*)tmp_screen->pixels +
 			(x+1) * tmp_screen->format->BytesPerPixel +
 	                (y+1) * tmp_screen_pitch,
@@ -797,7 +797,7 @@ uidisplay_frame_end( void )
     int dst_h = r->h;
     int dst_x = r->x * sdldisplay_current_size + fullscreen_x_off;
 
-    scaler_proc16(
+    scaler_run( scaler_proc16,
       (libspectrum_byte*)tmp_screen->pixels +
                         (r->x+1) * tmp_screen->format->BytesPerPixel +
 	                (r->y+1)*tmp_screen_pitch,
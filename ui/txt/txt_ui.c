@@ -23,6 +23,10 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include "compat.h"
+#include "display.h"
 #include "keyboard.h"
 #include "ui/ui.h"
 
@@ -136,11 +140,87 @@ static int txt_output_enabled = 1;
 
 static libspectrum_word image[DISPLAY_SCREEN_HEIGHT][DISPLAY_SCREEN_WIDTH];
 
+/* How pixels map onto character cells */
+typedef struct txt_glyph_mode {
+    const char *name;
+    int width, height;          /* Pixels per cell */
+    uint32_t (*glyph)(int mask);/* Glyph for the foreground pixels in mask,
+                                   numbered across then down */
+} txt_glyph_mode;
+
+static uint32_t halfblock_glyph(int mask) {
+    /* Only the bottom pixel can differ from the background */
+    return mask ? 0x2584 : ' ';       /* LOWER HALF BLOCK */
+}
+
+static uint32_t quadrant_glyph(int mask) {
+    static const uint32_t quadrants[16] = {
+        ' ',    0x2598, 0x259d, 0x2580, 0x2596, 0x258c, 0x259e, 0x259b,
+        0x2597, 0x259a, 0x2590, 0x259c, 0x2584, 0x2599, 0x259f, 0x2588,
+    };
+    return quadrants[mask];
+}
+
+static uint32_t braille_glyph(int mask) {
+    /* Braille numbers its dots down the left column, then down the right,
+       with the bottom row added afterwards */
+    static const int dots[8] = { 0x01, 0x08, 0x02, 0x10, 0x04, 0x20,
+                                 0x40, 0x80 };
+    uint32_t ch = 0x2800;
+    for (int i = 0; i < 8; i++) {
+        if (mask & (1 << i)) ch |= dots[i];
+    }
+    return ch;
+}
+
+static const txt_glyph_mode glyph_modes[] = {
+    { "halfblock", 1, 2, halfblock_glyph },
+    { "quadrant",  2, 2, quadrant_glyph },
+    { "braille",   2, 4, braille_glyph },
+};
+
+static int glyph_mode = 0;
+
+/* What we last handed to termbox for each cell */
+typedef struct txt_cell {
+    uint32_t ch;
+    uintattr_t fg, bg;
+} txt_cell;
+
+static txt_cell shadow_cells[DISPLAY_SCREEN_HEIGHT / 2][DISPLAY_ASPECT_WIDTH];
+static int cells_changed = 0;
+
+/* tb_present() calls taking longer than this, in seconds, mean the
+   terminal isn't keeping up */
+#define TXT_PRESENT_SLOW 0.01
+#define TXT_MAX_PRESENT_INTERVAL 25
+
+static int present_interval = 1;        /* Frames between tb_present()s */
+static int frames_since_present = 0;
+
+static void shadow_invalidate(void) {
+    /* No glyph is ever 0, so every cell will be sent again */
+    memset(shadow_cells, 0, sizeof(shadow_cells));
+}
+
+static void glyph_mode_select(const char *name) {
+    glyph_mode = 0;
+    if (!name) return;
+    for (size_t i = 0; i < ARRAY_SIZE(glyph_modes); i++) {
+        if (!strcmp(glyph_modes[i].name, name)) {
+            glyph_mode = i;
+            return;
+        }
+    }
+    ui_error(UI_ERROR_WARNING, "unknown txt glyph mode '%s'", name);
+}
+
 static int pressed = 0;
 static int log_message_y = 0;
 
 void log_message_reset() {
-    log_message_y = txt_output_enabled ? (240 / 2 + 1) : 0;
+    log_message_y = txt_output_enabled ?
+        (DISPLAY_SCREEN_HEIGHT / glyph_modes[glyph_mode].height + 1) : 0;
 }
 
 void log_message(const char *fmt, ...) {
@@ -160,6 +240,8 @@ int ui_init(int *argc, char ***argv) {
     // if (txt_output_enabled) {
         tb_init();
         tb_set_output_mode(TB_OUTPUT_216);
+        glyph_mode_select(settings_current.txt_glyphs);
+        shadow_invalidate();
         log_message_reset();
     // }
     display_ui_initialised = 1;
@@ -306,36 +388,94 @@ int ui_mouse_release(int suspend) {
 //   return 0;
 // }
 
+/* Work out the glyph and colours for the cell whose top left pixel is at
+   (x, y). The terminal can show only two colours per cell, so the top
+   left pixel gives the background and the first pixel of any other colour
+   the foreground */
+static void cell_render(int x, int y, txt_cell *cell) {
+    const txt_glyph_mode *mode = &glyph_modes[glyph_mode];
+    int bg = image[y][x], fg = bg, mask = 0, bit = 0;
+
+    for (int yy = y; yy < y + mode->height; yy++) {
+        for (int xx = x; xx < x + mode->width; xx++, bit++) {
+            int colour = image[yy][xx];
+            if (colour == bg) continue;
+            if (fg == bg) fg = colour;
+            if (colour == fg) mask |= 1 << bit;
+        }
+    }
+
+    /* Keep blank cells in one form, so a change of a colour nobody can
+       see doesn't count as a change */
+    if (!mask) fg = bg;
+
+    cell->ch = mode->glyph(mask);
+    cell->fg = PALETTE[fg];
+    cell->bg = PALETTE[bg];
+}
+
 void uidisplay_area(int x, int y, int w, int h) {
+    const txt_glyph_mode *mode = &glyph_modes[glyph_mode];
+    txt_cell cell, *shadow;
+
     if (!txt_output_enabled) {
         return;
     }
-    int ink, paper;
-    int y2 = y + h;
-    y -= (y % 2);
-    y2 += (y2 % 2);
-    for (int yy = y; yy < y2; yy += 2) {
-        libspectrum_word *ptr1 = &image[yy][x];
-        libspectrum_word *ptr2 = &image[yy + 1][x];
-        int xx = x;
-        while (xx < w + x) {
-        ink = *ptr1;
-        paper = *ptr2;
-        if (paper == ink) {
-            tb_set_cell(xx, yy / 2, ' ', PALETTE[ink], PALETTE[paper]);
-        } else {
-            tb_set_cell(xx, yy / 2, L'▀', PALETTE[ink], PALETTE[paper]);
-        }
-        ++xx;
-        ++ptr1;
-        ++ptr2;
+
+    int x2 = x + w, y2 = y + h;
+    x -= x % mode->width;
+    y -= y % mode->height;
+    if (x2 > DISPLAY_ASPECT_WIDTH) x2 = DISPLAY_ASPECT_WIDTH;
+    if (y2 > DISPLAY_SCREEN_HEIGHT) y2 = DISPLAY_SCREEN_HEIGHT;
+
+    /* Only cells which actually look different are handed to termbox, so
+       its diff against the terminal, and what goes down the wire, stays
+       as small as possible */
+    for (int yy = y; yy < y2; yy += mode->height) {
+        for (int xx = x; xx < x2; xx += mode->width) {
+            cell_render(xx, yy, &cell);
+            shadow = &shadow_cells[yy / mode->height][xx / mode->width];
+            if (cell.ch == shadow->ch && cell.fg == shadow->fg &&
+                cell.bg == shadow->bg) {
+                continue;
+            }
+            *shadow = cell;
+            tb_set_cell(xx / mode->width, yy / mode->height, cell.ch, cell.fg,
+                        cell.bg);
+            cells_changed++;
         }
     }
 }
 
 void uidisplay_frame_end(void) {
-    if (txt_output_enabled) {
-        tb_present();
+    double start, elapsed;
+
+    if (!txt_output_enabled) {
+        return;
+    }
+
+    frames_since_present++;
+    if (!cells_changed || frames_since_present < present_interval) {
+        return;
+    }
+
+    start = timer_get_time();
+    tb_present();
+    elapsed = timer_get_time() - start;
+
+    cells_changed = 0;
+    frames_since_present = 0;
+
+    /* Writes to the terminal block once its link is congested, so a slow
+       tb_present() means we should send updates less often. Frames in
+       between aren't lost: their changes are merged into the next one */
+    if (elapsed > TXT_PRESENT_SLOW) {
+        present_interval *= 2;
+        if (present_interval > TXT_MAX_PRESENT_INTERVAL) {
+            present_interval = TXT_MAX_PRESENT_INTERVAL;
+        }
+    } else if (elapsed < TXT_PRESENT_SLOW / 4 && present_interval > 1) {
+        present_interval--;
     }
 }
 
@@ -35,10 +35,16 @@
 // ./configure --with-uiext --with-pyext --without-zlib --without-png --with-pic --with-roms-dir=roms
 // make
 
+#include <cstdio>       // fflush
+#include <array>
+#include <cctype>       // tolower
+#include <cstring>      // memcpy
 #include <ios>
 #include <string>       // std::string
 #include <iostream>     // std::cout
 #include <sstream>      // std::stringstream
+#include <stdexcept>    // std::invalid_argument
+#include <vector>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -48,6 +54,7 @@
 extern "C" {
 
 #include "libspectrum.h"
+#include "../../display.h"
 #include "../../machine.h"
 #include "../../loader.h"
 #include "../../z80/z80.h"
@@ -56,7 +63,12 @@ extern "C" {
 #include "../../settings.h"
 #include "../../timer/timer.h"
 #include "../../snapshot.h"
+#include "../../statehash.h"
 #include "../../fuse.h"
+#include "../../inputlog.h"
+#include "../../inputseq.h"
+#include "../../rawdump.h"
+#include "../../peripherals/nic/vnet.h"
 
 extern int fuse_exiting;		/* Shall we exit now? */
 
@@ -64,6 +76,8 @@ int fuse_init(int argc, char **argv);
 int fuse_end(void);
 int unittests_run(void);
 int event_do_events(void);
+const libspectrum_byte* uiext_image(int *width, int *height);
+const char* uiext_fork_prepare(void);
 
 }
 
@@ -88,6 +102,121 @@ using ram_page_t = std::array<libspectrum_byte, 0x4000>;
 // typedef libspectrum_byte ram_pages_t[ SPECTRUM_RAM_PAGES ][0x4000];
 
 
+// A warmed-up machine state (machine, RAM, registers, peripherals) kept in
+// memory, so environments can be started from it over and over without
+// going through fuse_init(), config parsing or the filesystem again
+class State {
+public:
+    State() : snap_(libspectrum_snap_alloc()) {}
+
+    ~State() {
+        libspectrum_snap_free(snap_);
+    }
+
+    State(const State&) = delete;
+    State& operator=(const State&) = delete;
+
+    libspectrum_snap* snap() const {
+        return snap_;
+    }
+
+    // SZX image of the state, to hand over to other processes
+    pybind11::bytes ToBytes() const {
+        libspectrum_byte *buffer = nullptr;
+        size_t length = 0;
+        int flags;
+        check_status(libspectrum_snap_write(&buffer, &length, &flags, snap_,
+                                            LIBSPECTRUM_ID_SNAPSHOT_SZX,
+                                            fuse_creator, 0));
+        pybind11::bytes result(reinterpret_cast<const char*>(buffer), length);
+        libspectrum_free(buffer);
+        return result;
+    }
+
+    static std::unique_ptr<State> FromBytes(const std::string &data) {
+        std::unique_ptr<State> state(new State());
+        check_status(libspectrum_snap_read(state->snap_,
+                                           reinterpret_cast<const libspectrum_byte*>(data.data()),
+                                           data.size(), LIBSPECTRUM_ID_SNAPSHOT_SZX,
+                                           nullptr));
+        return state;
+    }
+
+private:
+    libspectrum_snap* snap_;
+};
+
+
+// A packet on the virtual network, as the peer sees it. Ports are plain
+// numbers; IP addresses are four bytes, most significant first
+struct VnetPacket {
+    vnet_packet_type type = VNET_PACKET_UDP;
+    std::array<libspectrum_byte, 4> src_ip {};
+    libspectrum_word src_port = 0;
+    std::array<libspectrum_byte, 4> dst_ip {};
+    libspectrum_word dst_port = 0;
+    std::string data;
+};
+
+
+// One step of an input sequence, as a script describes it. Keys are single
+// characters ('a' to 'z', '0' to '9' and ' ') or "enter", "caps" and
+// "symbol"; an empty mouse state leaves the mouse alone
+struct InputStep {
+    libspectrum_dword frames = 1;
+    std::vector<std::string> keys;
+    std::array<libspectrum_byte, JOYSTICK_STATE_LENGTH> joystick {{ 0x00, 0x00, 0x00, 0xff }};
+    std::vector<libspectrum_byte> mouse;
+    inputseq_wait wait = INPUTSEQ_WAIT_NONE;
+    libspectrum_word address = 0;
+    libspectrum_byte value = 0;
+    libspectrum_byte mask = 0xff;
+    libspectrum_dword settle = 0;
+    libspectrum_dword timeout = 0;
+};
+
+keyboard_key_name key_from_name(const std::string &name) {
+    std::string lower;
+    for (char c : name) {
+        lower += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    if (lower.size() == 1) {
+        char c = lower[0];
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == ' ') {
+            return static_cast<keyboard_key_name>(c);
+        }
+    }
+    if (lower == "enter") return KEYBOARD_Enter;
+    if (lower == "caps") return KEYBOARD_Caps;
+    if (lower == "symbol") return KEYBOARD_Symbol;
+    throw std::invalid_argument("Unknown Spectrum key '" + name + "'");
+}
+
+inputseq_step to_inputseq_step(const InputStep &a) {
+    inputseq_step step;
+    inputseq_step_init(&step);
+    step.frames = a.frames;
+    for (const std::string &key : a.keys) {
+        inputseq_step_press(&step, key_from_name(key));
+    }
+    memcpy(step.joystick, a.joystick.data(), JOYSTICK_STATE_LENGTH);
+    if (!a.mouse.empty()) {
+        if (a.mouse.size() != KEMPMOUSE_STATE_LENGTH) {
+            throw std::invalid_argument("Mouse state must be (x, y, buttons)");
+        }
+        step.mouse = 1;
+        memcpy(step.mouse_state, a.mouse.data(), KEMPMOUSE_STATE_LENGTH);
+    }
+    step.wait = a.wait;
+    step.address = a.address;
+    step.value = a.value;
+    step.mask = a.mask;
+    step.settle = a.settle;
+    step.timeout = a.timeout;
+    return step;
+}
+
+
 class Fuzx {
 public:
     static Fuzx& Instance() {
@@ -151,6 +280,25 @@ public:
         return reinterpret_cast<std::array<libspectrum_byte, 6912>&>(page);
     }
 
+    // The whole display as last drawn, border included, one byte per pixel
+    pybind11::bytes GetImage() const {
+        int width, height;
+        const libspectrum_byte *image = uiext_image(&width, &height);
+        std::string pixels;
+        pixels.reserve(width * height);
+        for (int y = 0; y < height; y++) {
+            pixels.append(reinterpret_cast<const char*>(image + y * DISPLAY_SCREEN_WIDTH),
+                          width);
+        }
+        return pybind11::bytes(pixels);
+    }
+
+    std::pair<int, int> GetImageSize() const {
+        int width, height;
+        uiext_image(&width, &height);
+        return std::make_pair(width, height);
+    }
+
     void LoadTape(const std::string &filename, bool autoload) const {
         std::cerr << "Fuzx load tape " << filename << std::endl;
         check_status(tape_open(filename.c_str(), autoload));
@@ -168,6 +316,160 @@ public:
         fuse_emulation_unpause();
     }
 
+    // Take a template of the current state; restoring it is a soft reset
+    // plus a copy of the RAM pages, with ROMs and contention tables coming
+    // from the caches kept by machine_reset()
+    std::unique_ptr<State> CaptureState() const {
+        std::unique_ptr<State> state(new State());
+        check_status(snapshot_copy_to(state->snap()));
+        return state;
+    }
+
+    void RestoreState(const State &state) const {
+        check_status(snapshot_copy_from(state.snap()));
+    }
+
+    // Uncompressed SZX image of the current state, to use as the base for
+    // SaveDelta() and LoadDelta()
+    pybind11::bytes SaveBase() const {
+        libspectrum_byte *buffer = nullptr;
+        size_t length = 0;
+        check_status(snapshot_write_base(&buffer, &length));
+        pybind11::bytes result(reinterpret_cast<const char*>(buffer), length);
+        libspectrum_free(buffer);
+        return result;
+    }
+
+    pybind11::bytes SaveDelta(const std::string &base) const {
+        std::string delta;
+        check_status(snapshot_delta_write(AppendDelta, &delta,
+                                          reinterpret_cast<const libspectrum_byte*>(base.data()),
+                                          base.size()));
+        return pybind11::bytes(delta);
+    }
+
+    void LoadDelta(const std::string &base, const std::string &delta) const {
+        DeltaReader reader = { &delta, 0 };
+        check_status(snapshot_delta_read(ReadDelta, &reader,
+                                         reinterpret_cast<const libspectrum_byte*>(base.data()),
+                                         base.size()));
+    }
+
+    void StartInputRecording(const std::string &filename,
+                             libspectrum_dword hash_interval) const {
+        check_status(inputlog_start_recording(filename.c_str(), hash_interval));
+    }
+
+    void StopInputRecording() const {
+        check_status(inputlog_stop_recording());
+    }
+
+    // Play an input log back as fast as possible; returns the frame at
+    // which the emulation diverged from the recording, or -1
+    long ReplayInputLog(const std::string &filename) const {
+        check_status(inputlog_start_playback(filename.c_str()));
+        while (inputlog_playback && !fuse_exiting) {
+            DoOpcodes();
+            DoEvents();
+        }
+        return inputlog_divergence();
+    }
+
+    // Start running an input sequence; it runs from the end of each frame
+    // without any further help from the script
+    void StartInputSequence(const std::vector<InputStep> &steps) const {
+        std::vector<inputseq_step> converted;
+        for (const InputStep &step : steps) {
+            converted.push_back(to_inputseq_step(step));
+        }
+        check_status(inputseq_start(converted.data(), converted.size()));
+    }
+
+    void StopInputSequence() const {
+        inputseq_stop();
+    }
+
+    bool IsInputSequenceActive() const {
+        return inputseq_active;
+    }
+
+    // Run an input sequence to the end as fast as possible; returns the
+    // step which timed out, or -1
+    long RunInputSequence(const std::vector<InputStep> &steps) const {
+        StartInputSequence(steps);
+        while (inputseq_active && !fuse_exiting) {
+            DoOpcodes();
+            DoEvents();
+        }
+        return inputseq_timed_out();
+    }
+
+    // Stream raw frames and sound to a file, a `|command' pipe or, if
+    // ring_size is non-zero, a memory mapped ring of that many megabytes
+    void StartRawDump(const std::string &target, libspectrum_dword ring_size) const {
+        check_status(rawdump_start(target.c_str(), ring_size));
+    }
+
+    void StopRawDump() const {
+        rawdump_stop();
+    }
+
+    libspectrum_qword GetStateHash() const {
+        return statehash_full();
+    }
+
+    libspectrum_qword GetRAMHash() const {
+        return statehash_ram();
+    }
+
+    // Clone the whole warmed-up emulator into a child process, which
+    // shares the ROM and RAM pages copy-on-write; returns as os.fork() does.
+    // Refuses while anything needing a thread of its own is running
+    int Fork() const {
+        const char *reason = uiext_fork_prepare();
+        if (reason) throw std::runtime_error(reason);
+
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        return pybind11::module_::import("os").attr("fork")().cast<int>();
+    }
+
+    // Send a packet to the machine over the virtual network; it arrives
+    // settings.virtual_network_latency tstates from now
+    void VnetSend(const VnetPacket &packet) const {
+        vnet_packet p;
+        memset(&p, 0, sizeof(p));
+        p.type = packet.type;
+        memcpy(p.src_ip, packet.src_ip.data(), 4);
+        p.src_port = packet.src_port;
+        memcpy(p.dst_ip, packet.dst_ip.data(), 4);
+        p.dst_port = packet.dst_port;
+        p.data = reinterpret_cast<libspectrum_byte*>(const_cast<char*>(packet.data.data()));
+        p.length = packet.data.size();
+        vnet_send(VNET_NODE_MACHINE, &p);
+    }
+
+    // Everything which has arrived from the machine since the last call.
+    // Relaying these to another forked Fuzx between frames, and its packets
+    // back here, connects the two machines
+    std::vector<VnetPacket> VnetReceive() const {
+        std::vector<VnetPacket> packets;
+        vnet_packet *p;
+        while ((p = vnet_peer_receive()) != nullptr) {
+            VnetPacket packet;
+            packet.type = p->type;
+            memcpy(packet.src_ip.data(), p->src_ip, 4);
+            packet.src_port = p->src_port;
+            memcpy(packet.dst_ip.data(), p->dst_ip, 4);
+            packet.dst_port = p->dst_port;
+            packet.data.assign(reinterpret_cast<const char*>(p->data), p->length);
+            packets.push_back(std::move(packet));
+            vnet_packet_free(p);
+        }
+        return packets;
+    }
+
     settings_info& GetSettings() const {
         return settings_current;
     }
@@ -211,6 +513,26 @@ private:
         fuse_init(1, argv);
     }
 
+    struct DeltaReader {
+        const std::string *data;
+        size_t position;
+    };
+
+    static int AppendDelta(const libspectrum_byte *data, size_t length, void *context) {
+        static_cast<std::string*>(context)->append(reinterpret_cast<const char*>(data), length);
+        return 0;
+    }
+
+    static int ReadDelta(libspectrum_byte *data, size_t length, void *context) {
+        DeltaReader *reader = static_cast<DeltaReader*>(context);
+        if (reader->data->size() - reader->position < length) {
+            return 1;
+        }
+        memcpy(data, reader->data->data() + reader->position, length);
+        reader->position += length;
+        return 0;
+    }
+
     static std::unique_ptr<Fuzx> Instance_;
 };
 
@@ -388,8 +710,10 @@ PYBIND11_MODULE(fuzx, m) {
         .def_readwrite("accelerate_loader", &settings_info::accelerate_loader)
         .def_readwrite("auto_load", &settings_info::auto_load)
         .def_readwrite("detect_loader", &settings_info::detect_loader)
+        .def_readwrite("disk_traps", &settings_info::disk_traps)
         .def_readwrite("emulation_speed", &settings_info::emulation_speed)
         .def_readwrite("fastload", &settings_info::fastload)
+        .def_readwrite("flash_load", &settings_info::flash_load)
         .def_readwrite("frame_rate", &settings_info::frame_rate)
         .def_readwrite("gdbserver_enable", &settings_info::gdbserver_enable)
         .def_readwrite("gdbserver_port", &settings_info::gdbserver_port)
@@ -401,6 +725,9 @@ PYBIND11_MODULE(fuzx, m) {
         .def_readwrite("slt_traps", &settings_info::slt_traps)
         .def_readwrite("sound", &settings_info::sound)
         .def_readwrite("tape_traps", &settings_info::tape_traps)
+        .def_readwrite("turbo_disk", &settings_info::turbo_disk)
+        .def_readwrite("virtual_network", &settings_info::virtual_network)
+        .def_readwrite("virtual_network_latency", &settings_info::virtual_network_latency)
         .def("__repr__", [](const settings_info &a) {
             return "<Settings frame_rate=" + std::to_string(a.frame_rate)
                     + " emulation_speed=" + std::to_string(a.emulation_speed)
@@ -412,6 +739,113 @@ PYBIND11_MODULE(fuzx, m) {
         })
         ;
 
+    py::enum_<vnet_packet_type>(m, "VnetPacketType")
+        .value("Ethernet",    VNET_PACKET_ETHERNET)
+        .value("UDP",         VNET_PACKET_UDP)
+        .value("TCPConnect",  VNET_PACKET_TCP_CONNECT)
+        .value("TCPData",     VNET_PACKET_TCP_DATA)
+        .value("TCPClose",    VNET_PACKET_TCP_CLOSE)
+        ;
+
+    py::class_<VnetPacket>(m, "VnetPacket")
+        .def(py::init([](vnet_packet_type type, const std::string &data,
+                         std::array<libspectrum_byte, 4> src_ip, libspectrum_word src_port,
+                         std::array<libspectrum_byte, 4> dst_ip, libspectrum_word dst_port) {
+                 VnetPacket packet;
+                 packet.type = type;
+                 packet.data = data;
+                 packet.src_ip = src_ip;
+                 packet.src_port = src_port;
+                 packet.dst_ip = dst_ip;
+                 packet.dst_port = dst_port;
+                 return packet;
+             }),
+             py::arg("type"), py::arg("data") = std::string(),
+             py::arg("src_ip") = std::array<libspectrum_byte, 4> {},
+             py::arg("src_port") = 0,
+             py::arg("dst_ip") = std::array<libspectrum_byte, 4> {},
+             py::arg("dst_port") = 0)
+        .def("__repr__", [](const VnetPacket &a) {
+            return "<VnetPacket type=" + std::to_string(a.type)
+                    + " src_port=" + std::to_string(a.src_port)
+                    + " dst_port=" + std::to_string(a.dst_port)
+                    + " length=" + std::to_string(a.data.size())
+                    + ">";
+        })
+        .def_readwrite("type", &VnetPacket::type)
+        .def_readwrite("src_ip", &VnetPacket::src_ip)
+        .def_readwrite("src_port", &VnetPacket::src_port)
+        .def_readwrite("dst_ip", &VnetPacket::dst_ip)
+        .def_readwrite("dst_port", &VnetPacket::dst_port)
+        .def_property("data", [](const VnetPacket &a) {
+            return pybind11::bytes(a.data);
+        }, [](VnetPacket &a, const std::string &data) {
+            a.data = data;
+        })
+        ;
+
+    py::enum_<inputseq_wait>(m, "InputWait")
+        .value("Nothing",     INPUTSEQ_WAIT_NONE)
+        .value("PC",          INPUTSEQ_WAIT_PC)
+        .value("Memory",      INPUTSEQ_WAIT_MEMORY)
+        .value("Screen",      INPUTSEQ_WAIT_SCREEN)
+        ;
+
+    py::class_<InputStep>(m, "InputStep")
+        .def(py::init([](libspectrum_dword frames, const std::vector<std::string> &keys,
+                         std::array<libspectrum_byte, JOYSTICK_STATE_LENGTH> joystick,
+                         const std::vector<libspectrum_byte> &mouse, inputseq_wait wait,
+                         libspectrum_word address, libspectrum_byte value,
+                         libspectrum_byte mask, libspectrum_dword settle,
+                         libspectrum_dword timeout) {
+                 InputStep step;
+                 step.frames = frames;
+                 step.keys = keys;
+                 step.joystick = joystick;
+                 step.mouse = mouse;
+                 step.wait = wait;
+                 step.address = address;
+                 step.value = value;
+                 step.mask = mask;
+                 step.settle = settle;
+                 step.timeout = timeout;
+                 to_inputseq_step(step);    // Check the keys now, not when started
+                 return step;
+             }),
+             py::arg("frames") = 1, py::arg("keys") = std::vector<std::string>(),
+             py::arg("joystick") = std::array<libspectrum_byte, JOYSTICK_STATE_LENGTH> {{ 0x00, 0x00, 0x00, 0xff }},
+             py::arg("mouse") = std::vector<libspectrum_byte>(),
+             py::arg("wait") = INPUTSEQ_WAIT_NONE, py::arg("address") = 0,
+             py::arg("value") = 0, py::arg("mask") = 0xff, py::arg("settle") = 0,
+             py::arg("timeout") = 0)
+        .def("__repr__", [](const InputStep &a) {
+            std::string keys;
+            for (const std::string &key : a.keys) {
+                keys += (keys.empty() ? "" : ",") + key;
+            }
+            return "<InputStep frames=" + std::to_string(a.frames)
+                    + " keys=" + keys
+                    + " wait=" + std::to_string(a.wait)
+                    + " timeout=" + std::to_string(a.timeout)
+                    + ">";
+        })
+        .def_readwrite("frames", &InputStep::frames)
+        .def_readwrite("keys", &InputStep::keys)
+        .def_readwrite("joystick", &InputStep::joystick)
+        .def_readwrite("mouse", &InputStep::mouse)
+        .def_readwrite("wait", &InputStep::wait)
+        .def_readwrite("address", &InputStep::address)
+        .def_readwrite("value", &InputStep::value)
+        .def_readwrite("mask", &InputStep::mask)
+        .def_readwrite("settle", &InputStep::settle)
+        .def_readwrite("timeout", &InputStep::timeout)
+        ;
+
+    py::class_<State>(m, "State")
+        .def("to_bytes", &State::ToBytes, "Serialise the state as an SZX snapshot")
+        .def_static("from_bytes", &State::FromBytes, "Create a state from an SZX snapshot", py::arg("data"))
+        ;
+
     py::class_<Fuzx>(m, "Fuzx")
         .def_static("machine", &Fuzx::Instance, "Get Fuzx instance",
                     py::return_value_policy::reference)
@@ -426,6 +860,41 @@ PYBIND11_MODULE(fuzx, m) {
         .def("ram_page", &Fuzx::GetRAMPage, "Get RAM page", py::return_value_policy::reference)
         .def_property_readonly("screen_page_num", &Fuzx::GetScreenPageNum, "Get screen page")
         .def_property_readonly("screen_data", &Fuzx::GetScreenData, "Get screen data", py::return_value_policy::reference)
+        .def_property_readonly("image", &Fuzx::GetImage,
+                               "Get the display, one colour from 0 to 15 per pixel")
+        .def_property_readonly("image_size", &Fuzx::GetImageSize,
+                               "Get the display's (width, height); 640 wide on Timex machines, else 320")
+        .def("capture_state", &Fuzx::CaptureState, "Capture the current state as a template")
+        .def("restore_state", &Fuzx::RestoreState, "Restore a state captured earlier", py::arg("state"))
+        .def("save_base", &Fuzx::SaveBase, "Save the current state as a base for delta states")
+        .def("save_delta", &Fuzx::SaveDelta, "Save the current state as a delta from a base", py::arg("base"))
+        .def("load_delta", &Fuzx::LoadDelta, "Load a state saved as a delta from a base",
+             py::arg("base"), py::arg("delta"))
+        .def("start_input_recording", &Fuzx::StartInputRecording,
+             "Start recording the inputs to a log",
+             py::arg("filename"), py::arg("hash_interval") = INPUTLOG_HASH_INTERVAL)
+        .def("stop_input_recording", &Fuzx::StopInputRecording, "Stop recording the inputs and write the log")
+        .def("replay_input_log", &Fuzx::ReplayInputLog,
+             "Replay an input log, returning the frame it diverged at or -1", py::arg("filename"))
+        .def("start_input_sequence", &Fuzx::StartInputSequence,
+             "Start running a sequence of input steps at the end of each frame", py::arg("steps"))
+        .def("stop_input_sequence", &Fuzx::StopInputSequence, "Stop the running input sequence")
+        .def_property_readonly("is_input_sequence_active", &Fuzx::IsInputSequenceActive,
+                               "Is an input sequence running")
+        .def("run_input_sequence", &Fuzx::RunInputSequence,
+             "Run a sequence of input steps to the end, returning the step which timed out or -1",
+             py::arg("steps"))
+        .def("start_raw_dump", &Fuzx::StartRawDump,
+             "Start streaming raw frames and sound for an external encoder",
+             py::arg("target"), py::arg("ring_size") = 0)
+        .def("stop_raw_dump", &Fuzx::StopRawDump, "Stop streaming raw frames and sound")
+        .def_property_readonly("state_hash", &Fuzx::GetStateHash, "Hash of the whole machine state")
+        .def_property_readonly("ram_hash", &Fuzx::GetRAMHash, "Hash of the RAM contents only")
+        .def("vnet_send", &Fuzx::VnetSend, "Send a packet to the machine over the virtual network",
+             py::arg("packet"))
+        .def("vnet_receive", &Fuzx::VnetReceive,
+             "Get the packets the machine has sent over the virtual network")
+        .def("fork", &Fuzx::Fork, "Fork the warmed-up emulator, returning the child's pid or 0 in the child; fails while recording a movie, running the gdbserver or using the Spectranet")
         .def("load_tape", &Fuzx::LoadTape, "Load tape", py::arg("filename"), py::arg("autoload") = 1)
         .def("load_tape_wait", &Fuzx::LoadTapeWait, "Load tape and wait for fast loading", py::arg("filename"))
         .def_property_readonly("settings", &Fuzx::GetSettings, "Get settings", py::return_value_policy::reference)
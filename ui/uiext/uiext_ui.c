@@ -28,9 +28,17 @@
 
 #include "../uijoystick.c"
 
+#include "debugger/debugger.h"
+#include "display.h"
 #include "fuse.h"
+#include "machine.h"
+#include "movie.h"
 #include "settings.h"
 #include "timer/timer.h"
+#include "ui/scaler/scaler.h"
+#ifdef BUILD_SPECTRANET
+#include "peripherals/nic/w5100.h"
+#endif
 
 // keysyms_map_t keysyms_map[] = {
 //   { 0, 0 } /* End marker */
@@ -97,8 +105,38 @@
 //   return 0;
 // }
 
-static libspectrum_word fuzx_image[DISPLAY_SCREEN_HEIGHT][DISPLAY_SCREEN_WIDTH];
+/* One byte per pixel, each a colour from 0 to 15. As with a raw dump, a
+   Timex frame is 640 pixels wide and anything else 320, but lines are
+   never doubled */
+static libspectrum_byte fuzx_image[DISPLAY_SCREEN_HEIGHT][DISPLAY_SCREEN_WIDTH];
 
+const libspectrum_byte* uiext_image(int *width, int *height) {
+    *width = machine_current && machine_current->timex ?
+             DISPLAY_SCREEN_WIDTH : DISPLAY_ASPECT_WIDTH;
+    *height = DISPLAY_SCREEN_HEIGHT;
+    return &fuzx_image[0][0];
+}
+
+
+/* Only the thread calling fork() exists in the child, while every mutex,
+   condition variable and queue other threads were using is copied in
+   whatever state it was in. Returns why the emulator can't be forked
+   right now, or NULL once it's safe to */
+const char* uiext_fork_prepare(void) {
+    if (movie_recording)
+        return "can't fork while a movie is being recorded";
+    if (gdbserver_debugging_enabled)
+        return "can't fork while the gdbserver is running";
+#ifdef BUILD_SPECTRANET
+    if (nic_w5100_io_active())
+        return "can't fork while the Spectranet's network thread is running";
+#endif
+
+    /* The scaler's workers are started again when they're next needed */
+    scaler_end();
+
+    return NULL;
+}
 
 int ui_init(int *argc, char ***argv) {
     return 0;
@@ -227,27 +265,29 @@ int uidisplay_end(void) {
     return 0;
 }
 
+/* Timex hi-res: sixteen pixels at ( (16*x), y ) */
 void uidisplay_plot16(int x, int y, libspectrum_word data, libspectrum_byte ink,
                       libspectrum_byte paper) {
-  /* Do nothing */
+    libspectrum_byte *dest = &fuzx_image[y][x << 4];
+    display_expand8(dest, data >> 8, ink, paper);
+    display_expand8(dest + 8, data & 0xff, ink, paper);
 }
 
 void uidisplay_plot8(int x, int y, libspectrum_byte data, libspectrum_byte ink,
                      libspectrum_byte paper) {
-    x <<= 3;
-    libspectrum_word *dest = &fuzx_image[y][x];
-    *(dest++) = (data & 0x80) ? ink : paper;
-    *(dest++) = (data & 0x40) ? ink : paper;
-    *(dest++) = (data & 0x20) ? ink : paper;
-    *(dest++) = (data & 0x10) ? ink : paper;
-    *(dest++) = (data & 0x08) ? ink : paper;
-    *(dest++) = (data & 0x04) ? ink : paper;
-    *(dest++) = (data & 0x02) ? ink : paper;
-    *dest = (data & 0x01) ? ink : paper;
+    if (machine_current->timex) {
+        display_expand8_double(&fuzx_image[y][x << 4], data, ink, paper);
+    } else {
+        display_expand8(&fuzx_image[y][x << 3], data, ink, paper);
+    }
 }
 
 void uidisplay_putpixel(int x, int y, int colour) {
-    fuzx_image[y][x] = colour;
+    if (machine_current->timex) {
+        fuzx_image[y][2 * x] = fuzx_image[y][2 * x + 1] = colour;
+    } else {
+        fuzx_image[y][x] = colour;
+    }
 }
 
 void uidisplay_frame_save(void) {
@@ -28,6 +28,8 @@
 
 #include "debugger/debugger.h"
 #include "fuse.h"
+#include "inputseq.h"
+#include "loader.h"
 #include "machine.h"
 #include "mempool.h"
 #include "periph.h"
@@ -43,11 +45,15 @@
 #include "peripherals/if1.h"
 #include "peripherals/if2.h"
 #include "peripherals/multiface.h"
+#include "peripherals/nic/vnet.h"
 #include "peripherals/speccyboot.h"
 #include "peripherals/ttx2000s.h"
 #include "peripherals/ula.h"
 #include "peripherals/usource.h"
 #include "settings.h"
+#include "snapshot.h"
+#include "statehash.h"
+#include "ui/scaler/scaler.h"
 #include "unittests.h"
 
 static int
@@ -58,7 +64,7 @@ contention_test( void )
 
   for( i = 0; i < ULA_CONTENTION_SIZE; i++ ) {
     /* Naive, but it will do for now */
-    checksum += ula_contention[ i ] * ( i + 1 );
+    checksum += ula_contention_delay( ula_contention, i ) * ( i + 1 );
   }
 
   if( settings_current.late_timings ) {
@@ -140,6 +146,25 @@ contention_test( void )
     error = 1;
   }
 
+  /* Whether the tables came with Fuse or were built at reset, they must
+     agree with the machine's delay functions */
+  for( i = 0; i < ULA_CONTENTION_SIZE; i++ ) {
+    libspectrum_byte delay = 0, delay_no_mreq = 0;
+
+    if( i < machine_current->timings.tstates_per_frame ) {
+      delay = machine_current->ram.contend_delay( i );
+      delay_no_mreq = machine_current->ram.contend_delay_no_mreq( i );
+    }
+
+    if( ula_contention_delay( ula_contention, i ) != delay ||
+        ula_contention_delay( ula_contention_no_mreq, i ) != delay_no_mreq ) {
+      printf( "%s: contention test: tables differ at tstate %u\n",
+              fuse_progname, i );
+      error = 1;
+      break;
+    }
+  }
+
   return error;
 }
 
@@ -788,6 +813,13 @@ unittests_run( void )
   r += mempool_test();
   r += paging_test();
   r += debugger_disassemble_unittest();
+  r += loader_unittest();
+  r += statehash_unittest();
+  r += snapshot_delta_unittest();
+  r += scaler_simd_unittest();
+  r += scaler_threads_unittest();
+  r += vnet_unittest();
+  r += inputseq_unittest();
 
   printf("Final return value: %d (should be 0)\n", r);
 
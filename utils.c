@@ -468,6 +468,20 @@ utils_save_binary( libspectrum_word start, size_t length,
   return error;
 }
 
+libspectrum_qword
+utils_hash( libspectrum_qword hash, const libspectrum_byte *buffer,
+            size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ ) {
+    hash ^= buffer[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
 void
 utils_networking_init( void )
 {
@@ -59,6 +59,14 @@ int
 utils_save_binary( libspectrum_word start, size_t length,
                    const char *filename );
 
+/* 64-bit FNV-1a hash of `buffer', continuing from `hash'; start with
+   UTILS_HASH_INIT */
+#define UTILS_HASH_INIT 0xcbf29ce484222325ULL
+
+libspectrum_qword
+utils_hash( libspectrum_qword hash, const libspectrum_byte *buffer,
+            size_t length );
+
 void utils_networking_init( void );
 void utils_networking_end( void );
 
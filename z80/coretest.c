@@ -29,6 +29,7 @@
 #include <string.h>
 
 #include "fuse.h"
+#include "inputseq.h"
 #include "peripherals/disk/beta.h"
 #include "peripherals/disk/didaktik.h"
 #include "peripherals/disk/disciple.h"
@@ -381,6 +382,7 @@ ui_error( ui_error_level severity GCC_UNUSED, const char *format, ... )
 
 #include "debugger/debugger.h"
 #include "machine.h"
+#include "machines/specplus3.h"
 #include "peripherals/scld.h"
 #include "settings.h"
 
@@ -464,6 +466,20 @@ beta_unpage( void )
   abort();
 }
 
+int
+beta_disk_trap( void )
+{
+  /* Should never be called */
+  abort();
+}
+
+int
+specplus3_disk_trap( void )
+{
+  /* Should never be called */
+  abort();
+}
+
 int spectrum_frame_event = 0;
 
 int
@@ -603,6 +619,15 @@ startup_manager_register( startup_manager_module module,
 
 int svg_capture_active = 0;     /* SVG capture enabled? */
 
+int inputseq_pc_wait = 0;
+libspectrum_word inputseq_pc;
+
+void
+inputseq_pc_hit( void )
+{
+  abort();
+}
+
 void
 svg_capture( void )
 {
@@ -668,6 +693,7 @@ init_dummies( void )
   rzx_playback = 0;
   scld_last_dec.name.intdisable = 0;
   settings_current.slt_traps = 0;
+  settings_current.disk_traps = 0;
   settings_current.divide_enabled = 0;
   settings_current.divmmc_enabled = 0;
   settings_current.z80_is_cmos = 0;
@@ -2,6 +2,7 @@ SETUP_CHECK( profile, profile_active )
 SETUP_CHECK( rzx, rzx_playback )
 SETUP_CHECK( debugger, (debugger_mode != DEBUGGER_MODE_INACTIVE) || is_debugger_enabled() )
 SETUP_CHECK( beta, beta_available )
+SETUP_CHECK( disk_traps, settings_current.disk_traps )
 SETUP_CHECK( plusd, plusd_available )
 SETUP_CHECK( didaktik80, didaktik80_available )
 SETUP_CHECK( disciple, disciple_available )
@@ -22,4 +23,5 @@ SETUP_CHECK( spectranet_unpage, spectranet_available )
 SETUP_CHECK( z80_iff2_read, z80.iff2_read )
 SETUP_CHECK( didaktik80snap, didaktik80_snap )
 SETUP_CHECK( svg_capture, svg_capture_active )
+SETUP_CHECK( inputseq, inputseq_pc_wait )
 SETUP_NEXT( end_opcode )
@@ -111,17 +111,17 @@
 
 #define contend_read(address,time) \
   if( memory_map_read[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention[ tstates ]; \
+    tstates += ula_contention_delay( ula_contention, tstates ); \
   tstates += (time);
 
 #define contend_read_no_mreq(address,time) \
   if( memory_map_read[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention_no_mreq[ tstates ]; \
+    tstates += ula_contention_delay( ula_contention_no_mreq, tstates ); \
   tstates += (time);
 
 #define contend_write_no_mreq(address,time) \
   if( memory_map_write[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention_no_mreq[ tstates ]; \
+    tstates += ula_contention_delay( ula_contention_no_mreq, tstates ); \
   tstates += (time);
 
 #else				/* #ifndef CORETEST */
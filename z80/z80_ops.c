@@ -30,7 +30,9 @@
 
 #include "debugger/debugger.h"
 #include "event.h"
+#include "inputseq.h"
 #include "machine.h"
+#include "machines/specplus3.h"
 #include "memory_pages.h"
 #include "periph.h"
 #include "peripherals/disk/beta.h"
@@ -193,6 +195,17 @@ z80_do_opcodes( void )
 
     END_CHECK
 
+    CHECK( disk_traps, settings_current.disk_traps )
+
+    /* TR-DOS #3D13 and +3DOS DD_READ_SECTOR; the traps return to the
+       caller themselves if they handled the call */
+    if( ( beta_active && PC == 0x3d13 && beta_disk_trap() == 0 ) ||
+        ( PC == 0x0163 && specplus3_disk_trap() == 0 ) ) {
+      continue;
+    }
+
+    END_CHECK
+
     CHECK( plusd, plusd_available )
 
     if( PC == 0x0008 || PC == 0x003a || PC == 0x0066 || PC == 0x028e ) {
@@ -362,6 +375,12 @@ z80_do_opcodes( void )
 
     END_CHECK
 
+    CHECK( inputseq, inputseq_pc_wait )
+
+    if( PC == inputseq_pc ) inputseq_pc_hit();
+
+    END_CHECK
+
   end_opcode:
     PC++; R++;
     if (++CLOCKL == 0) {